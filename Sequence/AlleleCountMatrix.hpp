@@ -6,6 +6,8 @@
 #include <utility>
 #include <stdexcept>
 #include <Sequence/VariantMatrix.hpp>
+#include <Sequence/Executor.hpp>
+#include <Sequence/bits/allele_count_storage.hpp>
 
 namespace Sequence
 {
@@ -14,19 +16,49 @@ namespace Sequence
     /// To be constructed
     {
       private:
-        static std::vector<std::int32_t> init_counts(const VariantMatrix& m);
+        static std::vector<std::int32_t>
+        init_counts(const VariantMatrix& m, const Executor& executor);
 
       public:
-        const std::vector<std::int32_t> counts;
-        using value_type = std::vector<std::int32_t>::value_type;
+        /// \brief Type of the counts.
+        ///
+        /// Behaves like a const std::vector<std::int32_t>, and
+        /// shares its data with copies and with row ranges
+        /// created by Sequence::make_row_range.
+        using count_storage = internal::allele_count_storage;
+        const count_storage counts;
+        using value_type = count_storage::value_type;
         const std::size_t ncol;
         const std::size_t nrow;
         const std::size_t nsam;
         explicit AlleleCountMatrix(const VariantMatrix& m);
 
+        /// \brief Count alleles using \a nthreads threads.
+        ///
+        /// Ranges of sites are counted concurrently, and the
+        /// result is identical to that of the one-argument
+        /// constructor.  Values of \a nthreads less than two
+        /// count on the calling thread.
+        ///
+        /// \note Each call starts and joins a new
+        /// Sequence::ThreadPool.  Code counting alleles in many
+        /// matrices, such as one per window or replicate, should
+        /// create an Executor once with
+        /// Sequence::make_thread_executor and use the constructor
+        /// taking it.
+        AlleleCountMatrix(const VariantMatrix& m, const unsigned nthreads);
+
+        /// \brief Count alleles in ranges of sites run by \a executor.
+        ///
+        /// See Sequence::Executor and Sequence::make_thread_executor.
+        /// Data held by Sequence::TiledGenotypeCapsule are counted
+        /// on the calling thread.
+        AlleleCountMatrix(const VariantMatrix& m, const Executor& executor);
+
         /// This constructor is for advanced use only,
         /// such as constructing from a slice of a
-        /// pre-existing AlleleCountMatrix.
+        /// pre-existing AlleleCountMatrix.  \a t may
+        /// be a std::vector<std::int32_t> or a count_storage.
         template <typename T>
         AlleleCountMatrix(T&& t, const std::size_t nc_, const std::size_t nr_,
                           const std::size_t n_)
@@ -38,10 +70,25 @@ namespace Sequence
                         "incorrect dimensions for AlleleCountMatrix");
                 }
         }
-        std::pair<std::vector<std::int32_t>::const_iterator,
-                  std::vector<std::int32_t>::const_iterator>
+        std::pair<count_storage::const_iterator,
+                  count_storage::const_iterator>
         row(const std::size_t) const;
     };
+
+    /*! \brief Return the counts for rows [\a beg, \a end) of \a c.
+     *
+     * No counts are copied: the return value shares the data of \a c.
+     * Statistics that take an AlleleCountMatrix may therefore be
+     * calculated in many windows from counts obtained once.
+     *
+     * std::out_of_range is thrown if \a end > c.nrow, and
+     * std::invalid_argument is thrown if \a end < \a beg.
+     *
+     * \ingroup variantmatrix
+     */
+    AlleleCountMatrix make_row_range(const AlleleCountMatrix& c,
+                                     const std::size_t beg,
+                                     const std::size_t end);
 } // namespace Sequence
 
 #endif
@@ -0,0 +1,160 @@
+#ifndef BITPACKED_CAPSULES_HPP
+#define BITPACKED_CAPSULES_HPP
+
+#include "VariantMatrixCapsule.hpp"
+#include "VariantMatrix.hpp"
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace Sequence
+{
+    class BitPackedGenotypeCapsule : public GenotypeCapsule
+    /// \brief Genotype storage for biallelic data using one bit per cell.
+    ///
+    /// Each site is stored as a row of 64-bit words where bit j is set
+    /// if sample j carries allele 1.  Sites containing missing data
+    /// have a second row of words marking the missing cells.  Sites
+    /// without missing data store no mask.
+    ///
+    /// The allowed input states are 0, 1, and negative values (missing
+    /// data).  All missing values are decoded as -1.
+    ///
+    /// The pointer-based parts of the GenotypeCapsule interface (data(),
+    /// begin(), operator(), etc.) require a dense buffer of std::int8_t.
+    /// Const access unpacks the data into a cached dense buffer on first
+    /// use.  Non-const access converts the capsule into dense storage,
+    /// releasing the packed rows, because the caller may modify the data.
+    /// Summary statistics with a packed fast path check packed() and use
+    /// allele_row()/missing_row() instead.
+    ///
+    /// \note The dense buffer takes one byte per genotype, and is kept
+    /// alongside the packed rows, so that any function without a packed
+    /// fast path (currently all but Sequence::AlleleCountMatrix and
+    /// Sequence::difference_matrix) raises the memory used by the data
+    /// from one bit to nine bits per genotype.
+    ///
+    /// \note The dense buffer is built under std::call_once, so const
+    /// access from several threads is safe.  Non-const access, which
+    /// converts the storage, is not.
+    ///
+    /// \ingroup variantmatrix
+    {
+      private:
+        static constexpr std::size_t no_missing_row
+            = std::numeric_limits<std::size_t>::max();
+        std::vector<std::uint64_t> alleles, missing;
+        std::vector<std::size_t> missing_index;
+        mutable std::vector<std::int8_t> dense;
+        mutable std::once_flag unpacked;
+        std::size_t nsites_, nsam_, words_per_row_;
+        bool packed_;
+
+        BitPackedGenotypeCapsule(std::vector<std::uint64_t> alleles_,
+                                 std::vector<std::uint64_t> missing_,
+                                 std::vector<std::size_t> missing_index_,
+                                 std::size_t nsites, std::size_t nsam);
+        void unpack() const;
+        void convert_to_dense();
+
+      public:
+        BitPackedGenotypeCapsule(const std::vector<std::int8_t>& data,
+                                 std::size_t num_rows);
+
+        /// True if genotypes are stored as bits, false
+        /// if the capsule has been converted to dense storage.
+        bool packed() const;
+
+        /// Number of 64-bit words per row of packed data.
+        std::size_t words_per_row() const;
+
+        /// \brief Packed allele 1 indicators for \a site.
+        /// Missing cells are zero.  Only valid if packed() is true.
+        const std::uint64_t* allele_row(std::size_t site) const;
+
+        /// \brief Packed missing-data indicators for \a site.
+        /// Returns nullptr if the site has no missing data.
+        /// Only valid if packed() is true.
+        const std::uint64_t* missing_row(std::size_t site) const;
+
+        /// Decode a single genotype without unpacking the capsule.
+        std::int8_t state(std::size_t site, std::size_t sample) const;
+
+        std::size_t& nsites();
+
+        std::size_t& nsam();
+
+        std::size_t nsites() const;
+
+        std::size_t nsam() const;
+
+        std::size_t row_offset() const final;
+
+        std::size_t col_offset() const final;
+
+        std::size_t stride() const final;
+
+        std::int8_t& operator()(std::size_t, std::size_t);
+
+        const std::int8_t& operator()(std::size_t, std::size_t) const;
+
+        std::int8_t* data() final;
+
+        const std::int8_t* data() const final;
+
+        const std::int8_t* cdata() const final;
+
+        std::unique_ptr<GenotypeCapsule> clone() const final;
+
+        std::int8_t* begin() final;
+
+        const std::int8_t* begin() const final;
+
+        std::int8_t* end() final;
+
+        const std::int8_t* end() const final;
+
+        const std::int8_t* cbegin() const final;
+
+        const std::int8_t* cend() const final;
+
+        bool empty() const final;
+
+        std::size_t size() const final;
+
+        bool resizable() const final;
+
+        void resize(bool) final;
+    };
+
+    /*! \brief Create a GenotypeCapsule suited to the data.
+     * \param data Genotypes in row-major order.
+     * \param num_rows The number of sites
+     * \param max_allele The maximum allelic state in \a data, or -1 if unknown.
+     *
+     * If \a max_allele is at most 1 and all missing data are encoded as -1,
+     * a BitPackedGenotypeCapsule is returned, which is lossless in that case.
+     * Otherwise, a VectorGenotypeCapsule is returned.
+     *
+     * \ingroup variantmatrix
+     */
+    std::unique_ptr<GenotypeCapsule>
+    make_genotype_capsule(std::vector<std::int8_t> data, std::size_t num_rows,
+                          std::int8_t max_allele = -1);
+
+    /*! \brief Create a VariantMatrix whose genotype storage is chosen
+     * by make_genotype_capsule.
+     * \param data Genotypes in row-major order.
+     * \param positions Positions of the sites.
+     * \param max_allele The maximum allelic state in \a data, or -1 if unknown.
+     *
+     * std::invalid_argument is thrown if data.size() % positions.size() != 0.
+     *
+     * \ingroup variantmatrix
+     */
+    VariantMatrix make_compact_VariantMatrix(std::vector<std::int8_t> data,
+                                             std::vector<double> positions,
+                                             std::int8_t max_allele = -1);
+} // namespace Sequence
+#endif
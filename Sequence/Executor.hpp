@@ -0,0 +1,95 @@
+#ifndef SEQUENCE_EXECUTOR_HPP
+#define SEQUENCE_EXECUTOR_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Sequence
+{
+    /// \brief A function that runs a set of independent tasks.
+    ///
+    /// An Executor may run the tasks in any order and on any number of
+    /// threads, but must return only once every task has finished.  If
+    /// a task throws, the exception should be rethrown by the Executor
+    /// after all tasks have finished.
+    ///
+    /// Functions that accept an Executor treat an empty one as a request
+    /// to run the tasks serially on the calling thread.
+    ///
+    /// \ingroup variantmatrix
+    using Executor
+        = std::function<void(const std::vector<std::function<void()>>&)>;
+
+    class ThreadPool
+    /// \brief A fixed set of worker threads.
+    ///
+    /// Threads are started by the constructor and joined by the
+    /// destructor, so that the cost of starting them is paid once
+    /// for many calls to run.
+    ///
+    /// \ingroup variantmatrix
+    {
+      private:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> queue;
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        bool stopping;
+        void work();
+
+      public:
+        /// \brief Start \a nthreads threads.
+        ///
+        /// If \a nthreads is zero, std::thread::hardware_concurrency()
+        /// threads are started, or one if that value is not known.
+        explicit ThreadPool(unsigned nthreads);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /// Number of worker threads
+        std::size_t size() const;
+
+        /// \brief Run \a tasks, returning once all have finished.
+        ///
+        /// If any task throws, the first exception caught is rethrown.
+        /// This function must not be called from one of the pool's
+        /// own tasks.
+        void run(const std::vector<std::function<void()>>& tasks);
+    };
+
+    /*! \brief Return an Executor that runs tasks on \a nthreads threads.
+     *
+     * The threads belong to a Sequence::ThreadPool that is shared by
+     * copies of the return value.  If \a nthreads is zero, the number
+     * of threads is std::thread::hardware_concurrency().
+     *
+     * \ingroup variantmatrix
+     */
+    Executor make_thread_executor(const unsigned nthreads);
+
+    /*! \brief Return an Executor that uses \a pool.
+     *
+     * The caller must ensure that \a pool outlives the return value.
+     *
+     * \ingroup variantmatrix
+     */
+    Executor make_thread_executor(ThreadPool& pool);
+
+    /*! \brief Run \a tasks with \a executor
+     *
+     * If \a executor is empty, the tasks are run in order
+     * on the calling thread.
+     *
+     * \ingroup variantmatrix
+     */
+    void run_tasks(const Executor& executor,
+                   const std::vector<std::function<void()>>& tasks);
+} // namespace Sequence
+
+#endif
@@ -0,0 +1,313 @@
+/*! \file IndexedFasta.hpp
+  @brief Random access to records and regions of FASTA files via .fai indexes
+*/
+#ifndef SEQUENCE_INDEXED_FASTA_HPP
+#define SEQUENCE_INDEXED_FASTA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <Sequence/Fasta.hpp>
+
+namespace Sequence
+{
+    namespace internal
+    {
+        class read_only_mapping;
+    }
+
+    struct FastaIndexEntry
+    /// \brief A line of a samtools-compatible .fai index
+    ///
+    /// \ingroup seqio
+    {
+        /// Name of the record: the header up to the first white space
+        std::string name;
+        /// Number of bases
+        std::uint64_t length;
+        /// Offset in the file of the first base
+        std::uint64_t offset;
+        /// Number of bases on each line
+        std::uint64_t line_bases;
+        /// Number of bytes on each line, including the end of line
+        std::uint64_t line_width;
+    };
+
+    class FastaView
+    /*! \brief A read-only view of bases in a memory-mapped FASTA file.
+     *
+     * Bases are read from the mapping without copying, skipping the
+     * ends of lines.  A view remains valid for as long as the
+     * Sequence::IndexedFasta that created it, or a copy of it, exists.
+     *
+     * \ingroup seqio
+     * \version 1.9.8
+     */
+    {
+      private:
+        // Start of the line holding the first base
+        const char* line;
+        std::size_t column, length_, line_bases, line_width;
+
+      public:
+        class const_iterator
+        /// Random-access iterator over the bases of a FastaView
+        {
+          private:
+            const char* line;
+            std::size_t column, line_bases, line_width;
+
+          public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = char;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const char*;
+            using reference = const char&;
+
+            const_iterator(const char* line_, std::size_t column_,
+                           std::size_t line_bases_, std::size_t line_width_)
+                : line(line_), column(column_), line_bases(line_bases_),
+                  line_width(line_width_)
+            {
+            }
+            reference operator*() const { return line[column]; }
+            reference operator[](difference_type n) const
+            {
+                return *(*this + n);
+            }
+            const_iterator& operator++()
+            {
+                if (++column == line_bases)
+                    {
+                        line += line_width;
+                        column = 0;
+                    }
+                return *this;
+            }
+            const_iterator operator++(int)
+            {
+                auto rv = *this;
+                ++*this;
+                return rv;
+            }
+            const_iterator& operator--()
+            {
+                if (column == 0)
+                    {
+                        line -= line_width;
+                        column = line_bases;
+                    }
+                --column;
+                return *this;
+            }
+            const_iterator operator--(int)
+            {
+                auto rv = *this;
+                --*this;
+                return rv;
+            }
+            const_iterator& operator+=(difference_type n)
+            {
+                auto c = static_cast<difference_type>(column) + n;
+                const auto lb = static_cast<difference_type>(line_bases);
+                auto lines = c / lb;
+                c %= lb;
+                if (c < 0)
+                    {
+                        c += lb;
+                        --lines;
+                    }
+                line += lines * static_cast<difference_type>(line_width);
+                column = static_cast<std::size_t>(c);
+                return *this;
+            }
+            const_iterator& operator-=(difference_type n)
+            {
+                return *this += -n;
+            }
+            const_iterator operator+(difference_type n) const
+            {
+                auto rv = *this;
+                return rv += n;
+            }
+            const_iterator operator-(difference_type n) const
+            {
+                auto rv = *this;
+                return rv -= n;
+            }
+            difference_type operator-(const const_iterator& rhs) const
+            {
+                return (line - rhs.line)
+                           / static_cast<difference_type>(line_width)
+                           * static_cast<difference_type>(line_bases)
+                       + static_cast<difference_type>(column)
+                       - static_cast<difference_type>(rhs.column);
+            }
+            bool operator==(const const_iterator& rhs) const
+            {
+                return line == rhs.line && column == rhs.column;
+            }
+            bool operator!=(const const_iterator& rhs) const
+            {
+                return !(*this == rhs);
+            }
+            bool operator<(const const_iterator& rhs) const
+            {
+                return *this - rhs < 0;
+            }
+            bool operator>(const const_iterator& rhs) const
+            {
+                return rhs < *this;
+            }
+            bool operator<=(const const_iterator& rhs) const
+            {
+                return !(rhs < *this);
+            }
+            bool operator>=(const const_iterator& rhs) const
+            {
+                return !(*this < rhs);
+            }
+        };
+
+        /*! \param record The first base of the record
+         * \param first Index of the first base of the view in the record
+         * \param length The number of bases
+         * \param line_bases Bases per line of the record
+         * \param line_width Bytes per line of the record
+         */
+        FastaView(const char* record, const std::size_t first,
+                  const std::size_t length, const std::size_t line_bases,
+                  const std::size_t line_width);
+
+        std::size_t size() const;
+        bool empty() const;
+        /// Base \a i of the view.  No range checking is done.
+        char operator[](const std::size_t i) const;
+        const_iterator begin() const;
+        const_iterator end() const;
+        /// True if the bases are not interrupted by the end of a line
+        bool contiguous() const;
+        /// \brief The first base of the view.
+        ///
+        /// The bases are data()[0] to data()[size() - 1] if contiguous()
+        /// is true.
+        const char* data() const;
+        /// Append the bases to \a s, copying a line at a time
+        void append_to(std::string& s) const;
+        /// The bases as a string
+        std::string str() const;
+    };
+
+    /*! \brief Build the .fai index of the FASTA file \a filename
+     *
+     * The file is mapped into memory and scanned once.
+     * std::runtime_error is thrown if the file cannot be read, or if
+     * the lines of a record differ in length, other than the last.
+     *
+     * \ingroup seqio
+     * \version 1.9.8
+     */
+    std::vector<FastaIndexEntry>
+    build_fasta_index(const std::string& filename);
+
+    /*! \brief Write \a index in .fai format to \a filename
+     *
+     * std::runtime_error is thrown if the file cannot be written.
+     *
+     * \ingroup seqio
+     * \version 1.9.8
+     */
+    void write_fasta_index(const std::vector<FastaIndexEntry>& index,
+                           const std::string& filename);
+
+    /*! \brief Read an index in .fai format
+     *
+     * std::runtime_error is thrown if the file cannot be read
+     * or is not in .fai format.
+     *
+     * \ingroup seqio
+     * \version 1.9.8
+     */
+    std::vector<FastaIndexEntry> read_fasta_index(const std::string& filename);
+
+    class IndexedFasta
+    /*!
+      \brief Random access to the records of a FASTA file.
+
+      The file is mapped into memory, and a samtools-compatible
+      index, with one Sequence::FastaIndexEntry per record, gives
+      the location of each record.  The index is read from
+      filename.fai if that file exists, and is otherwise built by
+      scanning the file once.  Records and regions are then found
+      without reading the rest of the file, and returned as
+      Sequence::FastaView objects, which do not copy the bases, or
+      as Sequence::Fasta objects.
+
+      Copies share the mapping, and all member functions may be
+      called concurrently.
+
+      \code
+      Sequence::IndexedFasta genome("genome.fa");
+      // Bases [1000, 1050) of chr2
+      auto v = genome.view("chr2", 1000, 1050);
+      Sequence::Fasta f = genome.fasta("chr2", 1000, 1050);
+      \endcode
+
+      std::runtime_error is thrown if a file cannot be read,
+      or if the index does not match the file.
+
+      \ingroup seqio
+      \version 1.9.8
+    */
+    {
+      private:
+        std::shared_ptr<const internal::read_only_mapping> file;
+        std::vector<FastaIndexEntry> index_;
+        std::unordered_map<std::string, std::size_t> lookup;
+        void check_index(const std::string& filename);
+
+      public:
+        explicit IndexedFasta(const std::string& filename);
+        /// Use the index in \a fai_filename, rather than filename.fai
+        IndexedFasta(const std::string& filename,
+                     const std::string& fai_filename);
+
+        /// Number of records
+        std::size_t size() const;
+        const std::vector<FastaIndexEntry>& index() const;
+        /// Whether there is a record named \a name
+        bool contains(const std::string& name) const;
+        /// The index of the record named \a name.
+        /// std::out_of_range is thrown if there is no such record.
+        std::size_t record(const std::string& name) const;
+
+        /// All bases of record \a i.  std::out_of_range is thrown
+        /// if \a i >= size()
+        FastaView view(const std::size_t i) const;
+        /// All bases of the record named \a name
+        FastaView view(const std::string& name) const;
+        /// \brief Bases [beg, end) of the record named \a name.
+        ///
+        /// Positions are 0-based.  std::out_of_range is thrown if
+        /// beg > end or end is greater than the length of the record.
+        FastaView view(const std::string& name, const std::size_t beg,
+                       const std::size_t end) const;
+
+        /// Record \a i, with the record's name
+        Fasta fasta(const std::size_t i) const;
+        /// The record named \a name
+        Fasta fasta(const std::string& name) const;
+        /// \brief Bases [beg, end) of the record named \a name.
+        ///
+        /// As in samtools faidx, the name of the result is
+        /// "name:beg+1-end", using 1-based, inclusive, positions.
+        Fasta fasta(const std::string& name, const std::size_t beg,
+                    const std::size_t end) const;
+    };
+} // namespace Sequence
+
+#endif
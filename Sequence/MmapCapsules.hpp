@@ -0,0 +1,145 @@
+#ifndef MMAP_CAPSULES_HPP
+#define MMAP_CAPSULES_HPP
+
+#include "VariantMatrixCapsule.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Sequence
+{
+    namespace internal
+    {
+        class mapped_matrix_file;
+    }
+
+    /// \brief A read-only memory mapping of a file written by
+    /// Sequence::to_mmapformat.
+    ///
+    /// The mapping is shared by the genotype and position capsules
+    /// created from it, and is released when the last of them is destroyed.
+    /// Opening a file does not read the data: pages are loaded on demand and
+    /// are shared via the page cache by all processes mapping the same file.
+    ///
+    /// \ingroup variantmatrix
+    using MappedMatrixFile = std::shared_ptr<const internal::mapped_matrix_file>;
+
+    /// \brief Map the file \a filename into memory.
+    ///
+    /// std::runtime_error is thrown if the file cannot be mapped or
+    /// is not in the expected format.
+    ///
+    /// \ingroup variantmatrix
+    MappedMatrixFile map_matrix_file(const std::string& filename);
+
+    class MmapGenotypeCapsule : public GenotypeCapsule
+    /// \brief Genotype data stored in a memory-mapped file.
+    ///
+    /// Like Sequence::NonOwningGenotypeCapsule, the data are read-only,
+    /// and non-const access throws std::runtime_error.
+    ///
+    /// \ingroup variantmatrix
+    {
+      private:
+        MappedMatrixFile file;
+        const std::int8_t* buffer;
+        std::size_t nsites_, nsam_;
+
+      public:
+        explicit MmapGenotypeCapsule(MappedMatrixFile f);
+
+        std::size_t& nsites();
+
+        std::size_t& nsam();
+
+        std::size_t nsites() const;
+
+        std::size_t nsam() const;
+
+        std::size_t row_offset() const final;
+
+        std::size_t col_offset() const final;
+
+        std::size_t stride() const final;
+
+        std::int8_t& operator()(std::size_t, std::size_t);
+
+        const std::int8_t& operator()(std::size_t, std::size_t) const;
+
+        std::int8_t* data() final;
+
+        const std::int8_t* data() const final;
+
+        const std::int8_t* cdata() const final;
+
+        std::unique_ptr<GenotypeCapsule> clone() const final;
+
+        std::int8_t* begin() final;
+
+        const std::int8_t* begin() const final;
+
+        std::int8_t* end() final;
+
+        const std::int8_t* end() const final;
+
+        const std::int8_t* cbegin() const final;
+
+        const std::int8_t* cend() const final;
+
+        bool empty() const final;
+
+        std::size_t size() const final;
+
+        bool resizable() const final;
+    };
+
+    class MmapPositionCapsule : public PositionCapsule
+    /// \brief Positions stored in a memory-mapped file.
+    ///
+    /// The data are read-only, and non-const access throws
+    /// std::runtime_error.
+    ///
+    /// \ingroup variantmatrix
+    {
+      private:
+        MappedMatrixFile file;
+        const double* buffer;
+        std::size_t current_size;
+
+      public:
+        explicit MmapPositionCapsule(MappedMatrixFile f);
+
+        double& operator[](std::size_t);
+
+        const double& operator[](std::size_t) const;
+
+        double* data() final;
+
+        const double* data() const final;
+
+        const double* cdata() const final;
+
+        std::unique_ptr<PositionCapsule> clone() const final;
+
+        double* begin() final;
+
+        const double* begin() const final;
+
+        double* end() final;
+
+        const double* end() const final;
+
+        const double* cbegin() const final;
+
+        const double* cend() const final;
+
+        bool empty() const final;
+
+        std::size_t size() const final;
+
+        std::size_t nsites() const;
+
+        bool resizable() const final;
+    };
+} // namespace Sequence
+#endif
@@ -0,0 +1,160 @@
+#ifndef SPARSE_CAPSULES_HPP
+#define SPARSE_CAPSULES_HPP
+
+#include "VariantMatrixCapsule.hpp"
+#include "VariantMatrix.hpp"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Sequence
+{
+    class SparseGenotypeCapsule : public GenotypeCapsule
+    /// \brief Genotype storage for data that are mostly allelic state 0.
+    ///
+    /// The nonzero genotypes are stored in compressed sparse row (CSR)
+    /// form: for each site, the sorted sample indexes and states of every
+    /// cell that is not 0, including missing data.  Memory use and the
+    /// time taken by the fast paths described below therefore scale
+    /// with the number of nonzero cells rather than with nsites * nsam.
+    ///
+    /// Sequence::AlleleCountMatrix, and therefore statistics such as
+    /// Sequence::thetaw and Sequence::thetapi, count alleles from the
+    /// sparse rows.  Sequence::lhaf uses them when the reference state
+    /// is 0.  Other statistics, including Sequence::nslx, whose work
+    /// grows with the number of pairs of haplotypes rather than with
+    /// the number of nonzero cells, use the dense buffer.
+    ///
+    /// As with Sequence::BitPackedGenotypeCapsule, const access through
+    /// the pointer-based parts of the GenotypeCapsule interface unpacks
+    /// the data into a cached dense buffer, and non-const access converts
+    /// the capsule into dense storage.
+    ///
+    /// \note The dense buffer is built under std::call_once, so const
+    /// access from several threads is safe.  Non-const access, which
+    /// converts the storage, is not.
+    ///
+    /// \ingroup variantmatrix
+    {
+      private:
+        std::vector<std::size_t> row_ptr;
+        std::vector<std::uint32_t> col_index;
+        std::vector<std::int8_t> values;
+        mutable std::vector<std::int8_t> dense;
+        mutable std::once_flag unpacked;
+        std::size_t nsites_, nsam_;
+        bool sparse_;
+
+        template <typename RowFunction> void fill(const RowFunction& row);
+        void unpack() const;
+        void convert_to_dense();
+
+      public:
+        /// \brief Construct from row-major data.
+        ///
+        /// std::invalid_argument is thrown if the dimensions are
+        /// incorrect, or if there are more samples than can be indexed
+        /// by a 32-bit integer.
+        SparseGenotypeCapsule(const std::vector<std::int8_t>& data,
+                              std::size_t num_rows);
+
+        /// \brief Construct by copying the genotypes of \a m.
+        ///
+        /// Sites are read one at a time, so \a m may be a window.
+        explicit SparseGenotypeCapsule(const VariantMatrix& m);
+
+        /// True if genotypes are stored in sparse form, false
+        /// if the capsule has been converted to dense storage.
+        bool sparse() const;
+
+        /// Total number of nonzero genotypes.
+        std::size_t nnz() const;
+
+        /// Number of nonzero genotypes at \a site.
+        /// Only valid if sparse() is true.
+        std::size_t nnz(std::size_t site) const;
+
+        /// \brief Sample indexes of the nonzero genotypes at \a site,
+        /// in increasing order.
+        /// Only valid if sparse() is true.
+        const std::uint32_t* samples(std::size_t site) const;
+
+        /// \brief States of the nonzero genotypes at \a site.
+        /// Only valid if sparse() is true.
+        const std::int8_t* states(std::size_t site) const;
+
+        /// \brief Decode a single genotype without unpacking the capsule.
+        ///
+        /// The time taken is logarithmic in nnz(site).
+        std::int8_t state(std::size_t site, std::size_t sample) const;
+
+        std::size_t& nsites();
+
+        std::size_t& nsam();
+
+        std::size_t nsites() const;
+
+        std::size_t nsam() const;
+
+        std::size_t row_offset() const final;
+
+        std::size_t col_offset() const final;
+
+        std::size_t stride() const final;
+
+        std::int8_t& operator()(std::size_t, std::size_t);
+
+        const std::int8_t& operator()(std::size_t, std::size_t) const;
+
+        std::int8_t* data() final;
+
+        const std::int8_t* data() const final;
+
+        const std::int8_t* cdata() const final;
+
+        std::unique_ptr<GenotypeCapsule> clone() const final;
+
+        std::int8_t* begin() final;
+
+        const std::int8_t* begin() const final;
+
+        std::int8_t* end() final;
+
+        const std::int8_t* end() const final;
+
+        const std::int8_t* cbegin() const final;
+
+        const std::int8_t* cend() const final;
+
+        bool empty() const final;
+
+        std::size_t size() const final;
+
+        bool resizable() const final;
+
+        void resize(bool) final;
+    };
+
+    /*! \brief Create a VariantMatrix with sparse genotype storage.
+     * \param data Genotypes in row-major order.
+     * \param positions Positions of the sites.
+     * \param max_allele The maximum allelic state in \a data, or -1 if unknown.
+     *
+     * std::invalid_argument is thrown if data.size() % positions.size() != 0.
+     *
+     * \ingroup variantmatrix
+     */
+    VariantMatrix make_sparse_VariantMatrix(const std::vector<std::int8_t>& data,
+                                            std::vector<double> positions,
+                                            std::int8_t max_allele = -1);
+
+    /*! \brief Create a VariantMatrix with sparse genotype storage.
+     * \param m The input data, which may be a window.
+     *
+     * The positions are copied.
+     *
+     * \ingroup variantmatrix
+     */
+    VariantMatrix make_sparse_VariantMatrix(const VariantMatrix& m);
+} // namespace Sequence
+#endif
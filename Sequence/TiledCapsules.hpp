@@ -0,0 +1,316 @@
+#ifndef TILED_CAPSULES_HPP
+#define TILED_CAPSULES_HPP
+
+#include "VariantMatrixCapsule.hpp"
+#include "VariantMatrix.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Sequence
+{
+    struct GenotypeBlock
+    /// \brief A tile of genotypes stored by a TiledGenotypeCapsule.
+    ///
+    /// The tile covers sites [first_site, first_site + nsites)
+    /// and samples [first_sample, first_sample + nsam), stored
+    /// in row-major order.
+    ///
+    /// \ingroup variantmatrix
+    {
+        /// Pointer to the genotypes of the tile
+        const std::int8_t* data;
+        /// Index of the first site in the tile
+        std::size_t first_site;
+        /// Index of the first sample in the tile
+        std::size_t first_sample;
+        /// Number of sites in the tile
+        std::size_t nsites;
+        /// Number of samples in the tile
+        std::size_t nsam;
+
+        /// Genotype at (\a site, \a sample), relative to the tile
+        inline std::int8_t
+        operator()(const std::size_t site, const std::size_t sample) const
+        {
+            return data[site * nsam + sample];
+        }
+    };
+
+    class TiledGenotypeCapsule : public GenotypeCapsule
+    /// \brief Genotype storage in fixed-size site-by-sample tiles.
+    ///
+    /// Each tile is a separate allocation of at most
+    /// block_sites() * block_samples() genotypes.  Tiles are ordered
+    /// by site block and then by sample block, and are visited in that
+    /// order by blocks_begin() and blocks_end().
+    ///
+    /// The number of tiles held in memory may be bounded by
+    /// set_max_resident_blocks.  When the bound is reached, the least
+    /// recently used tile is written to an anonymous temporary file and
+    /// released.  It is read back the next time it is needed.  With a
+    /// bound of zero (the default), all tiles stay in memory.
+    ///
+    /// As with Sequence::BitPackedGenotypeCapsule, the pointer-based
+    /// parts of the GenotypeCapsule interface require a dense buffer.
+    /// Const access copies all tiles into a cached dense buffer, which
+    /// is not subject to the bound on resident tiles, so that from then
+    /// on the capsule uses the memory of a dense matrix in addition to
+    /// its tiles.  Non-const access converts the capsule into dense
+    /// storage.  Only code that checks tiled() and uses block(), the
+    /// block iterators, or copy_region() keeps memory bounded.
+    /// Sequence::AlleleCountMatrix, Sequence::make_window, and
+    /// Sequence::make_slice do so; other summary statistics use the
+    /// dense buffer.
+    ///
+    /// \note Without a bound on resident tiles, const access is safe
+    /// from several threads: tiles stay in memory, nothing is recorded
+    /// when they are read, and the dense buffer is built under
+    /// std::call_once.  With a bound, reading a tile updates the record
+    /// of recent use and may evict other tiles, so that instances of
+    /// GenotypeBlock returned by block() are only valid until the next
+    /// call to block(), and the capsule must not be read from more than
+    /// one thread at a time.
+    ///
+    /// \ingroup variantmatrix
+    {
+      private:
+        struct tile
+        {
+            std::vector<std::int8_t> data;
+            std::size_t nsites, nsam;
+            std::uint64_t last_use;
+            bool spilled;
+        };
+        mutable std::vector<tile> tiles;
+        mutable std::vector<std::int8_t> dense;
+        mutable std::once_flag unpacked;
+        std::size_t nsites_, nsam_, block_sites_, block_samples_;
+        std::size_t site_blocks_, sample_blocks_;
+        std::size_t max_resident_;
+        mutable std::size_t nresident;
+        mutable std::uint64_t clock;
+        mutable std::shared_ptr<std::FILE> spill;
+        bool tiled_;
+
+        TiledGenotypeCapsule(std::size_t nsites, std::size_t nsam,
+                             std::size_t block_sites,
+                             std::size_t block_samples,
+                             std::size_t max_resident_blocks);
+        template <typename RowFunction>
+        void fill(const RowFunction& row);
+        const tile& load(std::size_t i) const;
+        void read_spilled(std::size_t i, std::vector<std::int8_t>& out) const;
+        void evict_until(std::size_t n) const;
+        void unpack() const;
+        void convert_to_dense();
+
+      public:
+        /// Default number of sites per tile
+        static constexpr std::size_t default_block_sites = 1024;
+        /// Default number of samples per tile
+        static constexpr std::size_t default_block_samples = 1024;
+
+        /// \brief Construct from row-major data.
+        /// \param data Genotypes in row-major order.
+        /// \param num_rows The number of sites.
+        /// \param block_sites The number of sites per tile.
+        /// \param block_samples The number of samples per tile.
+        /// \param max_resident_blocks Bound on the number of tiles kept in
+        /// memory.  Zero means no bound.
+        ///
+        /// std::invalid_argument is thrown if the dimensions are incorrect
+        /// or if a block dimension is zero.
+        TiledGenotypeCapsule(
+            const std::vector<std::int8_t>& data, std::size_t num_rows,
+            std::size_t block_sites = default_block_sites,
+            std::size_t block_samples = default_block_samples,
+            std::size_t max_resident_blocks = 0);
+
+        /// \brief Construct by copying the genotypes of \a m.
+        ///
+        /// Sites are read one at a time, so \a m may be a window or use
+        /// Sequence::MmapGenotypeCapsule without \a m being copied into
+        /// a single buffer first.
+        explicit TiledGenotypeCapsule(
+            const VariantMatrix& m,
+            std::size_t block_sites = default_block_sites,
+            std::size_t block_samples = default_block_samples,
+            std::size_t max_resident_blocks = 0);
+
+        /// True if genotypes are stored as tiles, false
+        /// if the capsule has been converted to dense storage.
+        bool tiled() const;
+
+        /// Number of sites per tile.  Tiles in the last site block may
+        /// have fewer.
+        std::size_t block_sites() const;
+
+        /// Number of samples per tile.  Tiles in the last sample block
+        /// may have fewer.
+        std::size_t block_samples() const;
+
+        /// Number of tiles along the site dimension
+        std::size_t site_blocks() const;
+
+        /// Number of tiles along the sample dimension
+        std::size_t sample_blocks() const;
+
+        /// Total number of tiles
+        std::size_t nblocks() const;
+
+        /// \brief Return tile \a i, reading it from disk if needed.
+        ///
+        /// Tile i covers site block i / sample_blocks() and sample block
+        /// i % sample_blocks().  Only valid if tiled() is true.
+        /// std::out_of_range is thrown if \a i >= nblocks().
+        GenotypeBlock block(std::size_t i) const;
+
+        /// \brief Copy the genotypes of sites [first_site,
+        /// first_site + nsites) and samples [first_sample,
+        /// first_sample + nsam) to \a out, in row-major order.
+        ///
+        /// Only the tiles overlapping the region are read.  Only valid if
+        /// tiled() is true.  std::out_of_range is thrown if the region
+        /// extends beyond the data.
+        void copy_region(std::size_t first_site, std::size_t nsites,
+                         std::size_t first_sample, std::size_t nsam,
+                         std::int8_t* out) const;
+
+        /// \brief Bound the number of tiles held in memory.
+        ///
+        /// Zero means no bound.  Tiles are evicted immediately if the
+        /// new bound is lower than resident_blocks(), and read back
+        /// if the bound is removed.
+        void set_max_resident_blocks(std::size_t n);
+
+        /// The bound on the number of tiles held in memory
+        std::size_t max_resident_blocks() const;
+
+        /// The number of tiles currently held in memory
+        std::size_t resident_blocks() const;
+
+        class block_iterator
+        /// \brief Forward iterator over the tiles of a TiledGenotypeCapsule.
+        ///
+        /// Dereferencing calls TiledGenotypeCapsule::block.
+        {
+          private:
+            const TiledGenotypeCapsule* c;
+            std::size_t i;
+
+          public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = GenotypeBlock;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const GenotypeBlock*;
+            using reference = GenotypeBlock;
+
+            block_iterator(const TiledGenotypeCapsule* c_, std::size_t i_)
+                : c(c_), i(i_)
+            {
+            }
+            GenotypeBlock
+            operator*() const
+            {
+                return c->block(i);
+            }
+            block_iterator&
+            operator++()
+            {
+                ++i;
+                return *this;
+            }
+            block_iterator
+            operator++(int)
+            {
+                block_iterator rv(*this);
+                ++i;
+                return rv;
+            }
+            bool
+            operator==(const block_iterator& rhs) const
+            {
+                return c == rhs.c && i == rhs.i;
+            }
+            bool
+            operator!=(const block_iterator& rhs) const
+            {
+                return !(*this == rhs);
+            }
+        };
+
+        /// Iterator to the first tile
+        block_iterator blocks_begin() const;
+        /// Iterator to one past the last tile
+        block_iterator blocks_end() const;
+
+        std::size_t& nsites();
+
+        std::size_t& nsam();
+
+        std::size_t nsites() const;
+
+        std::size_t nsam() const;
+
+        std::size_t row_offset() const final;
+
+        std::size_t col_offset() const final;
+
+        std::size_t stride() const final;
+
+        std::int8_t& operator()(std::size_t, std::size_t);
+
+        const std::int8_t& operator()(std::size_t, std::size_t) const;
+
+        std::int8_t* data() final;
+
+        const std::int8_t* data() const final;
+
+        const std::int8_t* cdata() const final;
+
+        std::unique_ptr<GenotypeCapsule> clone() const final;
+
+        std::int8_t* begin() final;
+
+        const std::int8_t* begin() const final;
+
+        std::int8_t* end() final;
+
+        const std::int8_t* end() const final;
+
+        const std::int8_t* cbegin() const final;
+
+        const std::int8_t* cend() const final;
+
+        bool empty() const final;
+
+        std::size_t size() const final;
+
+        bool resizable() const final;
+
+        void resize(bool) final;
+    };
+
+    /*! \brief Create a VariantMatrix with tiled genotype storage.
+     * \param m The input data, which may be a window or memory-mapped.
+     * \param block_sites The number of sites per tile.
+     * \param block_samples The number of samples per tile.
+     * \param max_resident_blocks Bound on the number of tiles kept in
+     * memory.  Zero means no bound.
+     *
+     * The positions are copied.
+     *
+     * \ingroup variantmatrix
+     */
+    VariantMatrix make_tiled_VariantMatrix(
+        const VariantMatrix& m,
+        std::size_t block_sites = TiledGenotypeCapsule::default_block_sites,
+        std::size_t block_samples
+        = TiledGenotypeCapsule::default_block_samples,
+        std::size_t max_resident_blocks = 0);
+} // namespace Sequence
+#endif
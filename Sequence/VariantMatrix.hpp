@@ -7,6 +7,8 @@
 #include <utility>
 #include <vector>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <type_traits>
 #include "VectorCapsules.hpp"
@@ -73,6 +75,15 @@ namespace Sequence
             return max_allele_value;
         }
         std::int8_t max_allele_;
+        // Opt-in haplotype-major copy of the genotypes.
+        bool cache_haplotypes_;
+        mutable bool haplotype_cache_valid;
+        mutable std::vector<std::int8_t> haplotype_cache;
+        // Held by pointer so that the matrix stays movable
+        // and so that invalidation can replace it.
+        std::unique_ptr<std::once_flag> haplotype_cache_built;
+        void build_haplotype_cache() const;
+        void invalidate_haplotype_cache();
 
       public:
         /// Data stored in matrix form with rows as sites.
@@ -101,7 +112,9 @@ namespace Sequence
                 std::forward<positions_input>(positions_))),
               capsule(new VectorGenotypeCapsule(
                   std::forward<data_input>(data_), pcapsule->size())),
-              max_allele_(set_max_allele(max_allele_value))
+              max_allele_(set_max_allele(max_allele_value)),
+              cache_haplotypes_(false), haplotype_cache_valid(false),
+              haplotype_cache{}, haplotype_cache_built(new std::once_flag)
         {
             if (max_allele() < 0)
                 {
@@ -118,7 +131,9 @@ namespace Sequence
                       std::unique_ptr<PositionCapsule> positions_,
                       std::int8_t max_allele_value)
             : pcapsule(std::move(positions_)), capsule(std::move(data_)),
-              max_allele_(set_max_allele(max_allele_value))
+              max_allele_(set_max_allele(max_allele_value)),
+              cache_haplotypes_(false), haplotype_cache_valid(false),
+              haplotype_cache{}, haplotype_cache_built(new std::once_flag)
         {
             if (max_allele() < 0)
                 {
@@ -157,6 +172,10 @@ namespace Sequence
         const std::int8_t* data() const;
         const std::int8_t* cdata() const;
         bool empty() const;
+        /// \brief The genotype storage.
+        /// Allows functions to detect specific GenotypeCapsule
+        /// types for which they have optimized implementations.
+        const GenotypeCapsule& genotype_capsule() const;
         /// Max allelic value stored in matrix
         std::int8_t max_allele() const;
 
@@ -176,6 +195,43 @@ namespace Sequence
         /// Make a "deep" copy by cloning
         /// the genotype and position capsules
         VariantMatrix deepcopy() const;
+        /// \brief Move the genotypes and positions out of the matrix,
+        /// leaving it empty.
+        ///
+        /// Only matrices storing their data in std::vector, which is
+        /// the case for those constructed from vectors, can give up
+        /// their storage.  For other matrices, false is returned and
+        /// nothing is changed.  Used to reuse memory when filling a
+        /// matrix repeatedly, as done by Sequence::MsFormatReader.
+        ///
+        /// \version 1.9.8
+        bool release(std::vector<std::int8_t>& data,
+                     std::vector<double>& positions);
+
+        /// \brief Opt in to, or out of, keeping a haplotype-major copy
+        /// of the genotypes.
+        ///
+        /// When enabled, the copy is built on first use by
+        /// haplotype_major_data() and discarded by any non-const access
+        /// to the genotypes, including the creation of RowView or ColView
+        /// objects, and by filter_sites and filter_haplotypes.
+        /// Functions that iterate over haplotypes, such as
+        /// Sequence::difference_matrix and Sequence::nsl, use the copy
+        /// when it is enabled, giving unit-stride access to each haplotype.
+        ///
+        /// \note The copy is built under std::call_once, so const access
+        /// from several threads is safe.  Non-const access, which
+        /// discards the copy, is not.
+        ///
+        /// \version 1.9.8
+        void set_haplotype_cache(const bool enable);
+        /// Whether the haplotype-major copy is enabled.
+        bool haplotype_cache_enabled() const;
+        /// \brief The genotypes stored with haplotypes as rows.
+        ///
+        /// Element (haplotype, site) is at haplotype * nsites() + site.
+        /// std::runtime_error is thrown if the cache is not enabled.
+        const std::int8_t* haplotype_major_data() const;
 
         bool resizable() const;
         void resize_capsules(bool remove_sites);
@@ -64,6 +64,35 @@ namespace Sequence
     /// \ingroup variantmatrix
     ConstColView get_ConstColView(const VariantMatrix& m,
                                   const std::size_t col);
+
+    struct HaplotypeMajorView
+    /// \brief View of the haplotype-major copy of a VariantMatrix
+    ///
+    /// Each haplotype is a contiguous range, and is returned
+    /// as a ConstRowView of length nsites.
+    ///
+    /// \ingroup variantmatrix
+    {
+        /// Pointer to the haplotype-major data
+        const std::int8_t* data;
+        /// Number of sites
+        std::size_t nsites;
+        /// Number of haplotypes
+        std::size_t nsam;
+        /// Constructor
+        HaplotypeMajorView(const std::int8_t* data_, std::size_t nsites_,
+                           std::size_t nsam_);
+        /// \brief Return haplotype \a i.
+        /// std::out_of_range is thrown if \a i is out of range.
+        ConstRowView haplotype(const std::size_t i) const;
+    };
+
+    /// \brief Return a HaplotypeMajorView of VariantMatrix `m`.
+    /// The haplotype-major copy is built if needed.
+    /// std::runtime_error is thrown if `m.haplotype_cache_enabled()`
+    /// is false.
+    /// \ingroup variantmatrix
+    HaplotypeMajorView get_HaplotypeMajorView(const VariantMatrix& m);
 }
 
 #endif
@@ -71,6 +71,9 @@ namespace Sequence
         bool resizable() const final;
 
         void resize(bool) final;
+
+        /// Move the data out, leaving the capsule empty
+        std::vector<std::int8_t> release();
     };
 
     class VectorPositionCapsule : public PositionCapsule
@@ -119,6 +122,9 @@ namespace Sequence
         bool resizable() const final;
 
         void resize(bool) final;
+
+        /// Move the data out, leaving the capsule empty
+        std::vector<double> release();
     };
 } // namespace Sequence
 #endif
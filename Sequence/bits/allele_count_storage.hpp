@@ -0,0 +1,178 @@
+#ifndef SEQUENCE_BITS_ALLELE_COUNT_STORAGE_HPP__
+#define SEQUENCE_BITS_ALLELE_COUNT_STORAGE_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace Sequence
+{
+    namespace internal
+    {
+        class allele_count_storage
+        /// \brief Storage for AlleleCountMatrix::counts
+        ///
+        /// Behaves like a const std::vector<std::int32_t>.
+        /// The data are immutable, and are shared by copies
+        /// and by ranges of elements created with the
+        /// three-argument constructor.
+        {
+          private:
+            std::shared_ptr<const std::vector<std::int32_t>> buffer;
+            std::size_t offset, length;
+
+          public:
+            using value_type = std::int32_t;
+            using size_type = std::size_t;
+            using difference_type = std::ptrdiff_t;
+            using const_reference = const value_type&;
+            using reference = const_reference;
+            using const_iterator = const value_type*;
+            using iterator = const_iterator;
+
+            allele_count_storage()
+                : buffer(new std::vector<std::int32_t>()), offset(0),
+                  length(0)
+            {
+            }
+
+            allele_count_storage(std::vector<std::int32_t> v)
+                /// Take ownership of \a v
+                : buffer(new std::vector<std::int32_t>(std::move(v))),
+                  offset(0), length(buffer->size())
+            {
+            }
+
+            allele_count_storage(const allele_count_storage& parent,
+                                 const std::size_t first,
+                                 const std::size_t n)
+                /// Elements [first, first + n) of \a parent,
+                /// sharing its data.
+                : buffer(parent.buffer), offset(parent.offset + first),
+                  length(n)
+            {
+                if (first + n > parent.length)
+                    {
+                        throw std::out_of_range(
+                            "allele count range out of bounds");
+                    }
+            }
+
+            inline const_iterator
+            begin() const
+            {
+                return buffer->data() + offset;
+            }
+            inline const_iterator
+            end() const
+            {
+                return begin() + length;
+            }
+            inline const_iterator
+            cbegin() const
+            {
+                return begin();
+            }
+            inline const_iterator
+            cend() const
+            {
+                return end();
+            }
+            inline const value_type*
+            data() const
+            {
+                return begin();
+            }
+            inline size_type
+            size() const
+            {
+                return length;
+            }
+            inline bool
+            empty() const
+            {
+                return length == 0;
+            }
+            inline const_reference operator[](const size_type i) const
+            /// Element access without range checking
+            {
+                return begin()[i];
+            }
+            inline const_reference
+            at(const size_type i) const
+            /// Range-checked element access
+            {
+                if (i >= length)
+                    {
+                        throw std::out_of_range(
+                            "allele count index out of range");
+                    }
+                return begin()[i];
+            }
+            inline const_reference
+            front() const
+            {
+                return *begin();
+            }
+            inline const_reference
+            back() const
+            {
+                return *(end() - 1);
+            }
+            operator std::vector<std::int32_t>() const
+            /// A copy of the elements, for code
+            /// requiring a std::vector
+            {
+                return std::vector<std::int32_t>(begin(), end());
+            }
+        };
+
+        inline bool
+        operator==(const allele_count_storage& a,
+                   const allele_count_storage& b)
+        {
+            return a.size() == b.size()
+                   && std::equal(a.begin(), a.end(), b.begin());
+        }
+
+        inline bool
+        operator!=(const allele_count_storage& a,
+                   const allele_count_storage& b)
+        {
+            return !(a == b);
+        }
+
+        inline bool
+        operator==(const allele_count_storage& a,
+                   const std::vector<std::int32_t>& b)
+        {
+            return a.size() == b.size()
+                   && std::equal(a.begin(), a.end(), b.begin());
+        }
+
+        inline bool
+        operator==(const std::vector<std::int32_t>& a,
+                   const allele_count_storage& b)
+        {
+            return b == a;
+        }
+
+        inline bool
+        operator!=(const allele_count_storage& a,
+                   const std::vector<std::int32_t>& b)
+        {
+            return !(a == b);
+        }
+
+        inline bool
+        operator!=(const std::vector<std::int32_t>& a,
+                   const allele_count_storage& b)
+        {
+            return !(b == a);
+        }
+    } // namespace internal
+} // namespace Sequence
+
+#endif
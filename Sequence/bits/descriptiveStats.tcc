@@ -117,6 +117,12 @@ namespace Sequence
     return __sumsq;
   }
 
+  template<typename T>
+  unsigned Sums<T>::n() const
+  {
+    return __n;
+  }
+
   template<typename T>
   double Sums<T>::mean() const
   {
@@ -107,6 +107,8 @@ namespace Sequence
     Sums<T> & operator+=(const Sums<T> &);
     const T & sum() const;
     const T & sumSquares() const;
+    //! The number of values added
+    unsigned n() const;
     double mean() const;
     double variance() const;
   };
@@ -16,8 +16,11 @@
 #include "summstats/classics.hpp"
 #include "summstats/nsl.hpp"
 #include "summstats/nslx.hpp"
+#include "summstats/nsl_standardization.hpp"
 #include "summstats/ld.hpp"
+#include "summstats/ld_summaries.hpp"
 #include "summstats/lhaf.hpp"
 #include "summstats/garud.hpp"
+#include "summstats/sliding_windows.hpp"
 
 #endif
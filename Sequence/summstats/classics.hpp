@@ -3,6 +3,9 @@
 #ifndef SEQUENCE_SUMMSTATS_CLASSICS_HPP__
 #define SEQUENCE_SUMMSTATS_CLASSICS_HPP__
 
+#include <cstddef>
+#include <utility>
+#include <vector>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/AlleleCountMatrix.hpp>
 
@@ -99,6 +102,45 @@ namespace Sequence
     double faywuh(const AlleleCountMatrix& ac,
                   const std::vector<std::int8_t>& refstates);
 
+    struct ClassicSummaryStatistics
+    /// \brief Return value of Sequence::classic_summstats
+    ///
+    /// Each member equals the return value of the function
+    /// of the same name.
+    ///
+    /// \ingroup popgenanalysis
+    {
+        double thetapi, thetaw, thetah, thetal, hprime, faywuh, tajd;
+        std::uint32_t nvariable_sites, nbiallelic_sites,
+            total_number_of_mutations;
+    };
+
+    /*! \brief Calculate the "classic" statistics in one pass
+     * \param ac An AlleleCountMatrix
+     * \param refstate The ancestral state
+     * \return Sequence::ClassicSummaryStatistics
+     *
+     * The counts for each site are read once, and the results are
+     * identical to calling Sequence::thetapi, Sequence::thetaw,
+     * Sequence::thetah, Sequence::thetal, Sequence::hprime,
+     * Sequence::faywuh, Sequence::tajd, Sequence::nvariable_sites,
+     * Sequence::nbiallelic_sites, and Sequence::total_number_of_mutations
+     * separately.  The constants \f$a_n\f$ and \f$b_n\f$ are cached
+     * between calls, making this function suitable for processing
+     * many replicates.
+     *
+     * std::invalid_argument is thrown if \a refstate is not a valid
+     * allelic state, and std::runtime_error is thrown if any site has
+     * more than one derived state.
+     *
+     * Included via Sequence/summstats.hpp or
+     * Sequence/summstats/classics.hpp
+     *
+     * \ingroup popgenanalysis
+     */
+    ClassicSummaryStatistics classic_summstats(const AlleleCountMatrix& ac,
+                                               const std::int8_t refstate);
+
     /*!  \brief Calculate number of differences between all samples.
      * \param m A VariantMatrix
      * \return std::vector<std::int32_t>
@@ -209,6 +251,29 @@ namespace Sequence
      * \ingroup popgenanalysis
      */
     std::int32_t rmin(const VariantMatrix& m);
+
+    /*! The intervals counted by Sequence::rmin
+     * \param m A VariantMatrix
+     * \return Pairs of site indexes
+     *
+     * Each pair (i, j) contains the indexes of two biallelic sites of
+     * \a m that fail the four-gamete test, with i < j.  The intervals
+     * do not overlap, except that one may begin at the site where
+     * the previous one ends, and the number of intervals is the value
+     * returned by Sequence::rmin when \a m has at least two sites.
+     * Of the incompatible pairs that could be reported for a given
+     * \a j, the one with the largest \a i is returned.
+     *
+     * Samples with missing data at either site of a pair are
+     * not used when testing that pair.
+     *
+     * Included via Sequence/summstats.hpp or
+     * Sequence/summstats/classics.hpp
+     *
+     * \ingroup popgenanalysis
+     */
+    std::vector<std::pair<std::size_t, std::size_t>>
+    rmin_intervals(const VariantMatrix& m);
 } // namespace Sequence
 
 #endif
@@ -3,6 +3,8 @@
 #ifndef SEQUENCE_SUMMSTATS_GARUD_HPP
 #define SEQUENCE_SUMMSTATS_GARUD_HPP
 
+#include <cstddef>
+#include <vector>
 #include <Sequence/VariantMatrix.hpp>
 
 namespace Sequence
@@ -26,6 +28,42 @@ namespace Sequence
    * See \cite Garud2015-ob for details.
    */
   GarudStats garud_statistics(const VariantMatrix & m);
+
+  /*! \brief Calculate H1, H12, and H2/H1 in windows of a fixed number of sites
+   * \param m A VariantMatrix
+   * \param window_size The number of sites in each window
+   * \param step_size The number of sites between the starts of windows
+   * \return One GarudStats per window
+   *
+   * Window \a k contains sites [k*step_size, k*step_size + window_size)
+   * of \a m.  Windows are returned while they fit entirely within \a m,
+   * so there are no windows if \a m has fewer than \a window_size sites.
+   *
+   * Rather than labelling the haplotypes of each window, a 128-bit hash
+   * of each haplotype is updated as sites enter and leave the window,
+   * so that the cost of moving to the next window depends on
+   * \a step_size and not on \a window_size.  Haplotypes with equal
+   * hashes are treated as identical without comparing their sites, so
+   * the result for a window agrees with calling garud_statistics on a
+   * VariantMatrix containing only those sites unless two different
+   * haplotypes have the same hash, which is very unlikely.  The
+   * haplotype frequencies are summed in a different order, so values
+   * may differ in the last few bits.
+   *
+   * \note A window containing any missing data is copied and passed to
+   * garud_statistics, as the hashes cannot find haplotypes that differ
+   * only at missing data.  If most windows contain missing data, this
+   * function is no faster than calling garud_statistics for each
+   * window.
+   *
+   * std::invalid_argument is thrown if \a window_size or \a step_size
+   * is zero.
+   *
+   * \ingroup popgenanalysis
+   */
+  std::vector<GarudStats>
+  garud_statistics_scan(const VariantMatrix & m, const std::size_t window_size,
+                        const std::size_t step_size);
 }
 
 #endif
@@ -2,8 +2,10 @@
 #define SEQUENCE_SUMMSTATS_LD_HPP__
 
 #include <cstdint>
+#include <functional>
 #include <vector>
 #include <Sequence/VariantMatrix.hpp>
+#include <Sequence/Executor.hpp>
 
 namespace Sequence
 {
@@ -18,6 +20,68 @@ namespace Sequence
     two_locus_haplotype_counts(const VariantMatrix& m, std::size_t sitei,
                                const std::size_t sitej,
                                const bool skip_missing);
+
+    struct PairwiseLD
+    /*!
+      Linkage disequilibrium between two biallelic sites.
+
+      \a i and \a j are the indexes of the sites, with i < j.
+      Frequencies are those of the larger allelic state at each site,
+      so that, for 0/1 data, D is in terms of the derived states.
+      D' is D/Dmax, which is negative when D is.  Frequencies are
+      calculated from the samples having data at both sites.  If
+      either site is monomorphic in those samples, rsq and Dprime
+      are not a number.
+
+      \ingroup popgenanalysis
+    */
+    {
+        std::size_t i, j;
+        double rsq, D, Dprime;
+    };
+
+    /*! \brief Calculate LD for all pairs of nearby biallelic sites
+     * \param m A VariantMatrix
+     * \param max_distance The maximum distance between positions
+     * \param f Called for each pair of sites
+     * \param executor Used to calculate blocks of rows in parallel
+     *
+     * Pairs of sites whose positions differ by at most \a max_distance
+     * are considered.  Sites with more or fewer than two states,
+     * ignoring missing data, are skipped.  Positions must be sorted.
+     *
+     * Each site is stored as a bitset over samples, so that the
+     * two-locus haplotype counts for a pair of sites come from
+     * popcounts of a few words.  Results are passed to \a f on the
+     * calling thread, ordered by \a i and then \a j.  If \a executor
+     * is empty, each result is passed to \a f as soon as it is
+     * calculated.  Otherwise, \a executor calculates batches of
+     * consecutive pairs, and at most 262,144 results are held in
+     * memory while waiting to be passed to \a f, whatever the
+     * number of sites.
+     *
+     * std::invalid_argument is thrown if \a max_distance is negative
+     * or not a number.
+     *
+     * \ingroup popgenanalysis
+     */
+    void for_each_pairwise_ld(const VariantMatrix& m,
+                              const double max_distance,
+                              const std::function<void(const PairwiseLD&)>& f,
+                              const Executor& executor = Executor());
+
+    /*! \brief Calculate LD for all pairs of nearby biallelic sites
+     * \param m A VariantMatrix
+     * \param max_distance The maximum distance between positions
+     * \param executor Used to calculate blocks of rows in parallel
+     *
+     * \return The results of for_each_pairwise_ld, in the same order.
+     *
+     * \ingroup popgenanalysis
+     */
+    std::vector<PairwiseLD> pairwise_ld(const VariantMatrix& m,
+                                        const double max_distance,
+                                        const Executor& executor = Executor());
 } // namespace Sequence
 
 #endif
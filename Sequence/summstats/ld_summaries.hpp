@@ -0,0 +1,141 @@
+/// \file Sequence/summstats/ld_summaries.hpp
+/// \brief ZnS, omega, and the decay of r^2 with distance
+#ifndef SEQUENCE_SUMMSTATS_LD_SUMMARIES_HPP
+#define SEQUENCE_SUMMSTATS_LD_SUMMARIES_HPP
+
+#include <cstddef>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/Executor.hpp>
+#include <Sequence/summstats/ld.hpp>
+
+namespace Sequence
+{
+    class ZnSAccumulator
+    /*!
+      Kelly's ZnS \cite Kelly1997-zc, the mean r^2 over pairs of sites,
+      accumulated one pair at a time.  Pairs whose r^2 is not a number
+      are ignored.
+
+      \ingroup popgenanalysis
+    */
+    {
+      private:
+        double sum;
+        std::size_t n;
+
+      public:
+        ZnSAccumulator();
+        void operator()(const PairwiseLD& ld);
+        /// Number of pairs included
+        std::size_t npairs() const;
+        /// ZnS, which is not a number if no pairs were included
+        double value() const;
+    };
+
+    struct OmegaResult
+    /*!
+      The maximum of Kim and Nielsen's omega \cite Kim2004-dr over all
+      ways of splitting the sites into a left and a right group.
+
+      \ingroup popgenanalysis
+    */
+    {
+        /// omega_max, or not a number if no split has at least
+        /// two sites on each side
+        double omega_max;
+        /// Index of the last site in the left group
+        std::size_t left_site;
+        OmegaResult();
+    };
+
+    class OmegaAccumulator
+    /*!
+      Accumulates the r^2 between pairs of sites so that omega may be
+      calculated at every split point.  Only sums over each site's
+      pairs are stored, so memory is linear in the number of sites.
+
+      Pairs may be added in any order.  Pairs whose r^2 is not a number
+      are ignored.
+
+      \ingroup popgenanalysis
+    */
+    {
+      private:
+        // Sums and numbers of pairs with each site as the later
+        // (column) or earlier (row) member of the pair
+        std::vector<double> colsum, rowsum;
+        std::vector<std::size_t> colcount, rowcount;
+
+      public:
+        /// \param nsites The number of sites in the VariantMatrix
+        explicit OmegaAccumulator(const std::size_t nsites);
+        void operator()(const PairwiseLD& ld);
+        OmegaResult value() const;
+    };
+
+    class LDDecayAccumulator
+    /*!
+      Mean r^2 for pairs of sites binned by the distance between them.
+      Bin \a k contains pairs whose distance is in
+      [k * bin_width, (k + 1) * bin_width).  Pairs beyond the last bin,
+      and pairs whose r^2 is not a number, are ignored.
+
+      \ingroup popgenanalysis
+    */
+    {
+      private:
+        std::vector<double> sums;
+        std::vector<std::size_t> counts;
+        double width;
+
+      public:
+        /// std::invalid_argument is thrown if \a bin_width is not
+        /// positive.
+        LDDecayAccumulator(const double bin_width, const std::size_t nbins);
+        void operator()(const PairwiseLD& ld, const double distance);
+        double bin_width() const;
+        /// Number of pairs in each bin
+        const std::vector<std::size_t>& npairs() const;
+        /// Mean r^2 in each bin, which is not a number for empty bins
+        std::vector<double> mean_rsq() const;
+    };
+
+    struct LDSummaries
+    /*!
+      Return value of Sequence::ld_summaries
+
+      \ingroup popgenanalysis
+    */
+    {
+        double zns;
+        OmegaResult omega;
+        /// Mean r^2 in bins of distance
+        std::vector<double> decay;
+        /// Number of pairs in each bin of decay
+        std::vector<std::size_t> decay_npairs;
+    };
+
+    /*! \brief Calculate ZnS, omega_max, and the decay of r^2 with distance
+     * \param m A VariantMatrix
+     * \param bin_width Width of the distance bins for the decay of r^2
+     * \param nbins Number of distance bins
+     * \param executor Used to calculate LD in parallel
+     *
+     * All pairs of biallelic sites in \a m are passed once from
+     * Sequence::for_each_pairwise_ld to a ZnSAccumulator, an
+     * OmegaAccumulator, and an LDDecayAccumulator, so no table of all
+     * pairs is built.  Memory use is linear in the number of sites,
+     * plus, if \a executor is not empty, the bounded batch of results
+     * that for_each_pairwise_ld holds while waiting to pass them on.
+     * For a region of a larger data set, pass a window created by
+     * Sequence::make_window.
+     *
+     * \ingroup popgenanalysis
+     */
+    LDSummaries ld_summaries(const VariantMatrix& m, const double bin_width,
+                             const std::size_t nbins,
+                             const Executor& executor = Executor());
+} // namespace Sequence
+
+#endif
@@ -16,5 +16,19 @@ namespace Sequence
     */
     std::vector<double> lhaf(const VariantMatrix &m,
                              const std::int8_t refstate, const double l);
+
+    /*! \brief l-Haf statistic of \cite Ronen2015-te for several powers
+    * \param m A VariantMatrix
+    * \param refstate The ancstral state
+    * \param l The power parameters
+    * \return The statistic for each element of \a l, in the same order.
+    * Each is identical to the result of the single-power overload.
+    *
+    * The data are read once for all elements of \a l.
+    * \ingroup popgenanalysis
+    */
+    std::vector<std::vector<double>> lhaf(const VariantMatrix &m,
+                                          const std::int8_t refstate,
+                                          const std::vector<double> &l);
 } // namespace Sequence
 #endif
@@ -0,0 +1,139 @@
+/// \file Sequence/summstats/nsl_standardization.hpp
+/// \brief Standardization of nSL and iHS within bins of derived allele frequency
+#ifndef SEQUENCE_SUMMSTATS_NSL_STANDARDIZATION_HPP
+#define SEQUENCE_SUMMSTATS_NSL_STANDARDIZATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/descriptiveStats.hpp>
+#include "nSLiHS.hpp"
+
+namespace Sequence
+{
+    class nSLiHSStandardizer
+    /*!
+      Accumulates the mean and variance of nSL and iHS within bins of
+      the count of the non-reference allele at the core site
+      (nSLiHS::core_count), so that scores may be standardized as
+      (x - mean) / sd, as described in \cite Ferrer-Admetlla2014-wa.
+
+      Scores are added one site, or one replicate, at a time, and only
+      the sums and sums of squares for each bin are stored.  Scores from
+      several replicates or chromosomes may be pooled by adding them to
+      the same object, or by adding objects together.  Scores that are
+      not finite are ignored.
+
+      \code
+      Sequence::nSLiHSStandardizer s(replicates[0].nsam(), 20);
+      for (auto& m : replicates)
+      {
+          s(Sequence::nsl(m, 0));
+      }
+      auto z = s.standardize(Sequence::nsl(replicates[0], 0));
+      \endcode
+
+      \ingroup popgenanalysis
+    */
+    {
+      private:
+        std::vector<Sums<double>> nsl_sums_, ihs_sums_;
+        std::size_t nsam_;
+        bool per_count;
+
+      public:
+        /*!
+          \param nsam The sample size
+          \param nbins The number of bins
+
+          If \a nbins is zero, each count from 0 to \a nsam has its own
+          bin.  Otherwise, the derived allele frequency is divided into
+          \a nbins bins of equal width, the last of which includes
+          a frequency of one.
+
+          std::invalid_argument is thrown if \a nsam is zero.
+        */
+        explicit nSLiHSStandardizer(const std::size_t nsam,
+                                    const std::size_t nbins = 0);
+
+        /// Add the scores for a single site
+        void operator()(const nSLiHS& x);
+        /// Add the scores for all sites
+        void operator()(const std::vector<nSLiHS>& x);
+        /// Pool the scores from \a other, which must have the same
+        /// sample size and number of bins, or std::invalid_argument
+        /// is thrown.
+        nSLiHSStandardizer& operator+=(const nSLiHSStandardizer& other);
+
+        std::size_t nsam() const;
+        std::size_t nbins() const;
+        /// The bin containing \a core_count.  std::invalid_argument
+        /// is thrown if \a core_count is negative or greater than the
+        /// sample size.
+        std::size_t bin(const std::int32_t core_count) const;
+        /// Sums of nSL in each bin
+        const std::vector<Sums<double>>& nsl_sums() const;
+        /// Sums of iHS in each bin
+        const std::vector<Sums<double>>& ihs_sums() const;
+
+        /*! \brief Standardize the scores of a site
+         *
+         * The returned nsl and ihs are not a number if the input is not
+         * finite, or if fewer than two finite values, or values with no
+         * variance, were added to the bin.  core_count is unchanged.
+         */
+        nSLiHS standardize(const nSLiHS& x) const;
+        /// Standardize the scores of all sites
+        std::vector<nSLiHS> standardize(const std::vector<nSLiHS>& x) const;
+    };
+
+    nSLiHSStandardizer operator+(const nSLiHSStandardizer& lhs,
+                                 const nSLiHSStandardizer& rhs);
+
+    struct ExtremeScoreWindows
+    /// \brief Results of Sequence::extreme_score_fractions
+    ///
+    /// Window i covers positions [start[i], stop[i]].  The numbers
+    /// of sites in the window with finite standardized nSL and iHS
+    /// are nsl_nscores[i] and ihs_nscores[i], and the fractions of
+    /// those whose absolute value exceeds the threshold are
+    /// nsl_fraction[i] and ihs_fraction[i].  The fractions are not
+    /// a number for windows without finite scores.
+    ///
+    /// \ingroup popgenanalysis
+    {
+        std::vector<double> start, stop;
+        std::vector<std::uint32_t> nsl_nscores, ihs_nscores;
+        std::vector<double> nsl_fraction, ihs_fraction;
+
+        /// Number of windows
+        std::size_t nwindows() const;
+    };
+
+    /*! \brief Fractions of extreme standardized scores in sliding windows
+     * \param m A VariantMatrix
+     * \param standardized Standardized scores for each site in \a m,
+     * as returned by nSLiHSStandardizer::standardize
+     * \param window_size The length of each window
+     * \param step_size The distance between the starts of adjacent windows
+     * \param threshold Scores whose absolute value exceeds this are extreme
+     *
+     * Windows are placed as for Sequence::sliding_window_summstats,
+     * and empty windows are reported.  Sites are added to, and removed
+     * from, running counts as the windows slide along the data.
+     *
+     * std::invalid_argument is thrown if \a window_size or \a step_size
+     * are not positive, or if the number of scores differs from the
+     * number of sites.
+     *
+     * \ingroup popgenanalysis
+     */
+    ExtremeScoreWindows
+    extreme_score_fractions(const VariantMatrix& m,
+                            const std::vector<nSLiHS>& standardized,
+                            const double window_size, const double step_size,
+                            const double threshold = 2.0);
+} // namespace Sequence
+
+#endif
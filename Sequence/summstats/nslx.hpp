@@ -6,6 +6,7 @@
 #include <vector>
 #include <cstdint>
 #include <Sequence/VariantMatrix.hpp>
+#include <Sequence/Executor.hpp>
 #include "nSLiHS.hpp"
 
 namespace Sequence
@@ -26,6 +27,24 @@ namespace Sequence
      */
     std::vector<nSLiHS> nslx(const VariantMatrix& m,
                              const std::int8_t refstate, const int x);
+
+    /*! \brief A variation on nSL/iHS, using several threads
+     * \param m A VariantMatrix
+     * \param refstate The ancestral state
+     * \param x Non-reference allele count
+     * \param executor Used to process ranges of core sites in parallel
+     *
+     * \return vector of nSLiHS
+     *
+     * The core sites are split into ranges, each of which starts by
+     * finding, for each pair of haplotypes, the last x-ton before the
+     * range at which they differ.  The results are identical to those
+     * of the version without an Executor.  See Sequence::Executor and
+     * Sequence::make_thread_executor.
+     */
+    std::vector<nSLiHS> nslx(const VariantMatrix& m,
+                             const std::int8_t refstate, const int x,
+                             const Executor& executor);
 } // namespace Sequence
 
 #endif
@@ -0,0 +1,98 @@
+/// \file Sequence/summstats/sliding_windows.hpp
+/// \brief "Classic" summaries of variation data in sliding windows.
+#ifndef SEQUENCE_SUMMSTATS_SLIDING_WINDOWS_HPP__
+#define SEQUENCE_SUMMSTATS_SLIDING_WINDOWS_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/AlleleCountMatrix.hpp>
+
+namespace Sequence
+{
+    /// Statistics that may be calculated by
+    /// Sequence::sliding_window_summstats
+    /// \ingroup popgenanalysis
+    enum class WindowStatistic
+    {
+        thetapi,
+        thetaw,
+        tajd,
+        hprime,
+        faywuh,
+        nvariable_sites
+    };
+
+    struct WindowStatisticsTable
+    /// \brief Results of Sequence::sliding_window_summstats
+    ///
+    /// The table is stored by column.  Row i describes the
+    /// window covering positions [start[i], stop[i]], which
+    /// contains nsites[i] sites.  columns[j] holds the values
+    /// of statistics[j] for each window.
+    ///
+    /// \ingroup popgenanalysis
+    {
+        std::vector<double> start, stop;
+        std::vector<std::uint32_t> nsites;
+        std::vector<WindowStatistic> statistics;
+        std::vector<std::vector<double>> columns;
+
+        /// Number of windows
+        std::size_t nwindows() const;
+
+        /// \brief Return the column for statistic \a s
+        ///
+        /// std::invalid_argument is thrown if \a s was not calculated.
+        const std::vector<double>& column(const WindowStatistic s) const;
+    };
+
+    /*! \brief Calculate statistics in sliding windows
+     * \param m A VariantMatrix
+     * \param c The AlleleCountMatrix for \a m
+     * \param window_size The length of each window
+     * \param step_size The distance between the starts of adjacent windows
+     * \param statistics The statistics to calculate
+     * \param refstate The ancestral state, used for Sequence::hprime
+     * and Sequence::faywuh
+     *
+     * The first window starts at the position of the first site in \a m,
+     * and windows are added until one starts after the last site.
+     * As for Sequence::make_window, the windows are closed intervals, and
+     * the value of each statistic equals that obtained by applying the
+     * corresponding function to Sequence::make_window(c, m, beg, end),
+     * up to rounding error.  Empty windows are reported.
+     *
+     * The contribution of each site is calculated once, and added to
+     * or removed from running totals as windows slide along the data.
+     * The time taken is therefore linear in the number of sites plus
+     * the number of windows, regardless of how much windows overlap.
+     *
+     * std::invalid_argument is thrown if \a window_size or \a step_size
+     * are not positive, if \a c and \a m have different numbers of sites,
+     * or if \a refstate is invalid and Sequence::WindowStatistic::hprime
+     * or Sequence::WindowStatistic::faywuh are requested.
+     *
+     * \ingroup popgenanalysis
+     */
+    WindowStatisticsTable
+    sliding_window_summstats(const VariantMatrix& m, const AlleleCountMatrix& c,
+                             const double window_size, const double step_size,
+                             const std::vector<WindowStatistic>& statistics,
+                             const std::int8_t refstate = 0);
+
+    /*! \brief Calculate statistics in sliding windows
+     *
+     * Allele counts are obtained from \a m.  See the overload taking
+     * an AlleleCountMatrix for details.
+     *
+     * \ingroup popgenanalysis
+     */
+    WindowStatisticsTable
+    sliding_window_summstats(const VariantMatrix& m, const double window_size,
+                             const double step_size,
+                             const std::vector<WindowStatistic>& statistics,
+                             const std::int8_t refstate = 0);
+} // namespace Sequence
+
+#endif
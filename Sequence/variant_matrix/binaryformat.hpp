@@ -0,0 +1,183 @@
+#ifndef SEQUENCE_VARIANT_MATRIX_BINARYFORMAT_HPP__
+#define SEQUENCE_VARIANT_MATRIX_BINARYFORMAT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+
+namespace Sequence
+{
+    /// \brief Compression of the blocks of a file written by
+    /// Sequence::BinaryFormatWriter.
+    /// \ingroup variantmatrix
+    enum class BinaryFormatCompression : std::uint8_t
+    {
+        none = 0,
+        zlib = 1,
+        zstd = 2
+    };
+
+    /// \brief Whether \a c is available in this build of libsequence.
+    ///
+    /// zlib and zstd are available if they were found by ./configure.
+    /// \ingroup variantmatrix
+    bool binaryformat_supports(const BinaryFormatCompression c);
+
+    class BinaryFormatWriter
+    /*! \brief Write sites of VariantMatrix objects to a block-compressed
+     * binary file.
+     *
+     * Sites are grouped into blocks of a fixed number of sites.  Each
+     * block holds the positions, as doubles, followed by the genotypes
+     * in row-major order, and is compressed separately.  The file is:
+     *
+     * - A 48 byte header:
+     *   - 8 bytes: the characters "LIBSEQVB"
+     *   - 4 byte unsigned integer: the format version
+     *   - 1 byte signed integer: the maximum allelic state
+     *   - 1 byte unsigned integer: the BinaryFormatCompression
+     *   - 2 bytes of padding
+     *   - 8 byte unsigned integers: the number of sites, the sample
+     *     size, the number of sites per block, and the number of blocks
+     * - The compressed blocks
+     * - An index holding, for each block, the offset of the block in
+     *   the file, its compressed size, and its uncompressed size, as
+     *   8 byte unsigned integers
+     * - 8 byte unsigned integer: the offset of the index
+     * - 8 bytes: the characters "LIBSEQVB"
+     *
+     * Numbers are stored in the native byte order of the machine
+     * writing the file.  The header is completed by close().
+     *
+     * \ingroup variantmatrix
+     * \version 1.9.8
+     */
+    {
+      private:
+        std::ofstream out;
+        std::string filename;
+        BinaryFormatCompression compression;
+        std::size_t nsam, sites_per_block, nsites;
+        std::int8_t max_allele;
+        bool have_nsam, closed;
+        // Sites waiting to fill a block
+        std::vector<double> positions;
+        std::vector<std::int8_t> genotypes;
+        // Offset, compressed size, and uncompressed size of each block
+        std::vector<std::uint64_t> index;
+        std::vector<char> raw, compressed;
+        void write_block();
+
+      public:
+        /*! \param filename The output file name
+         * \param compression The compression of each block
+         * \param sites_per_block The number of sites in each block
+         *
+         * std::invalid_argument is thrown if \a compression is not
+         * supported or \a sites_per_block is zero, and
+         * std::runtime_error is thrown if the file cannot be opened.
+         */
+        BinaryFormatWriter(
+            const std::string& filename,
+            const BinaryFormatCompression compression
+            = BinaryFormatCompression::none,
+            const std::size_t sites_per_block = 4096);
+        /// Calls close(), ignoring any errors.
+        ~BinaryFormatWriter();
+        BinaryFormatWriter(const BinaryFormatWriter&) = delete;
+        BinaryFormatWriter& operator=(const BinaryFormatWriter&) = delete;
+
+        /// \brief Append the sites of \a m.
+        ///
+        /// std::invalid_argument is thrown if the sample size differs
+        /// from that of previous calls.
+        void write(const VariantMatrix& m);
+        /// \brief Write the remaining sites, the index, and the header.
+        ///
+        /// std::runtime_error is thrown if writing fails.
+        void close();
+    };
+
+    class BinaryFormatReader
+    /*! \brief Random access to the blocks of a file written by
+     * Sequence::BinaryFormatWriter.
+     *
+     * Only the header and the index are read when the file is opened.
+     * Ranges of sites are read by decompressing only the blocks
+     * containing them.  Matrices returned use the default, vector-based,
+     * storage.  An object may not be used by several threads at once,
+     * but several objects may read the same file.
+     *
+     * std::runtime_error is thrown if the file cannot be read, is not
+     * in the expected format, uses a compression that is not supported,
+     * or is damaged.
+     *
+     * \ingroup variantmatrix
+     * \version 1.9.8
+     */
+    {
+      private:
+        mutable std::ifstream in;
+        std::string filename;
+        BinaryFormatCompression compression_;
+        std::size_t nsites_, nsam_, sites_per_block_;
+        std::int8_t max_allele_;
+        std::vector<std::uint64_t> index;
+        mutable std::vector<char> raw, compressed;
+        void read_block(const std::size_t block) const;
+
+      public:
+        explicit BinaryFormatReader(const std::string& filename);
+        std::size_t nsites() const;
+        std::size_t nsam() const;
+        std::int8_t max_allele() const;
+        BinaryFormatCompression compression() const;
+        std::size_t sites_per_block() const;
+        std::size_t nblocks() const;
+        /// The sites [first, last) contained in \a block.
+        std::pair<std::size_t, std::size_t>
+        block_sites(const std::size_t block) const;
+        /// \brief Read sites [first, last).
+        ///
+        /// std::out_of_range is thrown if last > nsites() or
+        /// first > last.  The maximum allelic state of the returned
+        /// matrix is that of the whole file.
+        VariantMatrix read_sites(const std::size_t first,
+                                 const std::size_t last) const;
+        /// Read the sites in \a block
+        VariantMatrix read_block_matrix(const std::size_t block) const;
+        /// Read all sites
+        VariantMatrix read() const;
+    };
+
+    /*! \brief Write \a m to a block-compressed binary file
+     * \param m A VariantMatrix
+     * \param filename The output file name
+     * \param compression The compression of each block
+     * \param sites_per_block The number of sites in each block
+     *
+     * See Sequence::BinaryFormatWriter for details.
+     *
+     * \ingroup variantmatrix
+     * \version 1.9.8
+     */
+    void to_binaryformat(const VariantMatrix& m, const std::string& filename,
+                         const BinaryFormatCompression compression
+                         = BinaryFormatCompression::none,
+                         const std::size_t sites_per_block = 4096);
+
+    /*! \brief Read a file written by Sequence::to_binaryformat
+     *
+     * See Sequence::BinaryFormatReader for details.
+     *
+     * \ingroup variantmatrix
+     * \version 1.9.8
+     */
+    VariantMatrix from_binaryformat(const std::string& filename);
+} // namespace Sequence
+
+#endif
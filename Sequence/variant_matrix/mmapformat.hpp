@@ -0,0 +1,49 @@
+#ifndef SEQUENCE_VARIANT_MATRIX_MMAPFORMAT_HPP__
+#define SEQUENCE_VARIANT_MATRIX_MMAPFORMAT_HPP__
+
+#include <string>
+#include <Sequence/VariantMatrix.hpp>
+
+namespace Sequence
+{
+    /*! \brief Write a VariantMatrix to a binary file that
+     * can be memory-mapped by from_mmapformat.
+     * \param m A VariantMatrix
+     * \param filename The output file name
+     * \ingroup variantmatrix
+     *
+     * The file contains a 32 byte header, the positions
+     * as doubles, and the genotypes in row-major order.
+     * The header is:
+     *
+     * - 8 bytes: the characters "LIBSEQVM"
+     * - 4 byte unsigned integer: the format version
+     * - 1 byte signed integer: \a m.max_allele()
+     * - 3 bytes of padding
+     * - 8 byte unsigned integer: \a m.nsites()
+     * - 8 byte unsigned integer: \a m.nsam()
+     *
+     * Numbers are stored in the native byte order of the machine
+     * writing the file.
+     *
+     * std::runtime_error is thrown if the file cannot be written.
+     */
+    void to_mmapformat(const VariantMatrix& m, const std::string& filename);
+
+    /*! \brief Create a VariantMatrix by memory-mapping a file
+     * written by to_mmapformat.
+     * \param filename The input file name
+     * \return A VariantMatrix using Sequence::MmapGenotypeCapsule
+     * and Sequence::MmapPositionCapsule.
+     * \ingroup variantmatrix
+     *
+     * No data are copied.  The returned object is read-only,
+     * and VariantMatrix::deepcopy shares the same mapping.
+     *
+     * std::runtime_error is thrown if the file cannot be mapped or
+     * is not in the expected format.
+     */
+    VariantMatrix from_mmapformat(const std::string& filename);
+} // namespace Sequence
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef SEQUENCE_VARIANT_MATRIX_MS_PIPELINE_HPP__
+#define SEQUENCE_VARIANT_MATRIX_MS_PIPELINE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/Executor.hpp>
+#include <Sequence/summstats/classics.hpp>
+
+namespace Sequence
+{
+    namespace internal
+    {
+        /// Called on a worker thread for each replicate.  Returns
+        /// a function, called on the reading thread in the order of
+        /// the replicates, that passes on the result.
+        using ms_pipeline_task
+            = std::function<std::function<void(std::size_t)>(
+                const VariantMatrix&)>;
+
+        /// Implementation of Sequence::analyze_msformat
+        std::size_t run_ms_pipeline(std::istream& input,
+                                    const ms_pipeline_task& task,
+                                    const unsigned nthreads,
+                                    const std::size_t queue_depth);
+
+        /// Implementation of Sequence::analyze_msformat
+        /// taking a Sequence::Executor
+        std::size_t run_ms_pipeline(std::istream& input,
+                                    const ms_pipeline_task& task,
+                                    const Executor& executor,
+                                    const std::size_t batch_size);
+
+        template <typename Statistics, typename Consumer>
+        inline ms_pipeline_task
+        make_ms_pipeline_task(const Statistics& statistics,
+                              const Consumer& consume)
+        {
+            using result_type = typename std::decay<decltype(
+                statistics(std::declval<const VariantMatrix&>()))>::type;
+            return [&statistics, &consume](const VariantMatrix& m) {
+                auto result = std::make_shared<result_type>(statistics(m));
+                return std::function<void(std::size_t)>(
+                    [result, &consume](const std::size_t replicate) {
+                        consume(replicate, std::move(*result));
+                    });
+            };
+        }
+    } // namespace internal
+
+    /*! \brief Analyze replicates of "ms"-like output on several threads
+     * \param input A stream of ms, mspms, or discoal output
+     * \param statistics Called as statistics(const VariantMatrix&)
+     * for each replicate
+     * \param consume Called as consume(std::size_t replicate, result)
+     * with the return value of \a statistics for each replicate
+     * \param nthreads Number of threads calling \a statistics.  If zero,
+     * std::thread::hardware_concurrency() is used.
+     * \param queue_depth Maximum number of replicates that have been
+     * read but not yet passed to \a consume.  If zero, twice the number
+     * of threads is used.
+     * \return The number of replicates
+     *
+     * The calling thread reads replicates with Sequence::MsFormatReader
+     * into a bounded queue, from which worker threads take them to call
+     * \a statistics.  Results are passed to \a consume on the calling
+     * thread, in the order of the replicates, so \a consume need not be
+     * thread-safe.  \a statistics may be called concurrently for
+     * different replicates.  Memory use is bounded by \a queue_depth,
+     * and the storage of each queued VariantMatrix is reused.
+     *
+     * If \a statistics or \a consume throws, or the input is malformed,
+     * the workers are stopped and the exception is rethrown.
+     *
+     * \code
+     * Sequence::analyze_msformat(
+     *     std::cin,
+     *     [](const Sequence::VariantMatrix& m) {
+     *         return Sequence::thetapi(Sequence::AlleleCountMatrix(m));
+     *     },
+     *     [](std::size_t replicate, double pi) {
+     *         std::cout << replicate << ' ' << pi << '\n';
+     *     });
+     * \endcode
+     *
+     * \ingroup variantmatrix
+     * \version 1.9.8
+     */
+    template <typename Statistics, typename Consumer>
+    inline std::size_t
+    analyze_msformat(std::istream& input, const Statistics& statistics,
+                     const Consumer& consume, const unsigned nthreads = 0,
+                     const std::size_t queue_depth = 0)
+    {
+        return internal::run_ms_pipeline(
+            input, internal::make_ms_pipeline_task(statistics, consume),
+            nthreads, queue_depth);
+    }
+
+    /*! \brief Analyze replicates of "ms"-like output using an Executor
+     * \param input A stream of ms, mspms, or discoal output
+     * \param statistics Called as statistics(const VariantMatrix&)
+     * for each replicate
+     * \param consume Called as consume(std::size_t replicate, result)
+     * with the return value of \a statistics for each replicate
+     * \param executor Runs the calls to \a statistics
+     * \param batch_size Number of replicates passed to \a executor
+     * at once
+     * \return The number of replicates
+     *
+     * Unlike the overload taking a number of threads, which keeps its
+     * own workers busy for as long as there is input, this overload
+     * lets a Sequence::ThreadPool be shared with other work.  An
+     * Executor returns only once all of its tasks have finished, so
+     * replicates are analyzed in batches.  Each call to \a executor
+     * runs \a statistics for a batch of \a batch_size replicates
+     * together with a task that reads the next batch, so that at most
+     * twice \a batch_size replicates are held in memory.  Results are
+     * passed to \a consume on the calling thread, in the order of the
+     * replicates.  An empty Executor analyzes the replicates on the
+     * calling thread.
+     *
+     * std::invalid_argument is thrown if \a batch_size is zero.
+     * Exceptions thrown by \a statistics, \a consume, or the reader
+     * are rethrown.
+     *
+     * \ingroup variantmatrix
+     * \version 1.9.8
+     */
+    template <typename Statistics, typename Consumer>
+    inline std::size_t
+    analyze_msformat(std::istream& input, const Statistics& statistics,
+                     const Consumer& consume, const Executor& executor,
+                     const std::size_t batch_size = 64)
+    {
+        return internal::run_ms_pipeline(
+            input, internal::make_ms_pipeline_task(statistics, consume),
+            executor, batch_size);
+    }
+
+    /*! \brief "Classic" statistics for each replicate of "ms"-like output
+     * \param input A stream of ms, mspms, or discoal output
+     * \param refstate The ancestral state
+     * \param nthreads Number of worker threads
+     * \param queue_depth Maximum number of replicates in the queue
+     * \return The statistics for each replicate, in order
+     *
+     * Uses Sequence::analyze_msformat to apply
+     * Sequence::classic_summstats to each replicate.
+     *
+     * \ingroup popgenanalysis
+     * \version 1.9.8
+     */
+    std::vector<ClassicSummaryStatistics>
+    msformat_classic_summstats(std::istream& input,
+                               const std::int8_t refstate = 0,
+                               const unsigned nthreads = 0,
+                               const std::size_t queue_depth = 0);
+} // namespace Sequence
+
+#endif
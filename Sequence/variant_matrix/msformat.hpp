@@ -2,6 +2,9 @@
 #define SEQUENCE_VARIANT_MATRIX_MSFORMAT_HPP__
 
 #include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
 
@@ -9,85 +12,130 @@ namespace Sequence
 {
     /// \example ms_to_VariantMatrix.cc
 
+    class MsFormatReader
+    /*! \brief Read replicates from "ms"-like output one at a time
+     *
+     * The output of ms, msprime's mspms, and discoal contains any
+     * number of replicates, each starting with a line beginning with
+     * "//".  Lines between that and the "segsites:" line, such as
+     * trees, are skipped.
+     *
+     * Characters are taken directly from the stream's buffer, without
+     * formatted input.  Genotypes are written straight into row-major
+     * order, and next(VariantMatrix&) reuses the memory of the matrix
+     * passed to it, so that reading many replicates of similar size
+     * allocates almost nothing after the first.  The stream is not
+     * read beyond the end of a replicate, other than whitespace, and
+     * its eofbit is set when no more input remains.
+     *
+     * \code
+     * Sequence::MsFormatReader reader(std::cin);
+     * Sequence::VariantMatrix m(std::vector<std::int8_t>{},
+     *                           std::vector<double>{});
+     * while (reader.next(m))
+     *     {
+     *         // analyze m
+     *     }
+     * \endcode
+     *
+     * \ingroup variantmatrix
+     * \version 1.9.8
+     */
+    {
+      private:
+        std::istream& input;
+        std::string line;
+        // Genotype lines waiting to be written into the matrix
+        std::vector<char> block;
+        std::size_t nsam_hint, nreplicates_;
+        bool read_line();
+        void skip_whitespace();
+
+      public:
+        explicit MsFormatReader(std::istream& input_stream);
+        /*! \brief Read the next replicate into \a m
+         *
+         * The storage of \a m is reused when possible.  See
+         * VariantMatrix::release.  If there are no more replicates,
+         * false is returned and \a m is unchanged.
+         *
+         * Alleles '0' through '9' are stored as 0 through 9.
+         * std::runtime_error is thrown for malformed input.
+         */
+        bool next(VariantMatrix& m);
+        /// Read the next replicate.  std::runtime_error is thrown
+        /// if there are no more replicates.
+        VariantMatrix next();
+        /// The number of replicates read
+        std::size_t nreplicates() const;
+    };
+
     /*! \brief Create VariantMatrix from "ms"-like input format
      * \param input_stream A model of std::istream
      * \return A VariantMatrix
      * \ingroup variantmatrix
      *
+     * Reads one replicate using Sequence::MsFormatReader.  If there
+     * are no more replicates, the returned VariantMatrix is empty.
+     * To read many replicates, use an MsFormatReader directly.
+     *
      * See ms_to_VariantMatrix.cc for example.
      */
     template <typename streamtype>
     inline VariantMatrix
     from_msformat(streamtype& input_stream)
     {
-        char ch;
-        while (!input_stream.eof())
-            {
-                input_stream >> ch;
-                if (ch == ':')
-                    break;
-            }
-        std::string temp;
-        std::size_t S;
-        input_stream >> S >> temp;
-        std::vector<double> pos(S);
-        for (std::size_t i = 0; i < S; ++i)
-            {
-                input_stream >> pos[i];
-            }
-        std::vector<std::int8_t> data;
-        char next_token;
-        while (!input_stream.eof()
-               && static_cast<char>(input_stream.peek()) != '/')
-            {
-                input_stream >> next_token >> std::ws;
-                data.push_back((next_token == '0') ? 0 : 1);
-            }
-        input_stream >> std::ws;
-        //We now have to transpose the input matrix
-        decltype(data) data_t(data.size(), -1);
-        std::size_t nsam = data.size() / static_cast<std::size_t>(S);
-        std::size_t k = 0;
-        for (std::size_t i = 0; i < static_cast<std::size_t>(S); ++i)
-            {
-                for (std::size_t j = 0; j < nsam; ++j)
-                    {
-                        data_t[k++] = data[i + j * S];
-                    }
-            }
-        return VariantMatrix(std::move(data_t), std::move(pos));
+        VariantMatrix m(std::vector<std::int8_t>{}, std::vector<double>{});
+        MsFormatReader(input_stream).next(m);
+        return m;
     }
 
-    template <typename output_stream>
-    inline void
-    to_msformat(const VariantMatrix& m, output_stream& o)
+    class MsFormatWriter
+    /*! \brief Write replicates in "ms" format
+     *
+     * Each replicate is written as by Sequence::to_msformat, followed
+     * by a blank line, so that the output may be read back with
+     * Sequence::MsFormatReader.
+     *
+     * Haplotype lines are formatted into a buffer, reused for all
+     * replicates, from blocks of haplotypes transposed out of the
+     * row-major genotypes, and passed to the stream in large writes.
+     * Positions are formatted without the stream's formatted output,
+     * giving the same characters as the stream would for its current
+     * precision and its default or fixed floating-point format.  Other
+     * formats, and values whose last digit cannot be rounded with
+     * certainty, are passed to the stream's operator<<.
+     *
+     * \ingroup variantmatrix
+     * \version 1.9.8
+     */
+    {
+      private:
+        std::ostream& output;
+        std::vector<char> buffer;
+        std::size_t nreplicates_;
+
+      public:
+        explicit MsFormatWriter(std::ostream& output_stream);
+        /// Write \a m
+        void write(const VariantMatrix& m);
+        /// The number of replicates written
+        std::size_t nreplicates() const;
+    };
+
     /*! \brief Write VariantMatrix in "ms" format.
      * \param m A VariantMatrix
-     * \param o A model of std::ostream
+     * \param o An output stream
      * \ingroup variantmatrix
      *
+     * Genotypes are written as integers, so alleles other than 0 through
+     * 9, or missing data, give lines of varying length.  The last
+     * haplotype is not followed by a newline.
+     * To write many replicates, use Sequence::MsFormatWriter.
+     *
      * See ms_to_VariantMatrix.cc for example.
      */
-    {
-        o << "//\nsegsites: " << m.nsites() << "\npositions: ";
-        for (auto p = m.cpbegin(); p < m.cpend(); ++p)
-        {
-            o << *p << ' ';
-        }
-        o << '\n';
-        for (std::size_t i = 0; i < m.nsam(); ++i)
-            {
-                auto col = get_ConstColView(m, i);
-                for (auto state : col)
-                    {
-                        o << static_cast<int>(state);
-                    }
-                if (i < m.nsam() - 1)
-                    {
-                        o << '\n';
-                    }
-            }
-    }
+    void to_msformat(const VariantMatrix& m, std::ostream& o);
 } // namespace Sequence
 
 #endif
@@ -6,6 +6,7 @@
 #include <stdexcept>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/AlleleCountMatrix.hpp>
 
 namespace Sequence
 {
@@ -28,12 +29,37 @@ namespace Sequence
      * The result is a variant matrix including positions [beg,end]
      * and samples [i,j) from \a m.  Note that the sample interval is 
      * half-open!
+     *
+     * The result refers to the data of \a m, unless \a m is stored
+     * in tiles (Sequence::TiledGenotypeCapsule::tiled() is true), in
+     * which case the genotypes of the slice are copied from the tiles
+     * covering it.
      */
     
     VariantMatrix make_slice(const VariantMatrix& m, const double beg,
                              const double end,
                              const std::size_t i,
                              const std::size_t j);
+
+    /*! \brief Return the allele counts for a window
+     * \param c The AlleleCountMatrix for \a m
+     * \param m A VariantMatrix
+     * \param beg Beginning of window
+     * \param end End of window
+     *
+     * The result contains the rows of \a c for the sites
+     * of \a m at positions [beg,end], and shares its data with \a c.
+     * Thus, statistics may be calculated for many windows
+     * while only counting the genotypes in \a m once.
+     *
+     * std::invalid_argument is thrown if \a c has a different number of
+     * rows than \a m has sites.
+     *
+     * \ingroup variantmatrix
+     */
+    AlleleCountMatrix make_window(const AlleleCountMatrix& c,
+                                  const VariantMatrix& m, const double beg,
+                                  const double end);
 } // namespace Sequence
 
 #endif
@@ -1,5 +1,6 @@
 /*! \include ms_to_VariantMatrix.cc */
 #include <iostream>
+#include <vector>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
 #include <Sequence/variant_matrix/msformat.hpp>
@@ -7,11 +8,14 @@
 int
 main(int argc, char** argv)
 {
-    do
+    // The reader reuses the memory of vm for each replicate,
+    // and the writer reuses its buffer.
+    Sequence::MsFormatReader reader(std::cin);
+    Sequence::MsFormatWriter writer(std::cout);
+    Sequence::VariantMatrix vm(std::vector<std::int8_t>{},
+                               std::vector<double>{});
+    while (reader.next(vm))
         {
-            auto vm = Sequence::from_msformat(std::cin);
-            Sequence::to_msformat(vm, std::cout);
-            std::cout << '\n';
+            writer.write(vm);
         }
-    while (!std::cin.eof());
 }
@@ -0,0 +1,143 @@
+#include <Sequence/Executor.hpp>
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+namespace Sequence
+{
+    ThreadPool::ThreadPool(unsigned nthreads)
+        : workers{}, queue{}, queue_mutex{}, queue_cv{}, stopping(false)
+    {
+        if (nthreads == 0)
+            {
+                nthreads = std::max(1u, std::thread::hardware_concurrency());
+            }
+        workers.reserve(nthreads);
+        for (unsigned i = 0; i < nthreads; ++i)
+            {
+                workers.emplace_back(&ThreadPool::work, this);
+            }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        for (auto& w : workers)
+            {
+                w.join();
+            }
+    }
+
+    void
+    ThreadPool::work()
+    {
+        for (;;)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex);
+                    queue_cv.wait(lock, [this]() {
+                        return stopping || !queue.empty();
+                    });
+                    if (queue.empty())
+                        {
+                            return;
+                        }
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                }
+                task();
+            }
+    }
+
+    std::size_t
+    ThreadPool::size() const
+    {
+        return workers.size();
+    }
+
+    void
+    ThreadPool::run(const std::vector<std::function<void()>>& tasks)
+    {
+        if (tasks.empty())
+            {
+                return;
+            }
+        // State shared by the tasks of this call
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+        std::size_t remaining = tasks.size();
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            for (auto& t : tasks)
+                {
+                    auto task = &t;
+                    queue.emplace_back([task, &done_mutex, &done_cv,
+                                        &remaining, &error]() {
+                        std::exception_ptr e;
+                        try
+                            {
+                                (*task)();
+                            }
+                        catch (...)
+                            {
+                                e = std::current_exception();
+                            }
+                        std::lock_guard<std::mutex> done_lock(done_mutex);
+                        if (e && !error)
+                            {
+                                error = e;
+                            }
+                        if (--remaining == 0)
+                            {
+                                done_cv.notify_one();
+                            }
+                    });
+                }
+        }
+        queue_cv.notify_all();
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&remaining]() { return remaining == 0; });
+        if (error)
+            {
+                std::rethrow_exception(error);
+            }
+    }
+
+    Executor
+    make_thread_executor(const unsigned nthreads)
+    {
+        auto pool = std::make_shared<ThreadPool>(nthreads);
+        return [pool](const std::vector<std::function<void()>>& tasks) {
+            pool->run(tasks);
+        };
+    }
+
+    Executor
+    make_thread_executor(ThreadPool& pool)
+    {
+        return [&pool](const std::vector<std::function<void()>>& tasks) {
+            pool.run(tasks);
+        };
+    }
+
+    void
+    run_tasks(const Executor& executor,
+              const std::vector<std::function<void()>>& tasks)
+    {
+        if (!executor)
+            {
+                for (auto& t : tasks)
+                    {
+                        t();
+                    }
+                return;
+            }
+        executor(tasks);
+    }
+} // namespace Sequence
@@ -0,0 +1,378 @@
+#include <Sequence/IndexedFasta.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "../read_only_mapping.hpp"
+
+namespace
+{
+    std::vector<Sequence::FastaIndexEntry>
+    index_fasta(const char* data, const std::size_t size,
+                const std::string& filename)
+    // Follows samtools faidx: all lines of a record, other than
+    // the last, must have the same length, and the end of a line
+    // may be "\n" or "\r\n".
+    {
+        std::vector<Sequence::FastaIndexEntry> rv;
+        const char* p = data;
+        const char* const end = data + size;
+        while (p < end && (*p == '\n' || *p == '\r'))
+            {
+                ++p;
+            }
+        while (p < end)
+            {
+                if (*p != '>')
+                    {
+                        throw std::runtime_error(filename
+                                                 + " is not in FASTA format");
+                    }
+                auto eol = static_cast<const char*>(
+                    std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+                if (eol == nullptr)
+                    {
+                        eol = end;
+                    }
+                auto name_end = p + 1;
+                while (name_end < eol
+                       && !std::isspace(static_cast<unsigned char>(*name_end)))
+                    {
+                        ++name_end;
+                    }
+                Sequence::FastaIndexEntry e{ std::string(p + 1, name_end), 0,
+                                             0, 0, 0 };
+                p = (eol == end) ? end : eol + 1;
+                e.offset = static_cast<std::uint64_t>(p - data);
+                bool short_line = false;
+                while (p < end && *p != '>')
+                    {
+                        auto nl = static_cast<const char*>(std::memchr(
+                            p, '\n', static_cast<std::size_t>(end - p)));
+                        const bool has_newline = nl != nullptr;
+                        if (!has_newline)
+                            {
+                                nl = end;
+                            }
+                        const std::uint64_t width
+                            = static_cast<std::uint64_t>(nl - p) + has_newline;
+                        std::uint64_t bases
+                            = static_cast<std::uint64_t>(nl - p);
+                        if (bases > 0 && nl[-1] == '\r')
+                            {
+                                --bases;
+                            }
+                        p += width;
+                        if (bases == 0)
+                            {
+                                // Blank lines may only end a record
+                                short_line = true;
+                                continue;
+                            }
+                        if (e.line_bases == 0)
+                            {
+                                e.line_bases = bases;
+                                e.line_width = width;
+                            }
+                        else if (short_line || bases > e.line_bases
+                                 || (has_newline && bases == e.line_bases
+                                     && width != e.line_width))
+                            {
+                                throw std::runtime_error(
+                                    filename + ": lines of record " + e.name
+                                    + " differ in length");
+                            }
+                        short_line = bases < e.line_bases;
+                        e.length += bases;
+                    }
+                rv.emplace_back(std::move(e));
+            }
+        return rv;
+    }
+} // namespace
+
+namespace Sequence
+{
+    FastaView::FastaView(const char* record, const std::size_t first,
+                         const std::size_t length, const std::size_t lb,
+                         const std::size_t lw)
+        : line(record), column(0), length_(length),
+          line_bases(std::max<std::size_t>(lb, 1)),
+          line_width(std::max<std::size_t>(lw, 1))
+    {
+        line += (first / line_bases) * line_width;
+        column = first % line_bases;
+    }
+
+    std::size_t
+    FastaView::size() const
+    {
+        return length_;
+    }
+
+    bool
+    FastaView::empty() const
+    {
+        return length_ == 0;
+    }
+
+    char
+    FastaView::operator[](const std::size_t i) const
+    {
+        const auto j = column + i;
+        return line[(j / line_bases) * line_width + j % line_bases];
+    }
+
+    FastaView::const_iterator
+    FastaView::begin() const
+    {
+        return const_iterator(line, column, line_bases, line_width);
+    }
+
+    FastaView::const_iterator
+    FastaView::end() const
+    {
+        return begin() + static_cast<std::ptrdiff_t>(length_);
+    }
+
+    bool
+    FastaView::contiguous() const
+    {
+        return column + length_ <= line_bases;
+    }
+
+    const char*
+    FastaView::data() const
+    {
+        return line + column;
+    }
+
+    void
+    FastaView::append_to(std::string& s) const
+    {
+        auto p = line;
+        auto c = column;
+        auto remaining = length_;
+        while (remaining)
+            {
+                const auto n = std::min(line_bases - c, remaining);
+                s.append(p + c, n);
+                remaining -= n;
+                p += line_width;
+                c = 0;
+            }
+    }
+
+    std::string
+    FastaView::str() const
+    {
+        std::string rv;
+        rv.reserve(length_);
+        append_to(rv);
+        return rv;
+    }
+
+    std::vector<FastaIndexEntry>
+    build_fasta_index(const std::string& filename)
+    {
+        internal::read_only_mapping f(filename);
+        return index_fasta(f.data, f.size, filename);
+    }
+
+    void
+    write_fasta_index(const std::vector<FastaIndexEntry>& index,
+                      const std::string& filename)
+    {
+        std::ofstream out(filename);
+        if (!out)
+            {
+                throw std::runtime_error("could not open " + filename);
+            }
+        for (auto& e : index)
+            {
+                out << e.name << '\t' << e.length << '\t' << e.offset << '\t'
+                    << e.line_bases << '\t' << e.line_width << '\n';
+            }
+        out.close();
+        if (!out)
+            {
+                throw std::runtime_error("error writing to " + filename);
+            }
+    }
+
+    std::vector<FastaIndexEntry>
+    read_fasta_index(const std::string& filename)
+    {
+        std::ifstream in(filename);
+        if (!in)
+            {
+                throw std::runtime_error("could not open " + filename);
+            }
+        std::vector<FastaIndexEntry> rv;
+        std::string line;
+        while (std::getline(in, line))
+            {
+                if (line.empty())
+                    {
+                        continue;
+                    }
+                std::istringstream fields(line);
+                FastaIndexEntry e;
+                if (!std::getline(fields, e.name, '\t')
+                    || !(fields >> e.length >> e.offset >> e.line_bases
+                         >> e.line_width))
+                    {
+                        throw std::runtime_error(filename
+                                                 + " is not in .fai format");
+                    }
+                rv.emplace_back(std::move(e));
+            }
+        return rv;
+    }
+
+    IndexedFasta::IndexedFasta(const std::string& filename)
+        : file(std::make_shared<const internal::read_only_mapping>(filename)),
+          index_(), lookup()
+    {
+        const auto fai = filename + ".fai";
+        if (std::ifstream(fai))
+            {
+                index_ = read_fasta_index(fai);
+            }
+        else
+            {
+                index_ = index_fasta(file->data, file->size, filename);
+            }
+        check_index(filename);
+    }
+
+    IndexedFasta::IndexedFasta(const std::string& filename,
+                               const std::string& fai_filename)
+        : file(std::make_shared<const internal::read_only_mapping>(filename)),
+          index_(read_fasta_index(fai_filename)), lookup()
+    {
+        check_index(filename);
+    }
+
+    void
+    IndexedFasta::check_index(const std::string& filename)
+    // Make sure that all bases are within the file,
+    // so that views never read outside of the mapping.
+    {
+        lookup.reserve(index_.size());
+        for (std::size_t i = 0; i < index_.size(); ++i)
+            {
+                const auto& e = index_[i];
+                // An empty record must still start within the file.
+                bool valid = e.offset <= file->size;
+                if (valid && e.length > 0)
+                    {
+                        valid = e.line_bases > 0
+                                && e.line_width >= e.line_bases
+                                && e.offset < file->size
+                                && (e.length - 1) / e.line_bases
+                                       <= (file->size - e.offset)
+                                              / e.line_width
+                                && e.offset
+                                           + (e.length - 1) / e.line_bases
+                                                 * e.line_width
+                                           + (e.length - 1) % e.line_bases
+                                       < file->size;
+                    }
+                if (!valid)
+                    {
+                        throw std::runtime_error(
+                            "index of " + filename
+                            + " does not match the file at record " + e.name);
+                    }
+                if (!lookup.emplace(e.name, i).second)
+                    {
+                        throw std::runtime_error(filename
+                                                 + " has more than one record "
+                                                   "named "
+                                                 + e.name);
+                    }
+            }
+    }
+
+    std::size_t
+    IndexedFasta::size() const
+    {
+        return index_.size();
+    }
+
+    const std::vector<FastaIndexEntry>&
+    IndexedFasta::index() const
+    {
+        return index_;
+    }
+
+    bool
+    IndexedFasta::contains(const std::string& name) const
+    {
+        return lookup.find(name) != lookup.end();
+    }
+
+    std::size_t
+    IndexedFasta::record(const std::string& name) const
+    {
+        auto i = lookup.find(name);
+        if (i == lookup.end())
+            {
+                throw std::out_of_range("no record named " + name);
+            }
+        return i->second;
+    }
+
+    FastaView
+    IndexedFasta::view(const std::size_t i) const
+    {
+        const auto& e = index_.at(i);
+        return FastaView(file->data + e.offset, 0, e.length, e.line_bases,
+                         e.line_width);
+    }
+
+    FastaView
+    IndexedFasta::view(const std::string& name) const
+    {
+        return view(record(name));
+    }
+
+    FastaView
+    IndexedFasta::view(const std::string& name, const std::size_t beg,
+                       const std::size_t end) const
+    {
+        const auto& e = index_[record(name)];
+        if (beg > end || end > e.length)
+            {
+                throw std::out_of_range("region out of range for record "
+                                        + name);
+            }
+        return FastaView(file->data + e.offset, beg, end - beg, e.line_bases,
+                         e.line_width);
+    }
+
+    Fasta
+    IndexedFasta::fasta(const std::size_t i) const
+    {
+        return Fasta(std::string(index_.at(i).name), view(i).str());
+    }
+
+    Fasta
+    IndexedFasta::fasta(const std::string& name) const
+    {
+        return fasta(record(name));
+    }
+
+    Fasta
+    IndexedFasta::fasta(const std::string& name, const std::size_t beg,
+                        const std::size_t end) const
+    {
+        auto v = view(name, beg, end);
+        return Fasta(name + ':' + std::to_string(beg + 1) + '-'
+                         + std::to_string(end),
+                     v.str());
+    }
+} // namespace Sequence
@@ -0,0 +1,75 @@
+#ifndef SEQUENCE_READ_ONLY_MAPPING_HPP
+#define SEQUENCE_READ_ONLY_MAPPING_HPP
+
+// This type is not exported.
+// It is used internally by types reading
+// memory-mapped files.
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Sequence
+{
+    namespace internal
+    {
+        class read_only_mapping
+        /// The contents of a file, mapped read-only into memory.
+        /// An empty file cannot be mapped, in which case data
+        /// is nullptr and size is zero.
+        {
+          private:
+            void* base;
+
+          public:
+            const char* data;
+            std::size_t size;
+
+            explicit read_only_mapping(const std::string& filename)
+                : base(nullptr), data(nullptr), size(0)
+            {
+                int fd = open(filename.c_str(), O_RDONLY);
+                if (fd == -1)
+                    {
+                        throw std::runtime_error("could not open "
+                                                 + filename);
+                    }
+                struct stat sb;
+                if (fstat(fd, &sb) == -1)
+                    {
+                        close(fd);
+                        throw std::runtime_error("could not stat " + filename);
+                    }
+                size = static_cast<std::size_t>(sb.st_size);
+                if (size > 0)
+                    {
+                        base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd,
+                                    0);
+                    }
+                close(fd);
+                if (base == MAP_FAILED)
+                    {
+                        throw std::runtime_error("could not map " + filename);
+                    }
+                data = static_cast<const char*>(base);
+            }
+
+            ~read_only_mapping()
+            {
+                if (base != nullptr)
+                    {
+                        munmap(base, size);
+                    }
+            }
+
+            read_only_mapping(const read_only_mapping&) = delete;
+            read_only_mapping& operator=(const read_only_mapping&) = delete;
+        };
+    } // namespace internal
+} // namespace Sequence
+
+#endif
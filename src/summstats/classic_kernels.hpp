@@ -0,0 +1,137 @@
+#ifndef SEQUENCE_SUMMSTATS_CLASSIC_KERNELS_HPP
+#define SEQUENCE_SUMMSTATS_CLASSIC_KERNELS_HPP
+
+// These functions are not exported.
+// They are used internally.
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <Sequence/summstats/auxillary.hpp>
+
+namespace Sequence
+{
+    namespace detail
+    {
+        // Tables of summstats_aux::a_sub_n and summstats_aux::b_sub_n,
+        // indexed by sample size, containing at least nsam + 2 elements.
+        // The values are summed in the same order as those functions,
+        // and so are identical to their return values.  The tables are
+        // kept for the lifetime of each thread, and only grow.
+        inline const std::vector<double>&
+        a_sub_n_table(const std::size_t nsam)
+        {
+            static thread_local std::vector<double> table(2, 0.0);
+            while (table.size() < nsam + 2)
+                {
+                    table.push_back(
+                        table.back()
+                        + 1.0 / static_cast<double>(table.size() - 1));
+                }
+            return table;
+        }
+
+        inline const std::vector<double>&
+        b_sub_n_table(const std::size_t nsam)
+        {
+            static thread_local std::vector<double> table(2, 0.0);
+            while (table.size() < nsam + 2)
+                {
+                    table.push_back(
+                        table.back()
+                        + 1.0
+                              / std::pow(static_cast<double>(table.size() - 1),
+                                         2.0));
+                }
+            return table;
+        }
+
+        // Tajima's D from pi, the number of segregating sites,
+        // and the largest sample size at any site.  a1 and a2
+        // are a_sub_n and b_sub_n for max_nsam.
+        inline double
+        tajd_from_sums(const double pi, const int S,
+                       const std::int32_t max_nsam, const double a1,
+                       const double a2)
+        {
+            if (!S)
+                {
+                    return std::numeric_limits<double>::quiet_NaN();
+                }
+            double w = static_cast<double>(S) / a1;
+            auto dn = static_cast<double>(max_nsam);
+            double b1 = (dn + 1.0) / (3.0 * (dn - 1.0));
+            double b2 = (2.0 * (std::pow(dn, 2.0) + dn + 3.0))
+                        / (9.0 * dn * (dn - 1.0));
+            double c1 = b1 - 1.0 / a1;
+            double c2 = b2 - (dn + 2.0) / (a1 * dn) + a2 / std::pow(a1, 2.0);
+            double e1 = c1 / a1;
+            double e2 = c2 / (std::pow(a1, 2.0) + a2);
+            double denominator
+                = std::pow((e1 * S + e2 * S * (S - 1.0)), 0.5);
+            return (pi - w) / denominator;
+        }
+
+        inline double
+        tajd_from_sums(const double pi, const int S, const std::int32_t max_nsam)
+        {
+            if (!S)
+                {
+                    return std::numeric_limits<double>::quiet_NaN();
+                }
+            return tajd_from_sums(
+                pi, S, max_nsam,
+                summstats_aux::a_sub_n(static_cast<std::uint32_t>(max_nsam)),
+                summstats_aux::b_sub_n(static_cast<std::uint32_t>(max_nsam)));
+        }
+
+        // H' from the sample size, the number of segregating
+        // sites, theta_pi, and theta_L.  a, b, and b1 are
+        // a_sub_n, b_sub_n, and b_sub_n_plus1 for nsam.
+        inline double
+        hprime_from_sums(const std::uint32_t nsam, const unsigned S,
+                         const double tp, const double tl, const double a,
+                         const double b, const double b1)
+        {
+            if (tp == 0.0)
+                {
+                    return std::numeric_limits<double>::quiet_NaN();
+                }
+            double tw = static_cast<double>(S)
+                        / a; //TODO: replace with call to thetaw
+            double tsq = S * (S - 1) / (a * a + b);
+            double n = static_cast<double>(nsam);
+
+            double vThetal = (n * tw) / (2.0 * (n - 1.0))
+                             + (2.0 * std::pow(n / (n - 1.0), 2.0) * (b1 - 1.0)
+                                - 1.0)
+                                   * tsq;
+            double vPi
+                = (3.0 * n * (n + 1.0) * tw + 2.0 * (n * n + n + 3.0) * tsq)
+                  / (9 * n * (n - 1.0));
+            double cov = ((n + 1.0) / (3.0 * (n - 1.0))) * tw
+                         + ((7.0 * n * n + 3.0 * n - 2.0
+                             - 4.0 * n * (n + 1.0) * b1)
+                            / (2.0 * std::pow((n - 1.0), 2.0)))
+                               * tsq;
+            return (tp - tl) / std::pow(vThetal + vPi - 2.0 * cov, 0.5);
+        }
+
+        inline double
+        hprime_from_sums(const std::uint32_t nsam, const unsigned S,
+                         const double tp, const double tl)
+        {
+            if (tp == 0.0)
+                {
+                    return std::numeric_limits<double>::quiet_NaN();
+                }
+            return hprime_from_sums(nsam, S, tp, tl,
+                                    summstats_aux::a_sub_n(nsam),
+                                    summstats_aux::b_sub_n(nsam),
+                                    summstats_aux::b_sub_n_plus1(nsam));
+        }
+    } // namespace detail
+} // namespace Sequence
+
+#endif
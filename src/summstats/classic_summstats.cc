@@ -0,0 +1,118 @@
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <Sequence/summstats/classics.hpp>
+#include "classic_kernels.hpp"
+
+namespace Sequence
+{
+    ClassicSummaryStatistics
+    classic_summstats(const AlleleCountMatrix& ac, const std::int8_t refstate)
+    {
+        ClassicSummaryStatistics rv;
+        rv.thetapi = rv.thetaw = rv.thetah = rv.thetal = 0.0;
+        rv.nvariable_sites = rv.nbiallelic_sites
+            = rv.total_number_of_mutations = 0;
+        rv.hprime = rv.faywuh = rv.tajd
+            = std::numeric_limits<double>::quiet_NaN();
+        if (ac.counts.empty())
+            {
+                return rv;
+            }
+        auto refindex = static_cast<std::size_t>(refstate);
+        if (refindex >= ac.ncol)
+            {
+                throw std::invalid_argument(
+                    "reference state greater than max allelic state");
+            }
+        const auto& a_sub_n = detail::a_sub_n_table(ac.nsam);
+        const auto& b_sub_n = detail::b_sub_n_table(ac.nsam);
+
+        // Running sums for tajd, hprime, and faywuh.
+        // The latter two use ac.nsam rather than the
+        // sample size at each site.
+        double tajd_pi = 0.0, ref_pi = 0.0, theta_h = 0.0, theta_l = 0.0;
+        int tajd_S = 0;
+        unsigned S = 0;
+        std::int32_t max_nsam = 0;
+        const double nnm1 = static_cast<double>(ac.nsam * (ac.nsam - 1));
+        const double hdenom = 2. / static_cast<double>(ac.nsam * (ac.nsam - 1));
+        const double ldenom = 1. / static_cast<double>(ac.nsam - 1);
+
+        for (std::size_t i = 0; i < ac.counts.size(); i += ac.ncol)
+            {
+                std::int32_t nsam = 0, nstates = 0, nnonref = 0;
+                double homozygosity = 0.0, h = 0.0, l = 0.0;
+                bool refseen = false;
+                for (std::size_t j = i; j < i + ac.ncol; ++j)
+                    {
+                        auto ci = ac.counts[j];
+                        if (ci > 0)
+                            {
+                                ++nstates;
+                                nsam += ci;
+                                homozygosity
+                                    += static_cast<double>(ci * (ci - 1));
+                                if (j - i != refindex)
+                                    {
+                                        ++nnonref;
+                                        h += std::pow(ci, 2.0);
+                                        l += static_cast<double>(ci);
+                                    }
+                                else
+                                    {
+                                        refseen = true;
+                                    }
+                            }
+                    }
+                if (nnonref > 1)
+                    {
+                        throw std::runtime_error(
+                            "site has more than one derived state");
+                    }
+                double pi = 1.0
+                            - homozygosity
+                                  / static_cast<double>(nsam * (nsam - 1));
+                rv.thetapi += pi;
+                if (nstates)
+                    {
+                        max_nsam = std::max(max_nsam, nsam);
+                        tajd_S += nstates - 1;
+                        tajd_pi += pi;
+                    }
+                if (nstates > 1)
+                    {
+                        ++S;
+                        ++rv.nvariable_sites;
+                        rv.total_number_of_mutations
+                            += static_cast<std::uint32_t>(nstates) - 1;
+                        rv.thetaw += static_cast<double>(nstates - 1)
+                                     / a_sub_n[static_cast<std::size_t>(nsam)];
+                    }
+                if (nstates == 2)
+                    {
+                        ++rv.nbiallelic_sites;
+                    }
+                if (refseen)
+                    {
+                        ref_pi += 1.0 - homozygosity / nnm1;
+                        theta_h += h * hdenom;
+                        theta_l += l * ldenom;
+                        rv.thetah
+                            += h * (2.0 / static_cast<double>(nsam * (nsam - 1)));
+                        rv.thetal += l * (1. / static_cast<double>(nsam - 1));
+                    }
+            }
+        auto un = static_cast<std::size_t>(max_nsam);
+        rv.tajd = detail::tajd_from_sums(tajd_pi, tajd_S, max_nsam,
+                                         a_sub_n[un], b_sub_n[un]);
+        if (S)
+            {
+                rv.faywuh = ref_pi - theta_h;
+            }
+        rv.hprime = detail::hprime_from_sums(
+            static_cast<std::uint32_t>(ac.nsam), S, ref_pi, theta_l,
+            a_sub_n[ac.nsam], b_sub_n[ac.nsam], b_sub_n[ac.nsam + 1]);
+        return rv;
+    }
+} // namespace Sequence
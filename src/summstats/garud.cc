@@ -2,11 +2,173 @@
 #include <limits>
 #include <vector>
 #include <algorithm>
+#include <functional>
 #include <unordered_map>
+#include <stdexcept>
+#include <utility>
 #include <Sequence/summstats/garud.hpp>
 #include <Sequence/summstats/generic.hpp>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/summstats/classics.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+
+namespace
+{
+    Sequence::GarudStats
+    garud_from_counts(std::vector<std::int32_t>& counts,
+                      const std::size_t nsam_nonmissing)
+    // counts contains the number of copies of
+    // each distinct haplotype, and is sorted
+    // in descending order on return.
+    {
+        Sequence::GarudStats rv;
+        if (counts.size() < 2)
+            {
+                return rv;
+            }
+        double hom = 0.0;
+        for (auto c : counts)
+            {
+                hom += static_cast<double>(c * (c - 1));
+            }
+        hom /= static_cast<double>(nsam_nonmissing * (nsam_nonmissing - 1));
+        rv.H1 = 1.0 - (1.0 - hom);
+        std::sort(counts.begin(), counts.end(), std::greater<std::int32_t>());
+        double nsam = static_cast<double>(nsam_nonmissing);
+        rv.H12 = rv.H1
+                 + 2. * static_cast<double>(counts[0])
+                       * static_cast<double>(counts[1])
+                       / (nsam * (nsam - 1.0));
+        rv.H2H1 = (rv.H1
+                   - static_cast<double>(counts[0] * (counts[0] - 1))
+                         / (nsam * (nsam - 1)))
+                  / rv.H1;
+        return rv;
+    }
+
+    inline std::uint64_t
+    site_key(const std::size_t site, const std::int8_t state,
+             const std::uint64_t seed)
+    // splitmix64 of the site and allelic state
+    {
+        std::uint64_t z = seed
+                          + (static_cast<std::uint64_t>(site) << 8
+                             | static_cast<std::uint8_t>(state))
+                                * 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    class rolling_haplotype_hashes
+    // A 128-bit hash of each haplotype in a window.  A haplotype's
+    // hash is the sum of keys for the non-reference states that it
+    // carries, so sites are added and removed in O(nsam) time.
+    {
+      private:
+        using hash_type = std::pair<std::uint64_t, std::uint64_t>;
+        std::vector<hash_type> hashes, sorted;
+        std::size_t nmissing;
+
+        void
+        update(const Sequence::VariantMatrix& m, const std::size_t site,
+               const bool add)
+        {
+            auto r = Sequence::get_ConstRowView(m, site);
+            for (std::size_t i = 0; i < r.size(); ++i)
+                {
+                    if (r[i] == 0)
+                        {
+                            continue;
+                        }
+                    if (r[i] < 0)
+                        {
+                            if (add)
+                                {
+                                    ++nmissing;
+                                }
+                            else
+                                {
+                                    --nmissing;
+                                }
+                        }
+                    auto k1 = site_key(site, r[i], 0x243f6a8885a308d3ULL);
+                    auto k2 = site_key(site, r[i], 0x13198a2e03707344ULL);
+                    if (add)
+                        {
+                            hashes[i].first += k1;
+                            hashes[i].second += k2;
+                        }
+                    else
+                        {
+                            hashes[i].first -= k1;
+                            hashes[i].second -= k2;
+                        }
+                }
+        }
+
+      public:
+        explicit rolling_haplotype_hashes(const std::size_t nsam)
+            : hashes(nsam, hash_type(0, 0)), sorted{}, nmissing(0)
+        {
+        }
+
+        void
+        add(const Sequence::VariantMatrix& m, const std::size_t site)
+        {
+            update(m, site, true);
+        }
+
+        void
+        remove(const Sequence::VariantMatrix& m, const std::size_t site)
+        {
+            update(m, site, false);
+        }
+
+        bool
+        has_missing() const
+        {
+            return nmissing > 0;
+        }
+
+        void
+        haplotype_counts(std::vector<std::int32_t>& counts)
+        {
+            counts.clear();
+            sorted.assign(hashes.begin(), hashes.end());
+            std::sort(sorted.begin(), sorted.end());
+            for (std::size_t i = 0; i < sorted.size();)
+                {
+                    std::size_t j = i + 1;
+                    while (j < sorted.size() && sorted[j] == sorted[i])
+                        {
+                            ++j;
+                        }
+                    counts.push_back(static_cast<std::int32_t>(j - i));
+                    i = j;
+                }
+        }
+    };
+
+    Sequence::VariantMatrix
+    copy_sites(const Sequence::VariantMatrix& m, const std::size_t first,
+               const std::size_t last)
+    {
+        std::vector<std::int8_t> data;
+        data.reserve((last - first) * m.nsam());
+        std::vector<double> pos;
+        for (std::size_t s = first; s < last; ++s)
+            {
+                auto r = Sequence::get_ConstRowView(m, s);
+                data.insert(data.end(), r.cbegin(), r.cend());
+                pos.push_back(m.position(s));
+            }
+        // Keep the maximum allelic state of m, which cannot be
+        // found from a window in which all genotypes are missing.
+        return Sequence::VariantMatrix(std::move(data), std::move(pos),
+                                       m.max_allele());
+    }
+} // namespace
 
 namespace Sequence
 {
@@ -30,8 +192,6 @@ namespace Sequence
             {
                 return rv;
             }
-        // Although one of the stats is haplotype diversity,
-        // w
         auto labels = label_haplotypes(m);
         std::unordered_map<std::int32_t, std::int32_t> counts;
         std::size_t nmissing = 0;
@@ -46,29 +206,68 @@ namespace Sequence
                         counts[l]++;
                     }
             }
-        if (counts.size() < 2)
+        std::vector<std::int32_t> vcounts;
+        vcounts.reserve(counts.size());
+        for (auto&& c : counts)
+            {
+                vcounts.push_back(c.second);
+            }
+        return garud_from_counts(vcounts, m.nsam() - nmissing);
+    }
+
+    std::vector<GarudStats>
+    garud_statistics_scan(const VariantMatrix& m, const std::size_t window_size,
+                          const std::size_t step_size)
+    {
+        if (!window_size || !step_size)
+            {
+                throw std::invalid_argument(
+                    "window and step sizes must be positive");
+            }
+        std::vector<GarudStats> rv;
+        const auto nsites = m.nsites();
+        if (nsites < window_size)
             {
                 return rv;
             }
-        rv.H1 = 1.0 - diversity_from_counts(counts, m.nsam() - nmissing);
-        std::vector<std::pair<std::int32_t, std::int32_t>> vcounts(
-            counts.begin(), counts.end());
-        std::sort(vcounts.begin(), vcounts.end(),
-                  [](const std::pair<std::int32_t, std::int32_t>& a,
-                     const std::pair<std::int32_t, std::int32_t>& b) {
-                      return a.second > b.second;
-                  });
-        double nsam
-            = static_cast<double>(m.nsam()) - static_cast<double>(nmissing);
-        rv.H12 = rv.H1
-                 + 2. * static_cast<double>(vcounts[0].second)
-                       * static_cast<double>(vcounts[1].second)
-                       / (nsam * (nsam - 1.0));
-        rv.H2H1 = (rv.H1
-                   - static_cast<double>(vcounts[0].second
-                                         * (vcounts[0].second - 1))
-                         / (nsam * (nsam - 1)))
-                  / rv.H1;
+        const auto nwindows = (nsites - window_size) / step_size + 1;
+        if (!m.nsam())
+            {
+                rv.resize(nwindows);
+                return rv;
+            }
+        rv.reserve(nwindows);
+        rolling_haplotype_hashes hashes(m.nsam());
+        std::vector<std::int32_t> counts;
+        // Sites [first, last) are in the hashes
+        std::size_t first = 0, last = 0;
+        for (std::size_t start = 0; start + window_size <= nsites;
+             start += step_size)
+            {
+                const auto stop = start + window_size;
+                if (start >= last)
+                    {
+                        // No overlap with the previous window
+                        hashes = rolling_haplotype_hashes(m.nsam());
+                        first = last = start;
+                    }
+                for (; first < start; ++first)
+                    {
+                        hashes.remove(m, first);
+                    }
+                for (; last < stop; ++last)
+                    {
+                        hashes.add(m, last);
+                    }
+                if (hashes.has_missing())
+                    {
+                        rv.push_back(
+                            garud_statistics(copy_sites(m, start, stop)));
+                        continue;
+                    }
+                hashes.haplotype_counts(counts);
+                rv.push_back(garud_from_counts(counts, m.nsam()));
+            }
         return rv;
     }
 } // namespace Sequence
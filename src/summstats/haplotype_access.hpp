@@ -0,0 +1,49 @@
+#ifndef SEQUENCE_SUMMSTATS_HAPLOTYPE_ACCESS_HPP
+#define SEQUENCE_SUMMSTATS_HAPLOTYPE_ACCESS_HPP
+
+// These types are not exported.
+// They are used internally.
+
+#include <cstddef>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+
+namespace Sequence
+{
+    namespace summstats_details
+    {
+        // Functions that loop over haplotypes are written
+        // in terms of one of these two types.  The first
+        // returns strided views of the VariantMatrix columns.
+        // The second returns contiguous views of the haplotype-major
+        // copy, when VariantMatrix::haplotype_cache_enabled is true.
+        struct column_haplotypes
+        {
+            using view_type = ConstColView;
+            const VariantMatrix& m;
+            explicit column_haplotypes(const VariantMatrix& m_) : m(m_) {}
+            inline view_type
+            operator()(const std::size_t i) const
+            {
+                return get_ConstColView(m, i);
+            }
+        };
+
+        struct cached_haplotypes
+        {
+            using view_type = ConstRowView;
+            HaplotypeMajorView v;
+            explicit cached_haplotypes(const VariantMatrix& m)
+                : v(get_HaplotypeMajorView(m))
+            {
+            }
+            inline view_type
+            operator()(const std::size_t i) const
+            {
+                return v.haplotype(i);
+            }
+        };
+    } // namespace summstats_details
+} // namespace Sequence
+
+#endif
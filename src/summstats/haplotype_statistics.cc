@@ -2,93 +2,231 @@
 #include <numeric>
 #include <vector>
 #include <cstdint>
+#include <limits>
 #include <unordered_map>
 #include <Sequence/summstats/util.hpp>
 #include <Sequence/summstats/generic.hpp>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
-#include "algorithm.hpp"
+#include "packed_haplotypes.hpp"
+#include "popcount_dispatch.hpp"
 
-namespace Sequence
+namespace
 {
-    //TODO: modify to ignore sequences
-    //with missing data above a certain threshold?
-    std::vector<std::int32_t>
-    difference_matrix(const VariantMatrix& m)
+
+    using Sequence::summstats_details::packed_haplotypes;
+
+    template <bool missing>
+    SEQUENCE_ALWAYS_INLINE std::int32_t
+    ndiff_packed(const std::uint64_t* a, const std::uint64_t* b,
+                 const std::size_t nwords, const std::size_t nplanes,
+                 const std::size_t stride)
+    // Sites where both haplotypes have data and
+    // any bit plane differs.
     {
-        std::vector<std::int32_t> rv;
-        rv.reserve(m.nsam());
-        for (std::size_t i = 0; i < m.nsam() - 1; ++i)
+        std::int32_t ndiffs = 0;
+        for (std::size_t w = 0; w < nwords; ++w, a += stride, b += stride)
             {
-                auto ci = get_ConstColView(m, i);
-                for (std::size_t j = i + 1; j < m.nsam(); ++j)
+                std::uint64_t x = a[0] ^ b[0];
+                for (std::size_t p = 1; p < nplanes; ++p)
+                    {
+                        x |= a[p] ^ b[p];
+                    }
+                if (missing)
                     {
-                        auto cj = get_ConstColView(m, j);
-                        std::int32_t ndiffs
-                            = summstats_algo::ndiff_skip_missing(
-                                ci.begin(), ci.end(), cj.begin());
-                        rv.push_back(ndiffs);
+                        x &= ~(a[nplanes] | b[nplanes]);
                     }
+                ndiffs += __builtin_popcountll(x);
+            }
+        return ndiffs;
+    }
+
+    // Haplotypes are compared in blocks of this many,
+    // so that the words of a block stay in cache while
+    // it is compared to all later haplotypes.
+    constexpr std::size_t haplotype_block_size = 16;
+
+    template <bool missing>
+    SEQUENCE_ALWAYS_INLINE void
+    all_pairs_details(const packed_haplotypes& p, std::int32_t* rv)
+    // rv is indexed as the upper triangle of an
+    // nsam*nsam matrix, excluding the diagonal.
+    {
+        const std::size_t n = p.nsam(), C = n * (n - 1) / 2;
+        const auto nwords = p.words_per_haplotype();
+        const auto nplanes = p.planes();
+        const auto stride = p.words_per_block();
+        for (std::size_t b = 0; b < n; b += haplotype_block_size)
+            {
+                const auto bend = std::min(n, b + haplotype_block_size);
+                for (std::size_t j = b + 1; j < n; ++j)
+                    {
+                        const auto wj = p.words(j);
+                        for (std::size_t i = b; i < bend && i < j; ++i)
+                            {
+                                rv[C - (n - i) * (n - i - 1) / 2 + j - i - 1]
+                                    = ndiff_packed<missing>(p.words(i), wj,
+                                                            nwords, nplanes,
+                                                            stride);
+                            }
+                    }
+            }
+    }
+
+    void
+    all_pairs_generic(const packed_haplotypes& p, std::int32_t* rv)
+    {
+        if (p.has_missing())
+            {
+                all_pairs_details<true>(p, rv);
+            }
+        else
+            {
+                all_pairs_details<false>(p, rv);
+            }
+    }
+
+    SEQUENCE_TARGET_POPCNT void
+    all_pairs_popcnt(const packed_haplotypes& p, std::int32_t* rv)
+    {
+        if (p.has_missing())
+            {
+                all_pairs_details<true>(p, rv);
+            }
+        else
+            {
+                all_pairs_details<false>(p, rv);
             }
-        return rv;
     }
 
     std::vector<std::int32_t>
-    is_different_matrix(const VariantMatrix& m)
+    all_pairs_differences(const packed_haplotypes& p)
+    // Number of differences between all pairs of haplotypes.
+    // The popcnt instruction is used if the CPU has it.
+    {
+        const std::size_t n = p.nsam();
+        if (n < 2)
+            {
+                return std::vector<std::int32_t>();
+            }
+        std::vector<std::int32_t> rv(n * (n - 1) / 2);
+        if (Sequence::summstats_details::cpu_has_popcnt())
+            {
+                all_pairs_popcnt(p, rv.data());
+                return rv;
+            }
+        all_pairs_generic(p, rv.data());
+        return rv;
+    }
+
+    packed_haplotypes
+    pack_haplotypes(const Sequence::VariantMatrix& m)
+    {
+        if (m.haplotype_cache_enabled())
+            {
+                return packed_haplotypes(Sequence::get_HaplotypeMajorView(m));
+            }
+        return packed_haplotypes(m);
+    }
+
+    inline bool
+    differ_packed(const std::uint64_t* a, const std::uint64_t* b,
+                  const std::size_t nwords, const std::size_t nplanes,
+                  const std::size_t stride, const bool missing)
+    // True if the haplotypes differ at a
+    // site where both have data.
     {
-        std::vector<std::int32_t> rv;
-        rv.reserve(m.nsam());
-        std::vector<ConstColView> alleles;
-        alleles.reserve(m.nsam());
-        for (std::size_t i = 0; i < m.nsam(); ++i)
+        for (std::size_t w = 0; w < nwords; ++w, a += stride, b += stride)
             {
-                alleles.push_back(get_ConstColView(m, i));
+                std::uint64_t x = a[0] ^ b[0];
+                for (std::size_t p = 1; p < nplanes; ++p)
+                    {
+                        x |= a[p] ^ b[p];
+                    }
+                if (missing)
+                    {
+                        x &= ~(a[nplanes] | b[nplanes]);
+                    }
+                if (x)
+                    {
+                        return true;
+                    }
             }
-        for (std::size_t i = 0; i < m.nsam() - 1; ++i)
+        return false;
+    }
+
+    std::vector<std::int32_t>
+    label_by_hash(const packed_haplotypes& p)
+    // Without missing data, haplotypes are identical
+    // if and only if their packed words are, so
+    // each haplotype is hashed once.
+    {
+        const auto n = p.words_per_haplotype() * p.words_per_block();
+        std::vector<std::int32_t> rv(p.nsam());
+        // Map hash values to the first haplotype
+        // having each distinct sequence.
+        std::unordered_multimap<std::uint64_t, std::int32_t> first;
+        first.reserve(p.nsam());
+        for (std::size_t i = 0; i < p.nsam(); ++i)
             {
-                for (std::size_t j = i + 1; j < m.nsam(); ++j)
+                auto w = p.words(i);
+                std::uint64_t h = 0;
+                for (std::size_t k = 0; k < n; ++k)
+                    {
+                        h ^= w[k] + 0x9e3779b97f4a7c15ULL + (h << 6)
+                             + (h >> 2);
+                    }
+                auto range = first.equal_range(h);
+                rv[i] = static_cast<std::int32_t>(i);
+                for (auto j = range.first; j != range.second; ++j)
+                    {
+                        if (std::equal(w, w + n, p.words(
+                                           static_cast<std::size_t>(j->second))))
+                            {
+                                rv[i] = j->second;
+                                break;
+                            }
+                    }
+                if (rv[i] == static_cast<std::int32_t>(i))
                     {
-                        auto m = summstats_algo::mismatch_skip_missing(
-                            alleles[i].begin(), alleles[i].end(),
-                            alleles[j].begin());
-                        rv.push_back(m.first != alleles[i].end());
+                        first.emplace(h, rv[i]);
                     }
             }
         return rv;
     }
 
     std::vector<std::int32_t>
-    label_haplotypes(const VariantMatrix& m)
+    label_compatible(const packed_haplotypes& p)
+    // With missing data, a haplotype takes the label of
+    // each earlier unlabelled haplotype that it does not
+    // differ from at any site where both have data.
     {
-        std::vector<std::int32_t> rv(m.nsam(), 0);
-        std::vector<std::int32_t> processed(m.nsam(), 0);
+        const std::size_t nsam = p.nsam();
+        const auto nwords = p.words_per_haplotype();
+        const auto nplanes = p.planes();
+        const auto stride = p.words_per_block();
+        std::vector<std::int32_t> rv(nsam, 0);
+        std::vector<std::int32_t> processed(nsam, 0);
+        std::vector<std::int32_t> missing(nsam, 0);
         std::iota(begin(rv), end(rv), 0);
-        if (rv.empty())
+        for (std::size_t i = 0; i < nsam; ++i)
             {
-                return rv;
+                missing[i] = p.all_missing(i);
             }
-        const auto dm = is_different_matrix(m);
-        const std::size_t n = m.nsam();
-        const std::size_t C = n * (n - 1) / 2;
-
-        // k refers to an element in the upper triangle 
-        // of an nsam*nsam matrix, excluding the diagonal.
-        std::size_t k = std::numeric_limits<std::size_t>::max();
-        for (std::size_t i = 0; i < m.nsam(); ++i)
+        for (std::size_t i = 0; i < nsam; ++i)
             {
                 if (!processed[i])
                     {
-                        if (!all_missing(get_ConstColView(m, i)))
+                        if (!missing[i])
                             {
-                                for (std::size_t j = i + 1; j < m.nsam(); ++j)
+                                for (std::size_t j = i + 1; j < nsam; ++j)
                                     {
-                                        if (!all_missing(
-                                                get_ConstColView(m, j)))
+                                        if (!missing[j])
                                             {
-                                                k = C
-                                                    - (n - i) * (n - i - 1) / 2
-                                                    + j - i - 1;
-                                                if (!dm[k])
+                                                if (!differ_packed(
+                                                        p.words(i), p.words(j),
+                                                        nwords, nplanes,
+                                                        stride, true))
                                                     {
                                                         rv[j] = rv[i];
                                                         processed[j] = 1;
@@ -109,6 +247,48 @@ namespace Sequence
             }
         return rv;
     }
+} // namespace
+
+namespace Sequence
+{
+    //TODO: modify to ignore sequences
+    //with missing data above a certain threshold?
+    std::vector<std::int32_t>
+    difference_matrix(const VariantMatrix& m)
+    {
+        return all_pairs_differences(pack_haplotypes(m));
+    }
+
+    std::vector<std::int32_t>
+    is_different_matrix(const VariantMatrix& m)
+    {
+        auto rv = all_pairs_differences(pack_haplotypes(m));
+        for (auto& x : rv)
+            {
+                x = (x > 0);
+            }
+        return rv;
+    }
+
+    std::vector<std::int32_t>
+    label_haplotypes(const VariantMatrix& m)
+    {
+        if (!m.nsam())
+            {
+                return std::vector<std::int32_t>();
+            }
+        if (!m.nsites())
+            {
+                // All haplotypes are entirely missing data
+                return std::vector<std::int32_t>(m.nsam(), -1);
+            }
+        const auto p = pack_haplotypes(m);
+        if (!p.has_missing())
+            {
+                return label_by_hash(p);
+            }
+        return label_compatible(p);
+    }
 
     std::int32_t
     number_of_haplotypes(const VariantMatrix& m)
@@ -1,9 +1,228 @@
+#include <cmath>
 #include <cstdint>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
 #include <Sequence/summstats/ld.hpp>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
+#include "packed_sites.hpp"
+#include "popcount_dispatch.hpp"
+
+namespace
+{
+    using Sequence::summstats_details::packed_sites;
+
+    SEQUENCE_ALWAYS_INLINE Sequence::PairwiseLD
+    ld_from_counts(const std::size_t i, const std::size_t j,
+                   const std::int32_t n, const std::int32_t ni,
+                   const std::int32_t nj, const std::int32_t nij)
+    {
+        Sequence::PairwiseLD rv;
+        rv.i = i;
+        rv.j = j;
+        const double dn = static_cast<double>(n);
+        const double p1 = static_cast<double>(ni) / dn,
+                     q1 = static_cast<double>(nj) / dn, p0 = 1.0 - p1,
+                     q0 = 1.0 - q1;
+        rv.D = static_cast<double>(nij) / dn - p1 * q1;
+        rv.rsq = (rv.D * rv.D) / (p0 * p1 * q0 * q1);
+        if (rv.D < 0.0)
+            {
+                rv.Dprime = rv.D / std::min(p0 * q0, p1 * q1);
+            }
+        else
+            {
+                rv.Dprime = rv.D / std::min(p1 * q0, p0 * q1);
+            }
+        return rv;
+    }
+
+    struct pair_cursor
+    // Pairs of sites are visited in the order of a and then b,
+    // where b runs from a + 1 to stop[a], one past the last site
+    // within the maximum distance of site a.
+    {
+        std::size_t a, b;
+    };
+
+    struct buffer_sink
+    {
+        Sequence::PairwiseLD* out;
+        SEQUENCE_ALWAYS_INLINE void
+        operator()(const Sequence::PairwiseLD& ld)
+        {
+            *out++ = ld;
+        }
+    };
+
+    struct callback_sink
+    {
+        const std::function<void(const Sequence::PairwiseLD&)>* f;
+        SEQUENCE_ALWAYS_INLINE void
+        operator()(const Sequence::PairwiseLD& ld)
+        {
+            (*f)(ld);
+        }
+    };
+
+    template <bool missing, typename Sink>
+    SEQUENCE_ALWAYS_INLINE void
+    ld_pairs_details(const packed_sites& p, const std::size_t* stop,
+                     pair_cursor c, std::size_t npairs, Sink sink)
+    // LD for the next npairs pairs from c, or for
+    // all remaining pairs if there are fewer.
+    {
+        const auto nwords = p.nwords;
+        const auto n = static_cast<std::int32_t>(p.nsam);
+        const auto nsites = p.sites.size();
+        while (npairs && c.a < nsites)
+            {
+                if (c.b >= stop[c.a])
+                    {
+                        ++c.a;
+                        c.b = c.a + 1;
+                        continue;
+                    }
+                const auto a = c.a;
+                const auto bi = p.site_bits(a);
+                const auto last = c.b + std::min(stop[a] - c.b, npairs);
+                npairs -= last - c.b;
+                for (auto b = c.b; b < last; ++b)
+                    {
+                        const auto bj = p.site_bits(b);
+                        std::int32_t nij = 0;
+                        if (!missing)
+                            {
+                                for (std::size_t w = 0; w < nwords; ++w)
+                                    {
+                                        nij += __builtin_popcountll(bi[w]
+                                                                    & bj[w]);
+                                    }
+                                sink(ld_from_counts(p.sites[a], p.sites[b], n,
+                                                    p.count(a), p.count(b),
+                                                    nij));
+                                continue;
+                            }
+                        const auto vi = p.site_valid(a);
+                        const auto vj = p.site_valid(b);
+                        std::int32_t nvalid = 0, ni = 0, nj = 0;
+                        for (std::size_t w = 0; w < nwords; ++w)
+                            {
+                                nvalid += __builtin_popcountll(vi[w] & vj[w]);
+                                ni += __builtin_popcountll(bi[w] & vj[w]);
+                                nj += __builtin_popcountll(bj[w] & vi[w]);
+                                nij += __builtin_popcountll(bi[w] & bj[w]);
+                            }
+                        sink(ld_from_counts(p.sites[a], p.sites[b], nvalid,
+                                            ni, nj, nij));
+                    }
+                c.b = last;
+            }
+    }
+
+    template <typename Sink>
+    SEQUENCE_ALWAYS_INLINE void
+    ld_pairs(const packed_sites& p, const std::size_t* stop,
+             const pair_cursor c, const std::size_t npairs, Sink sink)
+    {
+        if (p.has_missing())
+            {
+                ld_pairs_details<true>(p, stop, c, npairs, sink);
+            }
+        else
+            {
+                ld_pairs_details<false>(p, stop, c, npairs, sink);
+            }
+    }
+
+    // Calculate npairs pairs from c into a buffer
+
+    void
+    ld_buffer_generic(const packed_sites& p, const std::size_t* stop,
+                      const pair_cursor c, const std::size_t npairs,
+                      Sequence::PairwiseLD* out)
+    {
+        ld_pairs(p, stop, c, npairs, buffer_sink{ out });
+    }
+
+    SEQUENCE_TARGET_POPCNT void
+    ld_buffer_popcnt(const packed_sites& p, const std::size_t* stop,
+                     const pair_cursor c, const std::size_t npairs,
+                     Sequence::PairwiseLD* out)
+    {
+        ld_pairs(p, stop, c, npairs, buffer_sink{ out });
+    }
+
+    // Pass all pairs to a callback
+
+    void
+    ld_stream_generic(
+        const packed_sites& p, const std::size_t* stop,
+        const std::function<void(const Sequence::PairwiseLD&)>& f)
+    {
+        ld_pairs(p, stop, pair_cursor{ 0, 1 },
+                 std::numeric_limits<std::size_t>::max(), callback_sink{ &f });
+    }
+
+    SEQUENCE_TARGET_POPCNT void
+    ld_stream_popcnt(const packed_sites& p, const std::size_t* stop,
+                     const std::function<void(const Sequence::PairwiseLD&)>& f)
+    {
+        ld_pairs(p, stop, pair_cursor{ 0, 1 },
+                 std::numeric_limits<std::size_t>::max(), callback_sink{ &f });
+    }
+
+    std::vector<std::size_t>
+    pair_stops(const std::vector<double>& pos, const double max_distance)
+    // For each site, one past the last later site within
+    // max_distance.  Positions are sorted, so the stops are too.
+    {
+        std::vector<std::size_t> stop(pos.size());
+        std::size_t s = 0;
+        for (std::size_t a = 0; a < pos.size(); ++a)
+            {
+                s = std::max(s, a + 1);
+                while (s < pos.size() && pos[s] - pos[a] <= max_distance)
+                    {
+                        ++s;
+                    }
+                stop[a] = s;
+            }
+        return stop;
+    }
+
+    std::size_t
+    advance(pair_cursor& c, const std::vector<std::size_t>& stop,
+            std::size_t npairs)
+    // Move c forward by up to npairs pairs, returning
+    // the number of pairs passed.
+    {
+        const auto n = npairs;
+        while (npairs && c.a < stop.size())
+            {
+                if (c.b >= stop[c.a])
+                    {
+                        ++c.a;
+                        c.b = c.a + 1;
+                        continue;
+                    }
+                const auto k = std::min(stop[c.a] - c.b, npairs);
+                c.b += k;
+                npairs -= k;
+            }
+        return n - npairs;
+    }
+
+    // When running in parallel, each task calculates this many
+    // consecutive pairs, and this many tasks are run before their
+    // results are passed on, which bounds the number of results
+    // held in memory.
+    constexpr std::size_t pairs_per_task = 4096;
+    constexpr std::size_t tasks_per_batch = 64;
+} // namespace
 
 namespace Sequence
 {
@@ -41,4 +260,72 @@ namespace Sequence
             }
         return rv;
     }
+
+    void
+    for_each_pairwise_ld(const VariantMatrix& m, const double max_distance,
+                         const std::function<void(const PairwiseLD&)>& f,
+                         const Executor& executor)
+    {
+        if (std::isnan(max_distance) || max_distance < 0.0)
+            {
+                throw std::invalid_argument(
+                    "maximum distance must be non-negative");
+            }
+        const packed_sites p(m);
+        const auto stop = pair_stops(p.positions, max_distance);
+        const bool popcnt = summstats_details::cpu_has_popcnt();
+        if (!executor)
+            {
+                if (popcnt)
+                    {
+                        ld_stream_popcnt(p, stop.data(), f);
+                    }
+                else
+                    {
+                        ld_stream_generic(p, stop.data(), f);
+                    }
+                return;
+            }
+        const auto ld_buffer = popcnt ? ld_buffer_popcnt : ld_buffer_generic;
+        std::vector<std::vector<PairwiseLD>> results(tasks_per_batch);
+        pair_cursor c{ 0, 1 };
+        while (c.a < stop.size())
+            {
+                std::vector<std::function<void()>> tasks;
+                for (std::size_t t = 0; t < tasks_per_batch; ++t)
+                    {
+                        const auto first = c;
+                        const auto n = advance(c, stop, pairs_per_task);
+                        if (n == 0)
+                            {
+                                break;
+                            }
+                        auto& r = results[t];
+                        r.resize(n);
+                        tasks.emplace_back(
+                            [&p, &stop, &r, ld_buffer, first, n]() {
+                                ld_buffer(p, stop.data(), first, n, r.data());
+                            });
+                    }
+                run_tasks(executor, tasks);
+                for (std::size_t t = 0; t < tasks.size(); ++t)
+                    {
+                        for (auto& ld : results[t])
+                            {
+                                f(ld);
+                            }
+                    }
+            }
+    }
+
+    std::vector<PairwiseLD>
+    pairwise_ld(const VariantMatrix& m, const double max_distance,
+                const Executor& executor)
+    {
+        std::vector<PairwiseLD> rv;
+        for_each_pairwise_ld(
+            m, max_distance,
+            [&rv](const PairwiseLD& ld) { rv.push_back(ld); }, executor);
+        return rv;
+    }
 } // namespace Sequence
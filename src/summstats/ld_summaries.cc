@@ -0,0 +1,194 @@
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <Sequence/summstats/ld_summaries.hpp>
+
+namespace Sequence
+{
+    ZnSAccumulator::ZnSAccumulator() : sum(0.0), n(0) {}
+
+    void
+    ZnSAccumulator::operator()(const PairwiseLD& ld)
+    {
+        if (!std::isnan(ld.rsq))
+            {
+                sum += ld.rsq;
+                ++n;
+            }
+    }
+
+    std::size_t
+    ZnSAccumulator::npairs() const
+    {
+        return n;
+    }
+
+    double
+    ZnSAccumulator::value() const
+    {
+        if (!n)
+            {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+        return sum / static_cast<double>(n);
+    }
+
+    OmegaResult::OmegaResult()
+        : omega_max(std::numeric_limits<double>::quiet_NaN()), left_site(0)
+    {
+    }
+
+    OmegaAccumulator::OmegaAccumulator(const std::size_t nsites)
+        : colsum(nsites, 0.0), rowsum(nsites, 0.0), colcount(nsites, 0),
+          rowcount(nsites, 0)
+    {
+    }
+
+    void
+    OmegaAccumulator::operator()(const PairwiseLD& ld)
+    {
+        if (std::isnan(ld.rsq))
+            {
+                return;
+            }
+        if (ld.i >= ld.j || ld.j >= colsum.size())
+            {
+                throw std::invalid_argument("invalid pair of sites");
+            }
+        colsum[ld.j] += ld.rsq;
+        ++colcount[ld.j];
+        rowsum[ld.i] += ld.rsq;
+        ++rowcount[ld.i];
+    }
+
+    OmegaResult
+    OmegaAccumulator::value() const
+    {
+        OmegaResult rv;
+        const auto nsites = colsum.size();
+        if (nsites < 4)
+            {
+                return rv;
+            }
+        double total = 0.0;
+        std::size_t ntotal = 0;
+        // Sums over pairs with both sites
+        // to the right of each split
+        std::vector<double> right(nsites + 1, 0.0);
+        std::vector<std::size_t> nright(nsites + 1, 0);
+        for (std::size_t i = nsites; i > 0; --i)
+            {
+                right[i - 1] = right[i] + rowsum[i - 1];
+                nright[i - 1] = nright[i] + rowcount[i - 1];
+                total += colsum[i - 1];
+                ntotal += colcount[i - 1];
+            }
+        double left = 0.0;
+        std::size_t nleft = 0;
+        for (std::size_t l = 0; l + 1 < nsites; ++l)
+            {
+                // The left group is sites [0, l]
+                left += colsum[l];
+                nleft += colcount[l];
+                // There must be at least one pair
+                // within each group
+                if (!nleft || !nright[l + 1])
+                    {
+                        continue;
+                    }
+                const double within = left + right[l + 1];
+                const std::size_t nwithin = nleft + nright[l + 1];
+                const std::size_t nbetween = ntotal - nwithin;
+                if (!nbetween)
+                    {
+                        continue;
+                    }
+                const double between = total - within;
+                const double omega
+                    = (within / static_cast<double>(nwithin))
+                      / (between / static_cast<double>(nbetween));
+                if (std::isnan(rv.omega_max) || omega > rv.omega_max)
+                    {
+                        rv.omega_max = omega;
+                        rv.left_site = l;
+                    }
+            }
+        return rv;
+    }
+
+    LDDecayAccumulator::LDDecayAccumulator(const double bin_width,
+                                           const std::size_t nbins)
+        : sums(nbins, 0.0), counts(nbins, 0), width(bin_width)
+    {
+        if (!(bin_width > 0.0))
+            {
+                throw std::invalid_argument("bin width must be positive");
+            }
+    }
+
+    void
+    LDDecayAccumulator::operator()(const PairwiseLD& ld, const double distance)
+    {
+        if (std::isnan(ld.rsq) || !(distance >= 0.0))
+            {
+                return;
+            }
+        const double bin = std::floor(distance / width);
+        if (bin < static_cast<double>(sums.size()))
+            {
+                const auto k = static_cast<std::size_t>(bin);
+                sums[k] += ld.rsq;
+                ++counts[k];
+            }
+    }
+
+    double
+    LDDecayAccumulator::bin_width() const
+    {
+        return width;
+    }
+
+    const std::vector<std::size_t>&
+    LDDecayAccumulator::npairs() const
+    {
+        return counts;
+    }
+
+    std::vector<double>
+    LDDecayAccumulator::mean_rsq() const
+    {
+        std::vector<double> rv(sums.size(),
+                               std::numeric_limits<double>::quiet_NaN());
+        for (std::size_t k = 0; k < sums.size(); ++k)
+            {
+                if (counts[k])
+                    {
+                        rv[k] = sums[k] / static_cast<double>(counts[k]);
+                    }
+            }
+        return rv;
+    }
+
+    LDSummaries
+    ld_summaries(const VariantMatrix& m, const double bin_width,
+                 const std::size_t nbins, const Executor& executor)
+    {
+        ZnSAccumulator zns;
+        OmegaAccumulator omega(m.nsites());
+        LDDecayAccumulator decay(bin_width, nbins);
+        for_each_pairwise_ld(
+            m, std::numeric_limits<double>::infinity(),
+            [&m, &zns, &omega, &decay](const PairwiseLD& ld) {
+                zns(ld);
+                omega(ld);
+                decay(ld, m.position(ld.j) - m.position(ld.i));
+            },
+            executor);
+        LDSummaries rv;
+        rv.zns = zns.value();
+        rv.omega = omega.value();
+        rv.decay = decay.mean_rsq();
+        rv.decay_npairs = decay.npairs();
+        return rv;
+    }
+} // namespace Sequence
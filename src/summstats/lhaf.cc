@@ -1,44 +1,127 @@
 #include <cstdint>
 #include <algorithm>
-#include <numeric>
 #include <cmath>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/SparseCapsules.hpp>
+#include <Sequence/summstats/lhaf.hpp>
 
 namespace Sequence
 {
-    std::vector<double>
-    lhaf(const VariantMatrix &m, const std::int8_t refstate, const double l)
+    static std::vector<std::vector<double>>
+    power_tables(const std::size_t nsam, const std::vector<double> &l)
+    // k^l for each derived allele count k in [0, nsam],
+    // so that std::pow is called once per count, rather
+    // than once per derived allele.
     {
-        std::vector<long int> dcounts;
-        dcounts.reserve(m.nsites());
-        const auto find_nonref = [refstate](const std::int8_t x) {
-            return x != refstate && !(x < 0);
-        };
-        for (std::size_t i = 0; i < m.nsites(); ++i)
+        std::vector<std::vector<double>> tables;
+        tables.reserve(l.size());
+        for (auto x : l)
             {
-                auto r = get_ConstRowView(m, i);
-                dcounts.push_back(
-                    std::count_if(r.begin(), r.end(), find_nonref));
+                std::vector<double> t(nsam + 1);
+                for (std::size_t k = 0; k <= nsam; ++k)
+                    {
+                        t[k] = std::pow(static_cast<double>(k), x);
+                    }
+                tables.emplace_back(std::move(t));
+            }
+        return tables;
+    }
+
+    static std::vector<std::vector<double>>
+    lhaf_dense(const VariantMatrix &m, const std::int8_t refstate,
+               const std::vector<double> &l)
+    // Sites are visited in order, and the samples carrying a
+    // derived allele at each site are gathered by a branch-free
+    // pass over the contiguous row.  Only their scores are then
+    // updated, for each power.  Each score is summed in the
+    // order of the sites.
+    {
+        const std::size_t nsam = m.nsam(), nsites = m.nsites();
+        const auto tables = power_tables(nsam, l);
+        std::vector<std::vector<double>> rv(l.size(),
+                                            std::vector<double>(nsam, 0.0));
+        std::vector<std::uint32_t> carriers(nsam);
+        for (std::size_t i = 0; i < nsites; ++i)
+            {
+                const std::int8_t *r = get_ConstRowView(m, i).data;
+                std::size_t dcount = 0;
+                for (std::size_t j = 0; j < nsam; ++j)
+                    {
+                        carriers[dcount] = static_cast<std::uint32_t>(j);
+                        dcount += (r[j] != refstate && !(r[j] < 0));
+                    }
+                if (dcount == 0)
+                    {
+                        continue;
+                    }
+                for (std::size_t e = 0; e < l.size(); ++e)
+                    {
+                        const double p = tables[e][dcount];
+                        double *score = rv[e].data();
+                        for (std::size_t k = 0; k < dcount; ++k)
+                            {
+                                score[carriers[k]] += p;
+                            }
+                    }
             }
+        return rv;
+    }
 
-        // Get the values for each element in the data
-        std::vector<double> rv;
-        rv.reserve(m.nsam());
-        for (std::size_t i = 0; i < m.nsam(); ++i)
+    static std::vector<std::vector<double>>
+    lhaf_sparse(const SparseGenotypeCapsule &capsule,
+                const std::vector<double> &l)
+    // For a reference state of 0, only the nonzero
+    // genotypes contribute.  Sites are visited in order,
+    // so each score is summed in the same order as
+    // lhaf_dense.
+    {
+        const auto tables = power_tables(capsule.nsam(), l);
+        std::vector<std::vector<double>> rv(
+            l.size(), std::vector<double>(capsule.nsam(), 0.0));
+        for (std::size_t i = 0; i < capsule.nsites(); ++i)
             {
-                auto c = get_ConstColView(m, i);
-                auto j = std::find_if(c.cbegin(), c.cend(), find_nonref);
-                double score = 0.0;
-                while (j != c.cend())
+                auto samples = capsule.samples(i);
+                auto states = capsule.states(i);
+                const auto n = capsule.nnz(i);
+                auto dcount = static_cast<std::size_t>(std::count_if(
+                    states, states + n,
+                    [](const std::int8_t x) { return x > 0; }));
+                if (dcount == 0)
+                    {
+                        continue;
+                    }
+                for (std::size_t e = 0; e < l.size(); ++e)
                     {
-                        size_t d2 = static_cast<std::size_t>(
-                            std::distance(c.cbegin(), j));
-                        score += std::pow(static_cast<double>(dcounts[d2]), l);
-                        j = std::find_if(j + 1, c.cend(), find_nonref);
+                        const double p = tables[e][dcount];
+                        for (std::size_t k = 0; k < n; ++k)
+                            {
+                                if (states[k] > 0)
+                                    {
+                                        rv[e][samples[k]] += p;
+                                    }
+                            }
                     }
-                rv.push_back(score);
             }
         return rv;
     }
+
+    std::vector<std::vector<double>>
+    lhaf(const VariantMatrix &m, const std::int8_t refstate,
+         const std::vector<double> &l)
+    {
+        auto sparse = dynamic_cast<const SparseGenotypeCapsule *>(
+            &m.genotype_capsule());
+        if (refstate == 0 && sparse != nullptr && sparse->sparse())
+            {
+                return lhaf_sparse(*sparse, l);
+            }
+        return lhaf_dense(m, refstate, l);
+    }
+
+    std::vector<double>
+    lhaf(const VariantMatrix &m, const std::int8_t refstate, const double l)
+    {
+        return std::move(lhaf(m, refstate, std::vector<double>(1, l)).front());
+    }
 } // namespace Sequence
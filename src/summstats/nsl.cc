@@ -6,15 +6,17 @@
 #include <Sequence/VariantMatrixViews.hpp>
 #include <Sequence/summstats/nsl.hpp>
 #include "nsl_common.hpp"
+#include "nsl_pbwt.hpp"
 #include "algorithm.hpp"
+#include "haplotype_access.hpp"
 
 /// \example nSL_from_ms.cc
 namespace
 {
+    template <typename View>
     std::int64_t
-    get_left(const Sequence::ConstColView& sample_i,
-             const Sequence::ConstColView& sample_j, const std::size_t core,
-             std::int64_t minleft)
+    get_left(const View& sample_i, const View& sample_j,
+             const std::size_t core, std::int64_t minleft)
     {
         std::int64_t left = static_cast<std::int64_t>(core) - 1;
         auto state_i = sample_i.begin() + left;
@@ -32,9 +34,10 @@ namespace
         return left;
     }
 
+    template <typename View>
     std::int64_t
-    get_right(const Sequence::ConstColView& sample_i,
-              const Sequence::ConstColView& sample_j, const std::size_t core)
+    get_right(const View& sample_i, const View& sample_j,
+              const std::size_t core)
     {
         auto state_i = sample_i.begin() + static_cast<std::int64_t>(core) + 1;
         auto state_j = sample_j.begin() + static_cast<std::int64_t>(core) + 1;
@@ -43,10 +46,10 @@ namespace
         return std::distance(sample_i.begin(), m.first);
     }
 
+    template <typename View>
     inline bool
     update_edge_matrix(const Sequence::ConstRowView& core_view,
-                       const Sequence::ConstColView& hapi,
-                       const Sequence::ConstColView& hapj,
+                       const View& hapi, const View& hapj,
                        Sequence::summstats_details::suffix_edges& edges,
                        const std::size_t core, const std::size_t i,
                        const std::size_t j)
@@ -79,9 +82,10 @@ namespace
 
 namespace Sequence
 {
-    nSLiHS
-    nsl(const VariantMatrix& m, const std::size_t core,
-        const std::int8_t refstate)
+    template <typename Haplotypes>
+    static nSLiHS
+    nsl_details(const VariantMatrix& m, const Haplotypes& haplotypes,
+                const std::size_t core, const std::int8_t refstate)
     {
         auto core_view = get_ConstRowView(m, core);
         // Keep track of distances from core site
@@ -92,12 +96,12 @@ namespace Sequence
         int counts[2] = { 0, 0 };
         for (std::size_t i = 0; i < m.nsam() - 1; ++i)
             {
-                auto sample_i = get_ConstColView(m, i);
+                auto sample_i = haplotypes(i);
                 for (std::size_t j = i + 1; j < m.nsam(); ++j)
                     {
                         if (core_view[i] == core_view[j] && core_view[i] >= 0)
                             {
-                                auto sample_j = get_ConstColView(m, j);
+                                auto sample_j = haplotypes(j);
                                 //Find where samples i and j differ
                                 auto left
                                     = get_left(sample_i, sample_j, core, 0);
@@ -119,8 +123,10 @@ namespace Sequence
                                            ihs_values, counts);
     }
 
-    std::vector<nSLiHS>
-    nsl(const VariantMatrix& m, const std::int8_t refstate)
+    template <typename Haplotypes>
+    static std::vector<nSLiHS>
+    nsl_details(const VariantMatrix& m, const Haplotypes& haplotypes,
+                const std::int8_t refstate)
     {
         std::vector<nSLiHS> rv;
         if (m.nsam() == 0)
@@ -136,11 +142,11 @@ namespace Sequence
         // -1 mean unevaluated.
         auto npairs = m.nsam() * (m.nsam() - 1) / 2;
         std::vector<summstats_details::suffix_edges> edges(npairs);
-        std::vector<ConstColView> alleles;
+        std::vector<typename Haplotypes::view_type> alleles;
         alleles.reserve(m.nsam());
         for (std::size_t i = 0; i < m.nsam(); ++i)
             {
-                alleles.push_back(get_ConstColView(m, i));
+                alleles.push_back(haplotypes(i));
             }
         for (std::size_t core = 0; core < m.nsites(); ++core)
             {
@@ -176,4 +182,44 @@ namespace Sequence
             }
         return rv;
     }
+
+    nSLiHS
+    nsl(const VariantMatrix& m, const std::size_t core,
+        const std::int8_t refstate)
+    {
+        if (m.haplotype_cache_enabled())
+            {
+                return nsl_details(m, summstats_details::cached_haplotypes(m),
+                                   core, refstate);
+            }
+        return nsl_details(m, summstats_details::column_haplotypes(m), core,
+                           refstate);
+    }
+
+    std::vector<nSLiHS>
+    nsl(const VariantMatrix& m, const std::int8_t refstate)
+    {
+        if (m.nsam() > 1)
+            {
+                bool missing = false;
+                for (std::size_t i = 0; i < m.nsites() && !missing; ++i)
+                    {
+                        auto r = get_ConstRowView(m, i);
+                        missing = std::any_of(
+                            r.cbegin(), r.cend(),
+                            [](const std::int8_t x) { return x < 0; });
+                    }
+                if (!missing)
+                    {
+                        return summstats_details::nsl_pbwt(m, refstate);
+                    }
+            }
+        if (m.haplotype_cache_enabled())
+            {
+                return nsl_details(m, summstats_details::cached_haplotypes(m),
+                                   refstate);
+            }
+        return nsl_details(m, summstats_details::column_haplotypes(m),
+                           refstate);
+    }
 } // namespace Sequence
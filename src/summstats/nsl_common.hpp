@@ -21,7 +21,7 @@ namespace Sequence
             suffix_edges() : left(-1), right(-1) {}
         };
 
-        static void
+        inline void
         update_counts(double nsl_values[2], double ihs_values[2],
                       int counts[2], const std::size_t nsites,
                       // NOTE: code smell here -- dangerous
@@ -0,0 +1,420 @@
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include "nsl_common.hpp"
+#include "nsl_pbwt.hpp"
+
+// For a core site c and a pair of haplotypes with the same state at c,
+// let L be the last site before c where they differ and R the first
+// site after c where they differ.  The pair contributes R - L to nSL
+// if both exist.  Calling the set of such pairs Q, and A the pairs
+// with the same state at c,
+//
+//   sum over Q of L = (sum over A with L >= 0 of L)
+//                     - (sum over A with L >= 0 and no R of L),
+//
+// and similarly for R.  The first term comes from the positional
+// Burrows-Wheeler transform (PBWT) of the sites up to c, where the
+// haplotypes sharing the state at c are adjacent and L is a range
+// maximum of the divergence array.  The same is done for R in a sweep
+// from the last site.  Pairs with no R are identical from c to the
+// end, and so form groups that only merge as c increases.  Their sums
+// are kept with a union-find structure, whose merges are found during
+// the PBWT sweep in the other direction.  The pairs with L < 0 are
+// handled in the same way.
+
+namespace
+{
+    struct pair_sums
+    // Sums over pairs of haplotypes of the
+    // site at which they differ, and its position.
+    {
+        std::int64_t count, sites;
+        double positions;
+        pair_sums() : count(0), sites(0), positions(0.0) {}
+
+        inline void
+        add(const std::int64_t npairs, const std::size_t site,
+            const double position)
+        {
+            count += npairs;
+            sites += npairs * static_cast<std::int64_t>(site);
+            positions += static_cast<double>(npairs) * position;
+        }
+
+        inline void
+        add(const pair_sums& other)
+        {
+            count += other.count;
+            sites += other.sites;
+            positions += other.positions;
+        }
+    };
+
+    // Sums for cores whose state is not, and is, the reference state
+    using core_sums = std::array<pair_sums, 2>;
+
+    struct split_event
+    // Haplotypes a and b are identical at all sites
+    // swept before site, but differ at site.
+    {
+        std::size_t site, a, b;
+    };
+
+    class pbwt_sweep
+    // Adds the sites of a VariantMatrix to the PBWT one at a time,
+    // from the first or the last site.  a is the order of the
+    // haplotypes sorted by the sites added so far, read from the most
+    // recently added.  d[k] is the number of sites added when
+    // haplotypes a[k] and a[k - 1] last differed, so that they match
+    // at all sites added since.
+    {
+      private:
+        const Sequence::VariantMatrix& m;
+        const bool reverse;
+        std::vector<std::size_t> a, a_next, d, d_next, left, right;
+        std::vector<std::size_t> offsets, running_max, first_of_state, stack;
+        std::vector<std::int8_t> touched;
+        std::size_t nadded;
+
+        inline std::size_t
+        site(const std::size_t step) const
+        {
+            return reverse ? m.nsites() - 1 - step : step;
+        }
+
+        void
+        record_splits(const Sequence::ConstRowView& row,
+                      std::vector<split_event>& splits)
+        // Haplotypes that are identical at all sites added
+        // so far are adjacent, with d == 0 after the first.
+        {
+            const auto none = std::numeric_limits<std::size_t>::max();
+            const auto s = site(nadded);
+            std::size_t first = 0;
+            for (std::size_t k = 0; k <= a.size(); ++k)
+                {
+                    if (k == a.size() || (k > 0 && d[k] != 0))
+                        {
+                            for (auto x : touched)
+                                {
+                                    auto i = static_cast<std::size_t>(x);
+                                    first_of_state[i] = none;
+                                }
+                            touched.clear();
+                            first = k;
+                        }
+                    if (k == a.size())
+                        {
+                            break;
+                        }
+                    const auto x = row[a[k]];
+                    auto& f = first_of_state[static_cast<std::size_t>(x)];
+                    if (f == none)
+                        {
+                            f = a[k];
+                            touched.push_back(x);
+                            if (k != first)
+                                {
+                                    splits.push_back(
+                                        split_event{ s, a[first], a[k] });
+                                }
+                        }
+                }
+        }
+
+        void
+        update(const Sequence::ConstRowView& row)
+        {
+            const auto n = a.size();
+            std::size_t nstates = 0;
+            for (std::size_t k = 0; k < n; ++k)
+                {
+                    nstates = std::max(nstates,
+                                       static_cast<std::size_t>(row[k]) + 1);
+                }
+            offsets.assign(nstates, 0);
+            for (std::size_t k = 0; k < n; ++k)
+                {
+                    ++offsets[static_cast<std::size_t>(row[k])];
+                }
+            std::size_t total = 0;
+            for (auto& o : offsets)
+                {
+                    auto c = o;
+                    o = total;
+                    total += c;
+                }
+            running_max.assign(nstates, nadded + 1);
+            for (std::size_t k = 0; k < n; ++k)
+                {
+                    for (auto& p : running_max)
+                        {
+                            p = std::max(p, d[k]);
+                        }
+                    const auto x = static_cast<std::size_t>(row[a[k]]);
+                    const auto i = offsets[x]++;
+                    a_next[i] = a[k];
+                    d_next[i] = running_max[x];
+                    running_max[x] = 0;
+                }
+            a.swap(a_next);
+            d.swap(d_next);
+            ++nadded;
+        }
+
+        void
+        range_maxima(const Sequence::ConstRowView& row,
+                     const std::int8_t refstate, core_sums& sums)
+        // For pairs of haplotypes with the same state at the site just
+        // added, the number of sites added when they last differed
+        // before it is the maximum of d over their range in a, minus
+        // one.  Each d[k] is that maximum for left[k] * right[k] pairs.
+        {
+            const auto n = a.size();
+            stack.clear();
+            for (std::size_t k = 1; k < n; ++k)
+                {
+                    while (!stack.empty() && d[stack.back()] < d[k])
+                        {
+                            stack.pop_back();
+                        }
+                    left[k] = k - (stack.empty() ? 0 : stack.back());
+                    stack.push_back(k);
+                }
+            stack.clear();
+            for (std::size_t k = n - 1; k > 0; --k)
+                {
+                    while (!stack.empty() && d[stack.back()] <= d[k])
+                        {
+                            stack.pop_back();
+                        }
+                    right[k] = (stack.empty() ? n : stack.back()) - k;
+                    stack.push_back(k);
+                }
+            for (std::size_t k = 1; k < n; ++k)
+                {
+                    // d[k] == nadded at boundaries between states, and
+                    // d[k] == 0 if the pairs are identical so far.
+                    if (d[k] > 0 && d[k] < nadded)
+                        {
+                            const auto s = site(d[k] - 1);
+                            const auto x = static_cast<std::size_t>(
+                                row[a[k]] == refstate);
+                            sums[x].add(static_cast<std::int64_t>(left[k])
+                                            * static_cast<std::int64_t>(
+                                                right[k]),
+                                        s, m.position(s));
+                        }
+                }
+        }
+
+      public:
+        pbwt_sweep(const Sequence::VariantMatrix& m_, const bool reverse_)
+            : m(m_), reverse(reverse_), a(m_.nsam()), a_next(m_.nsam()),
+              d(m_.nsam(), 0), d_next(m_.nsam()), left(m_.nsam()),
+              right(m_.nsam()), offsets{}, running_max{},
+              first_of_state(std::numeric_limits<std::int8_t>::max() + 1,
+                             std::numeric_limits<std::size_t>::max()),
+              stack{}, touched{}, nadded(0)
+        {
+            stack.reserve(a.size());
+            for (std::size_t i = 0; i < a.size(); ++i)
+                {
+                    a[i] = i;
+                }
+        }
+
+        void
+        run(const std::int8_t refstate, std::vector<core_sums>& sums,
+            std::vector<split_event>& splits)
+        // sums is indexed by core site.
+        {
+            for (std::size_t step = 0; step < m.nsites(); ++step)
+                {
+                    const auto s = site(step);
+                    auto row = Sequence::get_ConstRowView(m, s);
+                    record_splits(row, splits);
+                    update(row);
+                    range_maxima(row, refstate, sums[s]);
+                }
+        }
+
+        std::vector<std::size_t>
+        identical_haplotypes() const
+        // The first haplotype in a that is identical to each haplotype
+        // at all sites, which must all have been added.
+        {
+            std::vector<std::size_t> rv(a.size());
+            for (std::size_t k = 0; k < a.size(); ++k)
+                {
+                    rv[a[k]] = (k > 0 && d[k] == 0) ? rv[a[k - 1]] : a[k];
+                }
+            return rv;
+        }
+    };
+
+    class haplotype_groups
+    // Groups of haplotypes that only merge, along with the
+    // sums over pairs within each group of the site at which
+    // they differ.
+    {
+      private:
+        std::vector<std::size_t> parent, size, roots;
+        std::vector<pair_sums> sums;
+
+        std::size_t
+        find(std::size_t i)
+        {
+            while (parent[i] != i)
+                {
+                    parent[i] = parent[parent[i]];
+                    i = parent[i];
+                }
+            return i;
+        }
+
+      public:
+        explicit haplotype_groups(const std::vector<std::size_t>& identical)
+            : parent(identical), size(identical.size(), 0), roots{},
+              sums(identical.size())
+        {
+            for (std::size_t i = 0; i < parent.size(); ++i)
+                {
+                    ++size[parent[i]];
+                    if (parent[i] == i)
+                        {
+                            roots.push_back(i);
+                        }
+                }
+        }
+
+        void
+        merge(const std::size_t i, const std::size_t j,
+              const std::size_t site, const double position)
+        // Haplotypes in the groups of i and j differ at site
+        {
+            auto ri = find(i), rj = find(j);
+            if (ri == rj)
+                {
+                    return;
+                }
+            if (size[ri] < size[rj])
+                {
+                    std::swap(ri, rj);
+                }
+            sums[ri].add(sums[rj]);
+            sums[ri].add(static_cast<std::int64_t>(size[ri])
+                             * static_cast<std::int64_t>(size[rj]),
+                         site, position);
+            size[ri] += size[rj];
+            parent[rj] = ri;
+        }
+
+        void
+        finish_merges()
+        {
+            roots.erase(std::remove_if(roots.begin(), roots.end(),
+                                       [this](const std::size_t r) {
+                                           return parent[r] != r;
+                                       }),
+                        roots.end());
+        }
+
+        void
+        add_sums(const Sequence::ConstRowView& row, const std::int8_t refstate,
+                 core_sums& rv) const
+        // All members of a group have the same state at the core site.
+        {
+            for (auto r : roots)
+                {
+                    rv[static_cast<std::size_t>(row[r] == refstate)].add(
+                        sums[r]);
+                }
+        }
+    };
+
+    void
+    group_sums(const Sequence::VariantMatrix& m,
+               const std::vector<std::size_t>& identical,
+               const std::vector<split_event>& splits, const bool reverse,
+               const std::int8_t refstate, std::vector<core_sums>& rv)
+    // splits must be from a sweep in the opposite direction,
+    // and are replayed from the last one recorded.
+    {
+        haplotype_groups groups(identical);
+        auto split = splits.rbegin();
+        for (std::size_t step = 0; step < m.nsites(); ++step)
+            {
+                const auto s = reverse ? m.nsites() - 1 - step : step;
+                groups.add_sums(Sequence::get_ConstRowView(m, s), refstate,
+                                rv[s]);
+                for (; split != splits.rend() && split->site == s; ++split)
+                    {
+                        groups.merge(split->a, split->b, s, m.position(s));
+                    }
+                groups.finish_merges();
+            }
+    }
+} // namespace
+
+namespace Sequence
+{
+    namespace summstats_details
+    {
+        std::vector<nSLiHS>
+        nsl_pbwt(const VariantMatrix& m, const std::int8_t refstate)
+        {
+            const auto nsites = m.nsites();
+            // Sums for pairs with L >= 0 and R < nsites, respectively
+            std::vector<core_sums> left(nsites), right(nsites);
+            // Sums of L for pairs with no R, and of R
+            // for pairs with L < 0, respectively
+            std::vector<core_sums> left_only(nsites), right_only(nsites);
+            std::vector<split_event> prefix_splits, suffix_splits;
+
+            pbwt_sweep forward(m, false);
+            forward.run(refstate, left, prefix_splits);
+            const auto identical = forward.identical_haplotypes();
+            pbwt_sweep(m, true).run(refstate, right, suffix_splits);
+
+            group_sums(m, identical, suffix_splits, false, refstate,
+                       left_only);
+            group_sums(m, identical, prefix_splits, true, refstate,
+                       right_only);
+
+            std::vector<nSLiHS> rv;
+            rv.reserve(nsites);
+            for (std::size_t core = 0; core < nsites; ++core)
+                {
+                    double nsl_values[2], ihs_values[2];
+                    int counts[2];
+                    for (std::size_t i = 0; i < 2; ++i)
+                        {
+                            const auto& l = left[core][i];
+                            const auto& r = right[core][i];
+                            const auto& lo = left_only[core][i];
+                            const auto& ro = right_only[core][i];
+                            counts[i] = static_cast<int>(l.count - lo.count);
+                            nsl_values[i] = static_cast<double>(
+                                (r.sites - ro.sites) - (l.sites - lo.sites));
+                            // Without this check, rounding error would
+                            // give a nonzero sum over no pairs.
+                            ihs_values[i]
+                                = counts[i] ? (r.positions - ro.positions)
+                                                  - (l.positions
+                                                     - lo.positions)
+                                            : 0.0;
+                        }
+                    rv.emplace_back(get_stat(get_ConstRowView(m, core),
+                                             refstate, nsl_values,
+                                             ihs_values, counts));
+                }
+            return rv;
+        }
+    } // namespace summstats_details
+} // namespace Sequence
@@ -0,0 +1,25 @@
+#ifndef SEQUENCE_SUMMSTATS_NSL_PBWT_HPP
+#define SEQUENCE_SUMMSTATS_NSL_PBWT_HPP
+
+// These functions are not exported.
+// They are used internally.
+
+#include <cstdint>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/summstats/nSLiHS.hpp>
+
+namespace Sequence
+{
+    namespace summstats_details
+    {
+        // nSL and iHS for all core sites of m, which must have at
+        // least two samples and no missing data.  The values of nSL
+        // are the same as those from the pairwise algorithm, and
+        // those of iHS differ only by rounding.
+        std::vector<nSLiHS> nsl_pbwt(const VariantMatrix& m,
+                                     const std::int8_t refstate);
+    } // namespace summstats_details
+} // namespace Sequence
+
+#endif
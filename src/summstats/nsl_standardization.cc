@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <Sequence/summstats/nsl_standardization.hpp>
+
+namespace
+{
+    double
+    standardize_value(const Sequence::Sums<double>& s, const double x)
+    {
+        if (!std::isfinite(x) || s.n() < 2)
+            {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+        const double v = s.variance();
+        if (!(v > 0.0))
+            {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+        return (x - s.mean()) / std::sqrt(v);
+    }
+
+    struct extreme_count
+    {
+        std::uint32_t nscores, nextreme;
+        extreme_count() : nscores(0), nextreme(0) {}
+
+        inline void
+        add(const double x, const double threshold)
+        {
+            if (std::isfinite(x))
+                {
+                    ++nscores;
+                    nextreme += (std::fabs(x) > threshold);
+                }
+        }
+
+        inline void
+        remove(const double x, const double threshold)
+        {
+            if (std::isfinite(x))
+                {
+                    --nscores;
+                    nextreme -= (std::fabs(x) > threshold);
+                }
+        }
+
+        inline double
+        fraction() const
+        {
+            if (!nscores)
+                {
+                    return std::numeric_limits<double>::quiet_NaN();
+                }
+            return static_cast<double>(nextreme)
+                   / static_cast<double>(nscores);
+        }
+    };
+} // namespace
+
+namespace Sequence
+{
+    nSLiHSStandardizer::nSLiHSStandardizer(const std::size_t nsam,
+                                           const std::size_t nbins)
+        : nsl_sums_(nbins ? nbins : nsam + 1),
+          ihs_sums_(nbins ? nbins : nsam + 1), nsam_(nsam), per_count(!nbins)
+    {
+        if (!nsam)
+            {
+                throw std::invalid_argument("sample size must be positive");
+            }
+    }
+
+    void
+    nSLiHSStandardizer::operator()(const nSLiHS& x)
+    {
+        const auto b = bin(x.core_count);
+        if (std::isfinite(x.nsl))
+            {
+                nsl_sums_[b] += x.nsl;
+            }
+        if (std::isfinite(x.ihs))
+            {
+                ihs_sums_[b] += x.ihs;
+            }
+    }
+
+    void
+    nSLiHSStandardizer::operator()(const std::vector<nSLiHS>& x)
+    {
+        for (auto& i : x)
+            {
+                this->operator()(i);
+            }
+    }
+
+    nSLiHSStandardizer&
+    nSLiHSStandardizer::operator+=(const nSLiHSStandardizer& other)
+    {
+        if (other.nsam_ != nsam_ || other.per_count != per_count
+            || other.nsl_sums_.size() != nsl_sums_.size())
+            {
+                throw std::invalid_argument(
+                    "sample sizes or numbers of bins differ");
+            }
+        for (std::size_t i = 0; i < nsl_sums_.size(); ++i)
+            {
+                nsl_sums_[i] += other.nsl_sums_[i];
+                ihs_sums_[i] += other.ihs_sums_[i];
+            }
+        return *this;
+    }
+
+    nSLiHSStandardizer
+    operator+(const nSLiHSStandardizer& lhs, const nSLiHSStandardizer& rhs)
+    {
+        return nSLiHSStandardizer(lhs) += rhs;
+    }
+
+    std::size_t
+    nSLiHSStandardizer::nsam() const
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    nSLiHSStandardizer::nbins() const
+    {
+        return nsl_sums_.size();
+    }
+
+    std::size_t
+    nSLiHSStandardizer::bin(const std::int32_t core_count) const
+    {
+        if (core_count < 0 || static_cast<std::size_t>(core_count) > nsam_)
+            {
+                throw std::invalid_argument("core count out of range");
+            }
+        const auto count = static_cast<std::size_t>(core_count);
+        if (per_count)
+            {
+                return count;
+            }
+        return std::min(nsl_sums_.size() - 1,
+                        count * nsl_sums_.size() / nsam_);
+    }
+
+    const std::vector<Sums<double>>&
+    nSLiHSStandardizer::nsl_sums() const
+    {
+        return nsl_sums_;
+    }
+
+    const std::vector<Sums<double>>&
+    nSLiHSStandardizer::ihs_sums() const
+    {
+        return ihs_sums_;
+    }
+
+    nSLiHS
+    nSLiHSStandardizer::standardize(const nSLiHS& x) const
+    {
+        const auto b = bin(x.core_count);
+        return nSLiHS{ standardize_value(nsl_sums_[b], x.nsl),
+                       standardize_value(ihs_sums_[b], x.ihs), x.core_count };
+    }
+
+    std::vector<nSLiHS>
+    nSLiHSStandardizer::standardize(const std::vector<nSLiHS>& x) const
+    {
+        std::vector<nSLiHS> rv;
+        rv.reserve(x.size());
+        for (auto& i : x)
+            {
+                rv.push_back(standardize(i));
+            }
+        return rv;
+    }
+
+    std::size_t
+    ExtremeScoreWindows::nwindows() const
+    {
+        return start.size();
+    }
+
+    ExtremeScoreWindows
+    extreme_score_fractions(const VariantMatrix& m,
+                            const std::vector<nSLiHS>& standardized,
+                            const double window_size, const double step_size,
+                            const double threshold)
+    {
+        if (!(window_size > 0.0) || !(step_size > 0.0))
+            {
+                throw std::invalid_argument(
+                    "window and step sizes must be positive");
+            }
+        if (standardized.size() != m.nsites())
+            {
+                throw std::invalid_argument(
+                    "number of scores differs from number of sites");
+            }
+        ExtremeScoreWindows rv;
+        extreme_count nsl, ihs;
+        std::size_t first = 0, last = 0;
+        const auto nsites = m.nsites();
+        for (std::size_t window = 0; nsites; ++window)
+            {
+                double left = m.position(0)
+                              + static_cast<double>(window) * step_size;
+                if (left > m.position(nsites - 1))
+                    {
+                        break;
+                    }
+                double right = left + window_size;
+                for (; last < nsites && m.position(last) <= right; ++last)
+                    {
+                        nsl.add(standardized[last].nsl, threshold);
+                        ihs.add(standardized[last].ihs, threshold);
+                    }
+                for (; first < last && m.position(first) < left; ++first)
+                    {
+                        nsl.remove(standardized[first].nsl, threshold);
+                        ihs.remove(standardized[first].ihs, threshold);
+                    }
+                rv.start.push_back(left);
+                rv.stop.push_back(right);
+                rv.nsl_nscores.push_back(nsl.nscores);
+                rv.ihs_nscores.push_back(ihs.nscores);
+                rv.nsl_fraction.push_back(nsl.fraction());
+                rv.ihs_fraction.push_back(ihs.fraction());
+            }
+        return rv;
+    }
+} // namespace Sequence
@@ -1,16 +1,19 @@
 #include <algorithm>
-#include <Sequence/summstats/nsl.hpp>
+#include <functional>
+#include <Sequence/summstats/nslx.hpp>
+#include <Sequence/Executor.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
 #include "nsl_common.hpp"
+#include "haplotype_access.hpp"
 
 namespace
 {
+    template <typename View>
     inline bool
     update_edge_matrix(const Sequence::VariantMatrix& m,
                        const std::vector<std::int64_t>& xtons,
                        const Sequence::ConstRowView& core_view,
-                       const Sequence::ConstColView& hapi,
-                       const Sequence::ConstColView& hapj,
+                       const View& hapi, const View& hapj,
                        Sequence::summstats_details::suffix_edges& edges,
                        const std::size_t core, const std::size_t i,
                        const std::size_t j)
@@ -58,16 +61,25 @@ namespace
 
         return rv;
     }
+
+    struct dense_rows
+    {
+        const Sequence::VariantMatrix& m;
+        explicit dense_rows(const Sequence::VariantMatrix& m_) : m(m_) {}
+        inline Sequence::ConstRowView
+        operator()(const std::size_t site) const
+        {
+            return Sequence::get_ConstRowView(m, site);
+        }
+    };
 } // namespace
 
 namespace Sequence
 {
-    std::vector<nSLiHS>
-    nslx(const VariantMatrix& m, const std::int8_t refstate, const int x)
+    static std::vector<std::int64_t>
+    dense_xtons(const VariantMatrix& m, const std::int8_t refstate,
+                const int x)
     {
-        //Need to get indexes of all x-tons.
-        //Then, if two seqs differ at an x-ton,
-        //the stats get updated.
         std::vector<std::int64_t> xtons;
         for (std::int64_t i = 0; i < static_cast<std::int64_t>(m.nsites()); ++i)
             {
@@ -81,23 +93,82 @@ namespace Sequence
                         xtons.push_back(i);
                     }
             }
-        std::vector<nSLiHS> rv;
-        if (xtons.empty() || !m.nsam() || !m.nsites())
+        return xtons;
+    }
+
+    template <typename Rows>
+    static void
+    seed_left_edges(const std::size_t nsam, const Rows& rows,
+                    const std::vector<std::int64_t>& xtons,
+                    const std::int8_t refstate, const std::size_t first_core,
+                    std::vector<summstats_details::suffix_edges>& edges)
+    // Set the left edges to their values after processing all cores
+    // before first_core, which is the last x-ton before first_core
+    // at which each pair differs.  Only pairs including a haplotype
+    // carrying a non-reference state differ at an x-ton, so x-tons
+    // are read backwards until every pair has a left edge or there
+    // are no more x-tons.
+    {
+        std::size_t nunset = edges.size();
+        auto xton = std::lower_bound(xtons.begin(), xtons.end(),
+                                     static_cast<std::int64_t>(first_core));
+        while (xton != xtons.begin() && nunset)
             {
-                return rv;
+                --xton;
+                const auto site = static_cast<std::size_t>(*xton);
+                auto row = rows(site);
+                for (std::size_t k = 0; k < nsam; ++k)
+                    {
+                        if (row[k] < 0 || row[k] == refstate)
+                            {
+                                continue;
+                            }
+                        for (std::size_t j = 0; j < nsam; ++j)
+                            {
+                                if (j == k || row[j] < 0 || row[j] == row[k]
+                                    || (j < k && row[j] != refstate))
+                                    {
+                                        // Pairs of carriers are
+                                        // seen once, from the first.
+                                        continue;
+                                    }
+                                const auto i = std::min(j, k),
+                                           l = std::max(j, k);
+                                auto& e = edges[i * nsam - i * (i + 1) / 2
+                                                + l - i - 1];
+                                if (e.left == -1)
+                                    {
+                                        e.left = *xton;
+                                        --nunset;
+                                    }
+                            }
+                    }
             }
+    }
 
+    template <typename Haplotypes, typename Rows>
+    static void
+    nslx_cores(const VariantMatrix& m, const std::vector<std::int64_t>& xtons,
+               const Haplotypes& haplotypes, const Rows& rows,
+               const std::int8_t refstate, const std::size_t first_core,
+               const std::size_t last_core, nSLiHS* rv)
+    // Cores [first_core, last_core).  The result for
+    // each core is the same for any first_core.
+    {
         std::size_t npairs = m.nsam() * (m.nsam() - 1) / 2;
         std::vector<summstats_details::suffix_edges> edges(npairs);
-        std::vector<ConstColView> alleles;
+        std::vector<typename Haplotypes::view_type> alleles;
         alleles.reserve(m.nsam());
         for (std::size_t i = 0; i < m.nsam(); ++i)
             {
-                alleles.push_back(get_ColView(m, i));
+                alleles.push_back(haplotypes(i));
             }
-        for (std::size_t core = 0; core < m.nsites(); ++core)
+        // Right edges are recalculated as needed,
+        // so only left edges must be seeded.
+        seed_left_edges(m.nsam(), rows, xtons, refstate, first_core, edges);
+        for (std::size_t core = first_core; core < last_core; ++core)
             {
-                auto core_view = get_ConstRowView(m, core);
+                auto core_view = rows(core);
                 // Doing any work requires the existence
                 // of x-tons left and right of core
                 double nsl_values[2] = { 0, 0 };
@@ -124,9 +195,76 @@ namespace Sequence
                                     }
                             }
                     }
-                rv.emplace_back(summstats_details::get_stat(
-                    core_view, refstate, nsl_values, ihs_values, counts));
+                rv[core] = summstats_details::get_stat(
+                    core_view, refstate, nsl_values, ihs_values, counts);
             }
+    }
+
+    template <typename Haplotypes, typename RowsFactory>
+    static std::vector<nSLiHS>
+    nslx_details(const VariantMatrix& m, const std::vector<std::int64_t>& xtons,
+                 const Haplotypes& haplotypes, const RowsFactory& make_rows,
+                 const std::int8_t refstate, const int x,
+                 const Executor& executor)
+    // make_rows returns an object giving access to the sites,
+    // which need not be safe to share between threads.
+    {
+        //If two seqs differ at an x-ton,
+        //the stats get updated.
+        std::vector<nSLiHS> rv;
+        if (xtons.empty() || !m.nsam() || !m.nsites())
+            {
+                return rv;
+            }
+        rv.resize(m.nsites());
+        // Seeding the left edges for a range of cores costs up to
+        // O(nsam * x) per x-ton, compared to O(nsam^2) per core
+        // for processing the range, which limits the useful number
+        // of ranges.
+        std::size_t nranges = 1;
+        if (executor)
+            {
+                nranges = std::min(
+                    std::min<std::size_t>(64, m.nsites()),
+                    std::max<std::size_t>(
+                        1, m.nsam() / (4 * static_cast<std::size_t>(
+                                               std::max(x, 1)))));
+            }
+        const std::size_t range_size = (m.nsites() + nranges - 1) / nranges;
+        std::vector<std::function<void()>> tasks;
+        for (std::size_t first = 0; first < m.nsites(); first += range_size)
+            {
+                const auto last = std::min(m.nsites(), first + range_size);
+                tasks.emplace_back([&m, &xtons, &haplotypes, &make_rows,
+                                    refstate, first, last, &rv]() {
+                    nslx_cores(m, xtons, haplotypes, make_rows(), refstate,
+                               first, last, rv.data());
+                });
+            }
+        run_tasks(executor, tasks);
         return rv;
     }
+
+    std::vector<nSLiHS>
+    nslx(const VariantMatrix& m, const std::int8_t refstate, const int x)
+    {
+        return nslx(m, refstate, x, Executor());
+    }
+
+    std::vector<nSLiHS>
+    nslx(const VariantMatrix& m, const std::int8_t refstate, const int x,
+         const Executor& executor)
+    {
+        //Need to get indexes of all x-tons.
+        auto xtons = dense_xtons(m, refstate, x);
+        auto rows = [&m]() { return dense_rows(m); };
+        if (m.haplotype_cache_enabled())
+            {
+                return nslx_details(m, xtons,
+                                    summstats_details::cached_haplotypes(m),
+                                    rows, refstate, x, executor);
+            }
+        return nslx_details(m, xtons, summstats_details::column_haplotypes(m),
+                            rows, refstate, x, executor);
+    }
 } // namespace Sequence
@@ -0,0 +1,215 @@
+#ifndef SEQUENCE_SUMMSTATS_PACKED_HAPLOTYPES_HPP
+#define SEQUENCE_SUMMSTATS_PACKED_HAPLOTYPES_HPP
+
+// These types are not exported.
+// They are used internally.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+
+namespace Sequence
+{
+    namespace summstats_details
+    {
+        class packed_haplotypes
+        // Haplotypes stored one bit per site.  Allelic states are
+        // split into bit planes, so that two haplotypes differ at a
+        // site if any plane differs there, and missing data are
+        // recorded in a separate mask.  For each haplotype, the words
+        // of all planes (and the mask) for the same 64 sites are
+        // adjacent in memory.
+        {
+          private:
+            std::vector<std::uint64_t> bits;
+            std::size_t nsam_, nsites_, nwords, nplanes, stride;
+            bool missing;
+
+            static std::size_t
+            planes_needed(const std::int8_t max_state)
+            {
+                std::size_t n = 1;
+                while (n < 7 && (max_state >> n) > 0)
+                    {
+                        ++n;
+                    }
+                return n;
+            }
+
+            template <typename RowFunction>
+            void
+            scan(const RowFunction& row, const std::size_t nsites,
+                 std::int8_t& max_state)
+            {
+                max_state = 0;
+                for (std::size_t s = 0; s < nsites; ++s)
+                    {
+                        auto r = row(s);
+                        for (auto x : r)
+                            {
+                                max_state = std::max(max_state, x);
+                                if (x < 0)
+                                    {
+                                        missing = true;
+                                    }
+                            }
+                    }
+            }
+
+            void
+            allocate(const std::size_t nsites, const std::int8_t max_state)
+            {
+                nwords = (nsites + 63) / 64;
+                nplanes = planes_needed(max_state);
+                stride = nplanes + (missing ? 1 : 0);
+                bits.assign(nsam_ * nwords * stride, 0);
+            }
+
+            inline void
+            set(const std::size_t hap, const std::size_t site,
+                const std::int8_t x)
+            {
+                auto w = words(hap) + (site / 64) * stride;
+                const std::uint64_t bit = std::uint64_t(1) << (site % 64);
+                if (x < 0)
+                    {
+                        w[nplanes] |= bit;
+                        return;
+                    }
+                for (std::size_t p = 0; p < nplanes; ++p)
+                    {
+                        if ((x >> p) & 1)
+                            {
+                                w[p] |= bit;
+                            }
+                    }
+            }
+
+          public:
+            explicit packed_haplotypes(const VariantMatrix& m)
+                // Pack from the rows of m.
+                : bits{}, nsam_(m.nsam()), nsites_(m.nsites()), nwords(0),
+                  nplanes(0), stride(0), missing(false)
+            {
+                const auto row
+                    = [&m](std::size_t s) { return get_ConstRowView(m, s); };
+                std::int8_t max_state;
+                scan(row, m.nsites(), max_state);
+                allocate(m.nsites(), max_state);
+                for (std::size_t s = 0; s < m.nsites(); ++s)
+                    {
+                        auto r = row(s);
+                        for (std::size_t i = 0; i < nsam_; ++i)
+                            {
+                                if (r[i])
+                                    {
+                                        set(i, s, r[i]);
+                                    }
+                            }
+                    }
+            }
+
+            explicit packed_haplotypes(const HaplotypeMajorView& v)
+                // Pack from the haplotype-major copy of a VariantMatrix.
+                : bits{}, nsam_(v.nsam), nsites_(v.nsites), nwords(0),
+                  nplanes(0), stride(0), missing(false)
+            {
+                const auto hap
+                    = [&v](std::size_t i) { return v.haplotype(i); };
+                std::int8_t max_state;
+                scan(hap, v.nsam, max_state);
+                allocate(v.nsites, max_state);
+                for (std::size_t i = 0; i < nsam_; ++i)
+                    {
+                        auto h = hap(i);
+                        for (std::size_t s = 0; s < v.nsites; ++s)
+                            {
+                                if (h[s])
+                                    {
+                                        set(i, s, h[s]);
+                                    }
+                            }
+                    }
+            }
+
+            inline std::size_t
+            nsam() const
+            {
+                return nsam_;
+            }
+
+            inline std::size_t
+            nsites() const
+            {
+                return nsites_;
+            }
+
+            inline bool
+            has_missing() const
+            {
+                return missing;
+            }
+
+            bool
+            all_missing(const std::size_t hap) const
+            // True if all sites are missing data
+            // for \a hap, or if there are no sites.
+            {
+                if (!missing)
+                    {
+                        return nsites_ == 0;
+                    }
+                auto w = words(hap) + nplanes;
+                for (std::size_t i = 0; i < nwords; ++i, w += stride)
+                    {
+                        const std::size_t nbits
+                            = std::min<std::size_t>(64, nsites_ - 64 * i);
+                        const std::uint64_t all
+                            = (nbits == 64) ? ~std::uint64_t(0)
+                                            : (std::uint64_t(1) << nbits) - 1;
+                        if (*w != all)
+                            {
+                                return false;
+                            }
+                    }
+                return true;
+            }
+
+            inline std::size_t
+            words_per_haplotype() const
+            {
+                return nwords;
+            }
+
+            inline std::size_t
+            planes() const
+            {
+                return nplanes;
+            }
+
+            inline std::size_t
+            words_per_block() const
+            // Number of adjacent words for each 64 sites
+            {
+                return stride;
+            }
+
+            inline std::uint64_t*
+            words(const std::size_t hap)
+            {
+                return bits.data() + hap * nwords * stride;
+            }
+
+            inline const std::uint64_t*
+            words(const std::size_t hap) const
+            {
+                return bits.data() + hap * nwords * stride;
+            }
+        };
+    } // namespace summstats_details
+} // namespace Sequence
+
+#endif
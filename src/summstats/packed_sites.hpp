@@ -0,0 +1,154 @@
+#ifndef SEQUENCE_SUMMSTATS_PACKED_SITES_HPP
+#define SEQUENCE_SUMMSTATS_PACKED_SITES_HPP
+
+// These types are not exported.
+// They are used internally.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+
+namespace Sequence
+{
+    namespace summstats_details
+    {
+        class packed_sites
+        // The biallelic sites of a VariantMatrix, each stored as a bitset
+        // over samples marking the larger state.  If there are missing
+        // data, a second bitset marks the samples having data.
+        {
+          private:
+            std::vector<std::uint64_t> bits, valid;
+            std::vector<std::int32_t> ones;
+
+          public:
+            // Indexes and positions of the sites in the VariantMatrix
+            std::vector<std::size_t> sites;
+            std::vector<double> positions;
+            std::size_t nsam, nwords;
+
+            explicit packed_sites(const VariantMatrix& m)
+                : bits{}, valid{}, ones{}, sites{}, positions{},
+                  nsam(m.nsam()), nwords((m.nsam() + 63) / 64)
+            {
+                bool missing = false;
+                std::vector<std::int8_t> larger_state;
+                for (std::size_t s = 0; s < m.nsites(); ++s)
+                    {
+                        auto r = get_ConstRowView(m, s);
+                        std::int8_t a = -1, b = -1;
+                        bool biallelic = true;
+                        for (auto x : r)
+                            {
+                                if (x < 0)
+                                    {
+                                        missing = true;
+                                    }
+                                else if (a < 0 || x == a)
+                                    {
+                                        a = x;
+                                    }
+                                else if (b < 0 || x == b)
+                                    {
+                                        b = x;
+                                    }
+                                else
+                                    {
+                                        biallelic = false;
+                                    }
+                            }
+                        if (biallelic && b >= 0)
+                            {
+                                sites.push_back(s);
+                                positions.push_back(m.position(s));
+                                larger_state.push_back(std::max(a, b));
+                            }
+                    }
+                bits.assign(sites.size() * nwords, 0);
+                ones.assign(sites.size(), 0);
+                if (missing)
+                    {
+                        valid.assign(sites.size() * nwords, 0);
+                    }
+                for (std::size_t k = 0; k < sites.size(); ++k)
+                    {
+                        auto r = get_ConstRowView(m, sites[k]);
+                        for (std::size_t i = 0; i < nsam; ++i)
+                            {
+                                const std::uint64_t bit = std::uint64_t(1)
+                                                          << (i % 64);
+                                if (r[i] == larger_state[k])
+                                    {
+                                        bits[k * nwords + i / 64] |= bit;
+                                        ++ones[k];
+                                    }
+                                if (missing && r[i] >= 0)
+                                    {
+                                        valid[k * nwords + i / 64] |= bit;
+                                    }
+                            }
+                    }
+            }
+
+            inline bool
+            has_missing() const
+            {
+                return !valid.empty();
+            }
+
+            inline const std::uint64_t*
+            site_bits(const std::size_t k) const
+            {
+                return bits.data() + k * nwords;
+            }
+
+            inline const std::uint64_t*
+            site_valid(const std::size_t k) const
+            {
+                return valid.data() + k * nwords;
+            }
+
+            inline std::int32_t
+            count(const std::size_t k) const
+            // Number of samples with the larger state
+            {
+                return ones[k];
+            }
+
+            bool
+            incompatible(const std::size_t a, const std::size_t b) const
+            // True if the samples with data at both sites
+            // carry all four two-site haplotypes.
+            {
+                const auto ba = site_bits(a), bb = site_bits(b);
+                std::uint64_t g11 = 0, g10 = 0, g01 = 0, g00 = 0;
+                for (std::size_t w = 0; w < nwords; ++w)
+                    {
+                        std::uint64_t both = ~std::uint64_t(0);
+                        if (has_missing())
+                            {
+                                both = site_valid(a)[w] & site_valid(b)[w];
+                            }
+                        else if (w + 1 == nwords && nsam % 64)
+                            {
+                                both = (std::uint64_t(1) << (nsam % 64)) - 1;
+                            }
+                        g11 |= ba[w] & bb[w];
+                        g10 |= ba[w] & ~bb[w] & both;
+                        g01 |= ~ba[w] & bb[w] & both;
+                        g00 |= ~(ba[w] | bb[w]) & both;
+                        if (g11 && g10 && g01 && g00)
+                            {
+                                return true;
+                            }
+                    }
+                return false;
+            }
+        };
+    } // namespace summstats_details
+} // namespace Sequence
+
+#endif
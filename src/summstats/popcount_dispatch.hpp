@@ -0,0 +1,42 @@
+#ifndef SEQUENCE_SUMMSTATS_POPCOUNT_DISPATCH_HPP
+#define SEQUENCE_SUMMSTATS_POPCOUNT_DISPATCH_HPP
+
+// These macros and functions are not exported.
+// They are used internally by code comparing
+// bit-packed data with population counts.
+
+#if defined(__GNUC__)
+#define SEQUENCE_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define SEQUENCE_ALWAYS_INLINE inline
+#endif
+
+// A function marked SEQUENCE_TARGET_POPCNT may use the popcnt
+// instruction, and must only be called if cpu_has_popcnt()
+// is true.  Elsewhere, the marking does nothing, and
+// cpu_has_popcnt() is false.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEQUENCE_TARGET_POPCNT __attribute__((target("popcnt")))
+#define SEQUENCE_POPCNT_DISPATCH 1
+#else
+#define SEQUENCE_TARGET_POPCNT
+#endif
+
+namespace Sequence
+{
+    namespace summstats_details
+    {
+        inline bool
+        cpu_has_popcnt()
+        {
+#ifdef SEQUENCE_POPCNT_DISPATCH
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("popcnt");
+#else
+            return false;
+#endif
+        }
+    } // namespace summstats_details
+} // namespace Sequence
+
+#endif
@@ -1,56 +1,40 @@
 #include <cstdint>
-#include <Sequence/summstats/ld.hpp>
-#include <Sequence/summstats/allele_counts.hpp>
+#include <Sequence/summstats/classics.hpp>
 #include <Sequence/VariantMatrix.hpp>
-#include <Sequence/AlleleCountMatrix.hpp>
-#include <Sequence/VariantMatrixViews.hpp>
+#include "packed_sites.hpp"
 
 namespace Sequence
 {
-    std::int32_t
-    rmin(const VariantMatrix& m)
+    std::vector<std::pair<std::size_t, std::size_t>>
+    rmin_intervals(const VariantMatrix& m)
     {
-        if (m.nsites() < 2)
-            {
-                return -1;
-            }
-        Sequence::AlleleCountMatrix acm(m);
-        auto ac = allele_counts(acm);
-        std::vector<std::size_t> biallelic_site_indexes;
-        for (std::size_t i = 0; i < ac.size(); ++i)
-            {
-                if (ac[i].nstates == 2)
-                    {
-                        biallelic_site_indexes.push_back(i);
-                    }
-            }
-        if (biallelic_site_indexes.size() < 2)
-            {
-                return 0;
-            }
-        bool flag = false;
+        std::vector<std::pair<std::size_t, std::size_t>> rv;
+        const summstats_details::packed_sites p(m);
+        // The left-most biallelic site that
+        // may begin the next interval
         std::size_t x = 0;
-        std::int32_t rv = 0;
-        for (std::size_t a = x + 1; a < biallelic_site_indexes.size(); ++a)
+        for (std::size_t a = 1; a < p.sites.size(); ++a)
             {
-                for (std::size_t b = (!flag) ? x : a - 1; b < a; ++b)
+                for (std::size_t b = a; b > x; --b)
                     {
-                        flag = false;
-                        // We do not allow missing data to result in
-                        // additional haplotypes
-                        auto tl = two_locus_haplotype_counts(m, a, b, true);
-                        if (tl.size() == 4)
+                        if (p.incompatible(b - 1, a))
                             {
-                                ++rv;
-                                flag = true;
+                                rv.emplace_back(p.sites[b - 1], p.sites[a]);
+                                x = a;
                                 break;
                             }
                     }
-                if (flag == true)
-                    {
-                        x = a;
-                    }
             }
         return rv;
     }
+
+    std::int32_t
+    rmin(const VariantMatrix& m)
+    {
+        if (m.nsites() < 2)
+            {
+                return -1;
+            }
+        return static_cast<std::int32_t>(rmin_intervals(m).size());
+    }
 } // namespace Sequence
@@ -0,0 +1,342 @@
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+#include <Sequence/summstats/sliding_windows.hpp>
+#include "classic_kernels.hpp"
+#include "hprime_faywuh_aggregator.hpp"
+
+namespace
+{
+    class running_sum
+    /// Compensated sum of a set of terms that
+    /// are added to, and removed from, the set.
+    {
+      private:
+        double sum, compensation;
+        std::size_t nonzero, nnan;
+
+        inline void
+        accumulate(const double x)
+        {
+            double t = sum + x;
+            if (std::fabs(sum) >= std::fabs(x))
+                {
+                    compensation += (sum - t) + x;
+                }
+            else
+                {
+                    compensation += (x - t) + sum;
+                }
+            sum = t;
+        }
+
+      public:
+        running_sum() : sum(0.0), compensation(0.0), nonzero(0), nnan(0) {}
+
+        inline void
+        add(const double x)
+        {
+            if (std::isnan(x))
+                {
+                    ++nnan;
+                }
+            else if (x != 0.0)
+                {
+                    ++nonzero;
+                    accumulate(x);
+                }
+        }
+
+        inline void
+        remove(const double x)
+        {
+            if (std::isnan(x))
+                {
+                    --nnan;
+                }
+            else if (x != 0.0)
+                {
+                    --nonzero;
+                    if (!nonzero)
+                        {
+                            // Discard accumulated rounding error
+                            sum = compensation = 0.0;
+                        }
+                    else
+                        {
+                            accumulate(-x);
+                        }
+                }
+        }
+
+        inline double
+        value() const
+        {
+            if (nnan)
+                {
+                    return std::numeric_limits<double>::quiet_NaN();
+                }
+            return sum + compensation;
+        }
+    };
+
+    struct site_contributions
+    /// The contribution of each site to each statistic
+    {
+        std::vector<double> pi, w;
+        std::vector<std::int32_t> nsam, nstates;
+        // For hprime and faywuh
+        std::vector<unsigned> S;
+        std::vector<double> refpi, theta_h, theta_l;
+    };
+
+    site_contributions
+    get_site_contributions(const Sequence::AlleleCountMatrix& c,
+                           const std::vector<double>& a_sub_n,
+                           const std::int8_t refstate,
+                           const bool need_derived)
+    {
+        site_contributions rv;
+        rv.pi.reserve(c.nrow);
+        rv.w.reserve(c.nrow);
+        rv.nsam.reserve(c.nrow);
+        rv.nstates.reserve(c.nrow);
+        auto refindex = static_cast<std::size_t>(refstate);
+        for (std::size_t i = 0; i < c.counts.size(); i += c.ncol)
+            {
+                std::int32_t nsam = 0, nstates = 0;
+                double homozygosity = 0.0;
+                for (std::size_t j = i; j < i + c.ncol; ++j)
+                    {
+                        nsam += c.counts[j];
+                        homozygosity += static_cast<double>(
+                            c.counts[j] * (c.counts[j] - 1));
+                        if (c.counts[j] > 0)
+                            {
+                                ++nstates;
+                            }
+                    }
+                rv.pi.push_back(1.0
+                                - homozygosity
+                                      / static_cast<double>(nsam * (nsam - 1)));
+                rv.w.push_back(
+                    (nstates > 1)
+                        ? static_cast<double>(nstates - 1)
+                              / a_sub_n[static_cast<std::size_t>(nsam)]
+                        : 0.0);
+                rv.nsam.push_back(nsam);
+                rv.nstates.push_back(nstates);
+                if (need_derived)
+                    {
+                        Sequence::detail::hprime_faywuh_row_processor h, l;
+                        h(c, i, refindex, Sequence::detail::stat_is_faywuh());
+                        l(c, i, refindex, Sequence::detail::stat_is_hprime());
+                        rv.S.push_back(h.S);
+                        rv.refpi.push_back(h.pi);
+                        rv.theta_h.push_back(h.theta);
+                        rv.theta_l.push_back(l.theta);
+                    }
+            }
+        return rv;
+    }
+} // namespace
+
+namespace Sequence
+{
+    std::size_t
+    WindowStatisticsTable::nwindows() const
+    {
+        return start.size();
+    }
+
+    const std::vector<double>&
+    WindowStatisticsTable::column(const WindowStatistic s) const
+    {
+        for (std::size_t i = 0; i < statistics.size(); ++i)
+            {
+                if (statistics[i] == s)
+                    {
+                        return columns[i];
+                    }
+            }
+        throw std::invalid_argument("statistic not present in table");
+    }
+
+    WindowStatisticsTable
+    sliding_window_summstats(const VariantMatrix& m, const AlleleCountMatrix& c,
+                             const double window_size, const double step_size,
+                             const std::vector<WindowStatistic>& statistics,
+                             const std::int8_t refstate)
+    {
+        if (!(window_size > 0.0) || !(step_size > 0.0))
+            {
+                throw std::invalid_argument(
+                    "window and step sizes must be positive");
+            }
+        if (c.nrow != m.nsites())
+            {
+                throw std::invalid_argument(
+                    "AlleleCountMatrix and VariantMatrix have different "
+                    "numbers of sites");
+            }
+        bool need_derived = false;
+        for (auto s : statistics)
+            {
+                if (s == WindowStatistic::hprime
+                    || s == WindowStatistic::faywuh)
+                    {
+                        need_derived = true;
+                    }
+            }
+        if (need_derived
+            && (refstate < 0 || static_cast<std::size_t>(refstate) >= c.ncol))
+            {
+                throw std::invalid_argument(
+                    "reference state greater than max allelic state");
+            }
+
+        const auto& a_sub_n = detail::a_sub_n_table(c.nsam);
+        const auto& b_sub_n = detail::b_sub_n_table(c.nsam);
+        const auto nsam = static_cast<std::uint32_t>(c.nsam);
+
+        auto sites = get_site_contributions(c, a_sub_n, refstate, need_derived);
+
+        WindowStatisticsTable rv;
+        rv.statistics = statistics;
+        rv.columns.resize(statistics.size());
+
+        running_sum pi, w, tajd_pi, refpi, theta_h, theta_l;
+        int tajd_S = 0;
+        unsigned S = 0;
+        std::uint32_t nvariable = 0;
+        // Indexes of sites in the window with data, for which
+        // nsam is decreasing, so that the front is the maximum.
+        std::deque<std::size_t> max_nsam;
+
+        std::size_t first = 0, last = 0;
+        const auto nsites = m.nsites();
+        for (std::size_t window = 0; nsites; ++window)
+            {
+                double left = m.position(0)
+                              + static_cast<double>(window) * step_size;
+                if (left > m.position(nsites - 1))
+                    {
+                        break;
+                    }
+                double right = left + window_size;
+                for (; last < nsites && m.position(last) <= right; ++last)
+                    {
+                        pi.add(sites.pi[last]);
+                        w.add(sites.w[last]);
+                        if (sites.nstates[last] > 1)
+                            {
+                                ++nvariable;
+                            }
+                        if (sites.nstates[last] > 0)
+                            {
+                                tajd_pi.add(sites.pi[last]);
+                                tajd_S += sites.nstates[last] - 1;
+                                while (!max_nsam.empty()
+                                       && sites.nsam[max_nsam.back()]
+                                              <= sites.nsam[last])
+                                    {
+                                        max_nsam.pop_back();
+                                    }
+                                max_nsam.push_back(last);
+                            }
+                        if (need_derived)
+                            {
+                                S += sites.S[last];
+                                refpi.add(sites.refpi[last]);
+                                theta_h.add(sites.theta_h[last]);
+                                theta_l.add(sites.theta_l[last]);
+                            }
+                    }
+                for (; first < last && m.position(first) < left; ++first)
+                    {
+                        pi.remove(sites.pi[first]);
+                        w.remove(sites.w[first]);
+                        if (sites.nstates[first] > 1)
+                            {
+                                --nvariable;
+                            }
+                        if (sites.nstates[first] > 0)
+                            {
+                                tajd_pi.remove(sites.pi[first]);
+                                tajd_S -= sites.nstates[first] - 1;
+                            }
+                        if (need_derived)
+                            {
+                                S -= sites.S[first];
+                                refpi.remove(sites.refpi[first]);
+                                theta_h.remove(sites.theta_h[first]);
+                                theta_l.remove(sites.theta_l[first]);
+                            }
+                    }
+                while (!max_nsam.empty() && max_nsam.front() < first)
+                    {
+                        max_nsam.pop_front();
+                    }
+
+                rv.start.push_back(left);
+                rv.stop.push_back(right);
+                rv.nsites.push_back(static_cast<std::uint32_t>(last - first));
+                for (std::size_t i = 0; i < statistics.size(); ++i)
+                    {
+                        double value
+                            = std::numeric_limits<double>::quiet_NaN();
+                        switch (statistics[i])
+                            {
+                            case WindowStatistic::thetapi:
+                                value = pi.value();
+                                break;
+                            case WindowStatistic::thetaw:
+                                value = w.value();
+                                break;
+                            case WindowStatistic::tajd:
+                                if (tajd_S)
+                                    {
+                                        auto n = sites.nsam[max_nsam.front()];
+                                        auto un = static_cast<std::size_t>(n);
+                                        value = detail::tajd_from_sums(
+                                            tajd_pi.value(), tajd_S, n,
+                                            a_sub_n[un], b_sub_n[un]);
+                                    }
+                                break;
+                            case WindowStatistic::hprime:
+                                if (last > first)
+                                    {
+                                        value = detail::hprime_from_sums(
+                                            nsam, S, refpi.value(),
+                                            theta_l.value(), a_sub_n[nsam],
+                                            b_sub_n[nsam], b_sub_n[nsam + 1]);
+                                    }
+                                break;
+                            case WindowStatistic::faywuh:
+                                if (S)
+                                    {
+                                        value = refpi.value()
+                                                - theta_h.value();
+                                    }
+                                break;
+                            case WindowStatistic::nvariable_sites:
+                                value = static_cast<double>(nvariable);
+                                break;
+                            }
+                        rv.columns[i].push_back(value);
+                    }
+            }
+        return rv;
+    }
+
+    WindowStatisticsTable
+    sliding_window_summstats(const VariantMatrix& m, const double window_size,
+                             const double step_size,
+                             const std::vector<WindowStatistic>& statistics,
+                             const std::int8_t refstate)
+    {
+        return sliding_window_summstats(m, AlleleCountMatrix(m), window_size,
+                                        step_size, statistics, refstate);
+    }
+} // namespace Sequence
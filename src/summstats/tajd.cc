@@ -1,7 +1,7 @@
 #include <cmath>
 #include <limits>
 #include <Sequence/AlleleCountMatrix.hpp>
-#include <Sequence/summstats/auxillary.hpp>
+#include "classic_kernels.hpp"
 
 namespace Sequence
 {
@@ -36,22 +36,6 @@ namespace Sequence
                                     / static_cast<double>(nsam * (nsam - 1));
                     }
             }
-        if (!S)
-            {
-                return std::numeric_limits<double>::quiet_NaN();
-            }
-        auto a1 = summstats_aux::a_sub_n(static_cast<std::uint32_t>(max_nsam));
-        double w = static_cast<double>(S) / a1;
-        auto a2 = summstats_aux::b_sub_n(static_cast<std::uint32_t>(max_nsam));
-        auto dn = static_cast<double>(max_nsam);
-        double b1 = (dn + 1.0) / (3.0 * (dn - 1.0));
-        double b2
-            = (2.0 * (std::pow(dn, 2.0) + dn + 3.0)) / (9.0 * dn * (dn - 1.0));
-        double c1 = b1 - 1.0 / a1;
-        double c2 = b2 - (dn + 2.0) / (a1 * dn) + a2 / std::pow(a1, 2.0);
-        double e1 = c1 / a1;
-        double e2 = c2 / (std::pow(a1, 2.0) + a2);
-        double denominator = std::pow((e1 * S + e2 * S * (S - 1.0)), 0.5);
-        return (pi - w) / denominator;
+        return detail::tajd_from_sums(pi, S, max_nsam);
     }
 } // namespace Sequence
@@ -1,47 +1,246 @@
+#include <algorithm>
+#include <functional>
 #include <stdexcept>
 #include <Sequence/AlleleCountMatrix.hpp>
-#include <Sequence/StateCounts.hpp>
+#include <Sequence/BitPackedCapsules.hpp>
+#include <Sequence/TiledCapsules.hpp>
+#include <Sequence/SparseCapsules.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include "state_count_kernels.hpp"
 
-namespace Sequence
+namespace
 {
+    inline std::int32_t
+    popcount(std::uint64_t x)
+    {
+        return __builtin_popcountll(x);
+    }
+
+    void
+    bitpacked_counts(const Sequence::BitPackedGenotypeCapsule& capsule,
+                     const std::size_t ncol, const std::size_t first,
+                     const std::size_t last, std::int32_t* counts)
+    // Counts for packed biallelic data do not need
+    // to unpack the genotypes.
+    {
+        const auto nsam = static_cast<std::int32_t>(capsule.nsam());
+        const auto nwords = capsule.words_per_row();
+        for (std::size_t i = first; i < last; ++i)
+            {
+                std::int32_t derived = 0, nmissing = 0;
+                auto arow = capsule.allele_row(i);
+                for (std::size_t w = 0; w < nwords; ++w)
+                    {
+                        derived += popcount(arow[w]);
+                    }
+                auto mrow = capsule.missing_row(i);
+                if (mrow != nullptr)
+                    {
+                        for (std::size_t w = 0; w < nwords; ++w)
+                            {
+                                nmissing += popcount(mrow[w]);
+                            }
+                    }
+                if (ncol == 1 && derived > 0)
+                    {
+                        throw std::runtime_error("found allele value greater "
+                                                 "than matrix.max_allele");
+                    }
+                auto c = counts + i * ncol;
+                c[0] = nsam - nmissing - derived;
+                if (ncol > 1)
+                    {
+                        c[1] = derived;
+                    }
+            }
+    }
+
     std::vector<std::int32_t>
-    AlleleCountMatrix::init_counts(const VariantMatrix& m)
+    tiled_counts(const Sequence::TiledGenotypeCapsule& capsule,
+                 const std::int8_t max_allele)
+    // Counts are accumulated one tile at a time, so
+    // that tiles evicted to disk are read only once.
     {
-        if (m.max_allele() < 0)
+        const auto ncol = static_cast<std::size_t>(max_allele) + 1;
+        std::vector<std::int32_t> counts(capsule.nsites() * ncol, 0);
+        for (auto b = capsule.blocks_begin(); b != capsule.blocks_end(); ++b)
             {
-                throw std::invalid_argument("matrix max_allele must be >= 0");
+                const auto block = *b;
+                for (std::size_t i = 0; i < block.nsites; ++i)
+                    {
+                        auto c = counts.data() + (block.first_site + i) * ncol;
+                        auto x = Sequence::detail::count_states(
+                            block.data + i * block.nsam, block.nsam, c, ncol);
+                        if (x > max_allele)
+                            {
+                                throw std::runtime_error(
+                                    "found allele value greater than "
+                                    "matrix.max_allele");
+                            }
+                    }
             }
-        std::vector<std::int32_t> counts;
-        counts.reserve(m.nsam() * static_cast<std::size_t>(m.max_allele() + 1));
-        StateCounts c;
-        for (std::size_t i = 0; i < m.nsites(); ++i)
+        return counts;
+    }
+
+    void
+    sparse_counts(const Sequence::SparseGenotypeCapsule& capsule,
+                  const std::int8_t max_allele, const std::size_t first,
+                  const std::size_t last, std::int32_t* counts)
+    // Only the nonzero genotypes are visited.  The count
+    // of state 0 is whatever remains after those and the
+    // missing data are accounted for.
+    {
+        const auto ncol = static_cast<std::size_t>(max_allele) + 1;
+        const auto nsam = static_cast<std::int32_t>(capsule.nsam());
+        for (std::size_t i = first; i < last; ++i)
             {
-                auto r = get_ConstRowView(m, i);
-                if (static_cast<std::int8_t>(c.max_allele_idx) > m.max_allele())
+                auto c = counts + i * ncol;
+                auto states = capsule.states(i);
+                std::int32_t nonzero = 0;
+                for (std::size_t k = 0; k < capsule.nnz(i); ++k)
                     {
-                        throw std::runtime_error("found allele value greater "
-                                                 "than matrix.max_allele");
+                        auto x = states[k];
+                        if (x > 0)
+                            {
+                                if (x > max_allele)
+                                    {
+                                        throw std::runtime_error(
+                                            "found allele value greater "
+                                            "than matrix.max_allele");
+                                    }
+                                ++c[static_cast<std::size_t>(x)];
+                            }
+                        else if (x == Sequence::VariantMatrix::mask)
+                            {
+                                throw std::invalid_argument(
+                                    "reserved value encountered");
+                            }
+                        ++nonzero;
                     }
-                c(r);
-                for (std::size_t j = 0;
-                     j < static_cast<std::size_t>(m.max_allele() + 1); ++j)
+                c[0] = nsam - nonzero;
+            }
+    }
+
+    void
+    dense_counts(const Sequence::VariantMatrix& m, const std::size_t first,
+                 const std::size_t last, std::int32_t* counts)
+    {
+        const auto ncol = static_cast<std::size_t>(m.max_allele()) + 1;
+        for (std::size_t i = first; i < last; ++i)
+            {
+                auto r = Sequence::get_ConstRowView(m, i);
+                auto x = Sequence::detail::count_states(
+                    r.data, r.size(), counts + i * ncol, ncol);
+                if (x > m.max_allele())
                     {
-                        counts.push_back(c.counts[j]);
+                        throw std::runtime_error("found allele value greater "
+                                                 "than matrix.max_allele");
                     }
             }
+    }
+
+    // Sites are assigned to tasks in blocks of this size.
+    constexpr std::size_t sites_per_task = 4096;
+
+    template <typename RangeFunction>
+    void
+    count_site_ranges(const std::size_t nsites,
+                      const Sequence::Executor& executor,
+                      const RangeFunction& f)
+    // Apply f to disjoint ranges of sites using executor.
+    {
+        if (!executor || nsites <= sites_per_task)
+            {
+                f(0, nsites);
+                return;
+            }
+        std::vector<std::function<void()>> tasks;
+        for (std::size_t first = 0; first < nsites; first += sites_per_task)
+            {
+                auto last = std::min(nsites, first + sites_per_task);
+                tasks.emplace_back([&f, first, last]() { f(first, last); });
+            }
+        Sequence::run_tasks(executor, tasks);
+    }
+} // namespace
+
+namespace Sequence
+{
+    std::vector<std::int32_t>
+    AlleleCountMatrix::init_counts(const VariantMatrix& m,
+                                   const Executor& executor)
+    {
+        if (m.max_allele() < 0)
+            {
+                throw std::invalid_argument("matrix max_allele must be >= 0");
+            }
+        const auto ncol = static_cast<std::size_t>(m.max_allele()) + 1;
+        auto packed = dynamic_cast<const BitPackedGenotypeCapsule*>(
+            &m.genotype_capsule());
+        if (packed != nullptr && packed->packed() && m.max_allele() <= 1)
+            {
+                std::vector<std::int32_t> counts(m.nsites() * ncol);
+                auto c = counts.data();
+                count_site_ranges(
+                    m.nsites(), executor,
+                    [packed, ncol, c](std::size_t first, std::size_t last) {
+                        bitpacked_counts(*packed, ncol, first, last, c);
+                    });
+                return counts;
+            }
+        auto tiled = dynamic_cast<const TiledGenotypeCapsule*>(
+            &m.genotype_capsule());
+        if (tiled != nullptr && tiled->tiled())
+            {
+                // Reading tiles may evict others, so
+                // they are counted on this thread.
+                return tiled_counts(*tiled, m.max_allele());
+            }
+        std::vector<std::int32_t> counts(m.nsites() * ncol, 0);
+        auto c = counts.data();
+        auto sparse = dynamic_cast<const SparseGenotypeCapsule*>(
+            &m.genotype_capsule());
+        if (sparse != nullptr && sparse->sparse())
+            {
+                auto max_allele = m.max_allele();
+                count_site_ranges(m.nsites(), executor,
+                                  [sparse, max_allele, c](std::size_t first,
+                                                          std::size_t last) {
+                                      sparse_counts(*sparse, max_allele,
+                                                    first, last, c);
+                                  });
+                return counts;
+            }
+        count_site_ranges(m.nsites(), executor,
+                          [&m, c](std::size_t first, std::size_t last) {
+                              dense_counts(m, first, last, c);
+                          });
         return counts;
     }
 
     AlleleCountMatrix::AlleleCountMatrix(const VariantMatrix& m)
-        : counts(init_counts(m)),
+        : AlleleCountMatrix(m, Executor())
+    {
+    }
+
+    AlleleCountMatrix::AlleleCountMatrix(const VariantMatrix& m,
+                                         const unsigned nthreads)
+        : AlleleCountMatrix(m, (nthreads > 1) ? make_thread_executor(nthreads)
+                                              : Executor())
+    {
+    }
+
+    AlleleCountMatrix::AlleleCountMatrix(const VariantMatrix& m,
+                                         const Executor& executor)
+        : counts(init_counts(m, executor)),
           ncol(!m.empty() ? static_cast<std::size_t>(m.max_allele()) + 1
                                : 0),
           nrow(!m.empty() ? counts.size() / ncol : 0), nsam(m.nsam())
     {
     }
 
-    std::pair<std::vector<std::int32_t>::const_iterator,
-              std::vector<std::int32_t>::const_iterator>
+    std::pair<AlleleCountMatrix::count_storage::const_iterator,
+              AlleleCountMatrix::count_storage::const_iterator>
     AlleleCountMatrix::row(const std::size_t i) const
     {
         if (i >= nrow)
@@ -51,4 +250,22 @@ namespace Sequence
         return std::make_pair(counts.begin() + i * ncol,
                               counts.begin() + i * ncol + ncol);
     }
+
+    AlleleCountMatrix
+    make_row_range(const AlleleCountMatrix& c, const std::size_t beg,
+                   const std::size_t end)
+    {
+        if (end < beg)
+            {
+                throw std::invalid_argument("end must be >= beg");
+            }
+        if (end > c.nrow)
+            {
+                throw std::out_of_range("row range out of range");
+            }
+        return AlleleCountMatrix(
+            AlleleCountMatrix::count_storage(c.counts, beg * c.ncol,
+                                             (end - beg) * c.ncol),
+            c.ncol, end - beg, c.nsam);
+    }
 } // namespace Sequence
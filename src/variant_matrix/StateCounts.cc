@@ -1,6 +1,25 @@
 #include <Sequence/StateCounts.hpp>
 #include <algorithm>
 #include <stdexcept>
+#include "state_count_kernels.hpp"
+
+namespace
+{
+    void
+    update_counts(Sequence::StateCounts& c, const std::int8_t* row,
+                  const std::size_t nsam)
+    {
+        std::fill(c.counts.data(), c.counts.data() + c.max_allele_idx + 1, 0);
+        auto x = Sequence::detail::count_states(row, nsam, c.counts.data(),
+                                                c.counts.size());
+        c.max_allele_idx = (x > 0) ? static_cast<std::size_t>(x) : 0;
+        c.n = 0;
+        for (std::size_t i = 0; i <= c.max_allele_idx; ++i)
+            {
+                c.n += static_cast<std::uint32_t>(c.counts[i]);
+            }
+    }
+} // namespace
 
 namespace Sequence
 {
@@ -19,49 +38,13 @@ namespace Sequence
     void
     StateCounts::operator()(ConstRowView& row)
     {
-        std::fill(counts.begin(), counts.begin() + max_allele_idx + 1, 0);
-        n = 0;
-        max_allele_idx = 0;
-        for (std::size_t i = 0; i < row.size(); ++i)
-            {
-                auto ri = row[i];
-                if (ri >= 0)
-                    {
-                        ++n;
-                        ++counts[static_cast<std::size_t>(ri)];
-                        max_allele_idx = std::max(
-                            max_allele_idx, static_cast<std::size_t>(ri));
-                    }
-                else if (ri == VariantMatrix::mask)
-                    {
-                        throw std::invalid_argument(
-                            "reserved value encountered");
-                    }
-            }
+        update_counts(*this, row.data, row.size());
     }
 
     void
     StateCounts::operator()(const RowView& row)
     {
-        std::fill(counts.begin(), counts.begin() + max_allele_idx + 1, 0);
-        n = 0;
-        max_allele_idx = 0;
-        for (std::size_t i = 0; i < row.size(); ++i)
-            {
-                auto ri = row[i];
-                if (ri >= 0)
-                    {
-                        ++n;
-                        ++counts[static_cast<std::size_t>(ri)];
-                        max_allele_idx = std::max(
-                            max_allele_idx, static_cast<std::size_t>(ri));
-                    }
-                else if (ri == VariantMatrix::mask)
-                    {
-                        throw std::invalid_argument(
-                            "reserved value encountered");
-                    }
-            }
+        update_counts(*this, row.data, row.size());
     }
 
     std::vector<StateCounts>
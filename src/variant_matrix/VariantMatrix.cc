@@ -3,6 +3,7 @@
 #include <Sequence/StateCounts.hpp>
 #include <stdexcept>
 #include <algorithm>
+#include <mutex>
 
 namespace Sequence
 {
@@ -41,7 +42,8 @@ namespace Sequence
     double
     VariantMatrix::position(std::size_t i) const
     {
-        return pcapsule->operator[](i);
+        auto cp = extract_const_ptr(this->pcapsule);
+        return cp->operator[](i);
     }
 
     const double&
@@ -66,7 +68,8 @@ namespace Sequence
     const double*
     VariantMatrix::pbegin() const
     {
-        return pcapsule->begin();
+        auto cp = extract_const_ptr(this->pcapsule);
+        return cp->begin();
     }
 
     const double*
@@ -85,7 +88,8 @@ namespace Sequence
     const double*
     VariantMatrix::pend() const
     {
-        return pcapsule->end();
+        auto cp = extract_const_ptr(this->pcapsule);
+        return cp->end();
     }
 
     const double*
@@ -100,6 +104,7 @@ namespace Sequence
     std::int8_t&
     VariantMatrix::get(const std::size_t site, const std::size_t haplotype)
     {
+        invalidate_haplotype_cache();
         return capsule->operator()(site, haplotype);
     }
 
@@ -107,7 +112,8 @@ namespace Sequence
     VariantMatrix::get(const std::size_t site,
                        const std::size_t haplotype) const
     {
-        return capsule->operator()(site, haplotype);
+        auto cp = extract_const_ptr(this->capsule);
+        return cp->operator()(site, haplotype);
     }
 
     const std::int8_t&
@@ -127,6 +133,7 @@ namespace Sequence
                 throw std::out_of_range(
                     "VariantMatrix::at -- index out of range");
             }
+        invalidate_haplotype_cache();
         return capsule->operator()(site, haplotype);
     }
 
@@ -139,7 +146,8 @@ namespace Sequence
                 throw std::out_of_range(
                     "VariantMatrix::at -- index out of range");
             }
-        return capsule->operator()(site, haplotype);
+        auto cp = extract_const_ptr(this->capsule);
+        return cp->operator()(site, haplotype);
     }
 
     const std::int8_t&
@@ -158,13 +166,15 @@ namespace Sequence
     std::int8_t*
     VariantMatrix::data()
     {
+        invalidate_haplotype_cache();
         return capsule->data();
     }
 
     const std::int8_t*
     VariantMatrix::data() const
     {
-        return capsule->data();
+        auto cp = extract_const_ptr(this->capsule);
+        return cp->data();
     }
 
     const std::int8_t*
@@ -173,6 +183,12 @@ namespace Sequence
         return capsule->cdata();
     }
 
+    const GenotypeCapsule&
+    VariantMatrix::genotype_capsule() const
+    {
+        return *capsule;
+    }
+
     bool
     VariantMatrix::empty() const
     {
@@ -185,13 +201,107 @@ namespace Sequence
         this->capsule.swap(rhs.capsule);
         this->pcapsule.swap(rhs.pcapsule);
         std::swap(this->max_allele_, rhs.max_allele_);
+        std::swap(this->cache_haplotypes_, rhs.cache_haplotypes_);
+        std::swap(this->haplotype_cache_valid, rhs.haplotype_cache_valid);
+        this->haplotype_cache.swap(rhs.haplotype_cache);
+        this->haplotype_cache_built.swap(rhs.haplotype_cache_built);
     }
 
     VariantMatrix
     VariantMatrix::deepcopy() const
     {
-        return VariantMatrix(capsule->clone(), pcapsule->clone(),
-                             max_allele());
+        VariantMatrix rv(capsule->clone(), pcapsule->clone(), max_allele());
+        rv.set_haplotype_cache(cache_haplotypes_);
+        return rv;
+    }
+
+    bool
+    VariantMatrix::release(std::vector<std::int8_t>& data,
+                           std::vector<double>& positions)
+    {
+        auto g = dynamic_cast<VectorGenotypeCapsule*>(capsule.get());
+        auto p = dynamic_cast<VectorPositionCapsule*>(pcapsule.get());
+        if (g == nullptr || p == nullptr)
+            {
+                return false;
+            }
+        invalidate_haplotype_cache();
+        data = g->release();
+        positions = p->release();
+        max_allele_ = 0;
+        return true;
+    }
+
+    void
+    VariantMatrix::build_haplotype_cache() const
+    {
+        // Blocked transpose, so that neither the reads
+        // nor the writes stride through memory one element
+        // at a time.
+        constexpr std::size_t block = 64;
+        const auto S = nsites(), n = nsam();
+        const auto stride = capsule->stride();
+        const auto first = cdata() + capsule->row_offset() * stride
+                           + capsule->col_offset();
+        haplotype_cache.resize(S * n);
+        for (std::size_t i = 0; i < S; i += block)
+            {
+                const auto imax = std::min(i + block, S);
+                for (std::size_t j = 0; j < n; j += block)
+                    {
+                        const auto jmax = std::min(j + block, n);
+                        for (std::size_t site = i; site < imax; ++site)
+                            {
+                                const auto row = first + site * stride;
+                                for (std::size_t hap = j; hap < jmax; ++hap)
+                                    {
+                                        haplotype_cache[hap * S + site]
+                                            = row[hap];
+                                    }
+                            }
+                    }
+            }
+        haplotype_cache_valid = true;
+    }
+
+    void
+    VariantMatrix::invalidate_haplotype_cache()
+    {
+        if (haplotype_cache_valid)
+            {
+                haplotype_cache_valid = false;
+                std::vector<std::int8_t>().swap(haplotype_cache);
+                haplotype_cache_built.reset(new std::once_flag);
+            }
+    }
+
+    void
+    VariantMatrix::set_haplotype_cache(const bool enable)
+    {
+        cache_haplotypes_ = enable;
+        if (!enable)
+            {
+                invalidate_haplotype_cache();
+            }
+    }
+
+    bool
+    VariantMatrix::haplotype_cache_enabled() const
+    {
+        return cache_haplotypes_;
+    }
+
+    const std::int8_t*
+    VariantMatrix::haplotype_major_data() const
+    {
+        if (!cache_haplotypes_)
+            {
+                throw std::runtime_error("haplotype cache is not enabled");
+            }
+        // Concurrent const access may get here from several threads.
+        std::call_once(*haplotype_cache_built,
+                       [this]() { build_haplotype_cache(); });
+        return haplotype_cache.data();
     }
 
     bool
@@ -203,6 +313,7 @@ namespace Sequence
     void
     VariantMatrix::resize_capsules(bool remove_sites)
     {
+        invalidate_haplotype_cache();
         capsule->resize(remove_sites);
         pcapsule->resize(remove_sites);
     }
@@ -106,4 +106,28 @@ namespace Sequence
     {
         return const_col_view_wrapper<ConstColView>(m, col);
     }
+
+    HaplotypeMajorView::HaplotypeMajorView(const std::int8_t* data_,
+                                           std::size_t nsites_,
+                                           std::size_t nsam_)
+        : data(data_), nsites(nsites_), nsam(nsam_)
+    {
+    }
+
+    ConstRowView
+    HaplotypeMajorView::haplotype(const std::size_t i) const
+    {
+        if (i >= nsam)
+            {
+                throw std::out_of_range("haplotype index out of range");
+            }
+        return ConstRowView(data + i * nsites, nsites);
+    }
+
+    HaplotypeMajorView
+    get_HaplotypeMajorView(const VariantMatrix& m)
+    {
+        return HaplotypeMajorView(m.haplotype_major_data(), m.nsites(),
+                                  m.nsam());
+    }
 } // namespace Sequence
@@ -0,0 +1,537 @@
+#include <config.h>
+#include <Sequence/variant_matrix/binaryformat.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+    const char magic[8] = { 'L', 'I', 'B', 'S', 'E', 'Q', 'V', 'B' };
+    const std::uint32_t format_version = 1;
+    constexpr std::size_t header_size = 48;
+    constexpr std::size_t trailer_size = 16;
+    // Each entry of the index is offset, compressed size,
+    // and uncompressed size.
+    constexpr std::size_t index_entry = 3;
+
+    struct header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::int8_t max_allele;
+        std::uint8_t compression;
+        char padding[2];
+        std::uint64_t nsites, nsam, sites_per_block, nblocks;
+    };
+
+    static_assert(sizeof(header) == header_size,
+                  "unexpected padding in binary format header");
+
+    struct trailer
+    {
+        std::uint64_t index_offset;
+        char magic[8];
+    };
+
+    static_assert(sizeof(trailer) == trailer_size,
+                  "unexpected padding in binary format trailer");
+
+    void
+    compress_block(const Sequence::BinaryFormatCompression c,
+                   const std::vector<char>& raw, std::vector<char>& compressed)
+    {
+        switch (c)
+            {
+            case Sequence::BinaryFormatCompression::none:
+                compressed.assign(raw.begin(), raw.end());
+                return;
+#ifdef HAVE_ZLIB
+            case Sequence::BinaryFormatCompression::zlib:
+                {
+                    uLongf n = compressBound(static_cast<uLong>(raw.size()));
+                    compressed.resize(n);
+                    if (compress2(
+                            reinterpret_cast<Bytef*>(compressed.data()), &n,
+                            reinterpret_cast<const Bytef*>(raw.data()),
+                            static_cast<uLong>(raw.size()),
+                            Z_DEFAULT_COMPRESSION)
+                        != Z_OK)
+                        {
+                            throw std::runtime_error(
+                                "zlib compression failed");
+                        }
+                    compressed.resize(n);
+                    return;
+                }
+#endif
+#ifdef HAVE_ZSTD
+            case Sequence::BinaryFormatCompression::zstd:
+                {
+                    compressed.resize(ZSTD_compressBound(raw.size()));
+                    auto n = ZSTD_compress(compressed.data(),
+                                           compressed.size(), raw.data(),
+                                           raw.size(), 3);
+                    if (ZSTD_isError(n))
+                        {
+                            throw std::runtime_error(
+                                "zstd compression failed");
+                        }
+                    compressed.resize(n);
+                    return;
+                }
+#endif
+            default:
+                throw std::invalid_argument("unsupported compression");
+            }
+    }
+
+    // Returns false if the block is damaged
+    bool
+    decompress_block(const Sequence::BinaryFormatCompression c,
+                     const std::vector<char>& compressed,
+                     std::vector<char>& raw)
+    {
+        switch (c)
+            {
+            case Sequence::BinaryFormatCompression::none:
+                if (compressed.size() != raw.size())
+                    {
+                        return false;
+                    }
+                std::copy(compressed.begin(), compressed.end(), raw.begin());
+                return true;
+#ifdef HAVE_ZLIB
+            case Sequence::BinaryFormatCompression::zlib:
+                {
+                    uLongf n = static_cast<uLongf>(raw.size());
+                    return uncompress(
+                               reinterpret_cast<Bytef*>(raw.data()), &n,
+                               reinterpret_cast<const Bytef*>(
+                                   compressed.data()),
+                               static_cast<uLong>(compressed.size()))
+                               == Z_OK
+                           && n == raw.size();
+                }
+#endif
+#ifdef HAVE_ZSTD
+            case Sequence::BinaryFormatCompression::zstd:
+                {
+                    auto n = ZSTD_decompress(raw.data(), raw.size(),
+                                             compressed.data(),
+                                             compressed.size());
+                    return !ZSTD_isError(n) && n == raw.size();
+                }
+#endif
+            default:
+                return false;
+            }
+    }
+} // namespace
+
+namespace Sequence
+{
+    bool
+    binaryformat_supports(const BinaryFormatCompression c)
+    {
+        switch (c)
+            {
+            case BinaryFormatCompression::none:
+                return true;
+            case BinaryFormatCompression::zlib:
+#ifdef HAVE_ZLIB
+                return true;
+#else
+                return false;
+#endif
+            case BinaryFormatCompression::zstd:
+#ifdef HAVE_ZSTD
+                return true;
+#else
+                return false;
+#endif
+            }
+        return false;
+    }
+
+    BinaryFormatWriter::BinaryFormatWriter(
+        const std::string& filename_,
+        const BinaryFormatCompression compression_,
+        const std::size_t sites_per_block_)
+        : out(), filename(filename_), compression(compression_), nsam(0),
+          sites_per_block(sites_per_block_), nsites(0), max_allele(0),
+          have_nsam(false), closed(false), positions(), genotypes(),
+          index(), raw(), compressed()
+    {
+        if (!binaryformat_supports(compression))
+            {
+                throw std::invalid_argument(
+                    "compression not supported by this build");
+            }
+        if (sites_per_block == 0)
+            {
+                throw std::invalid_argument(
+                    "sites_per_block must be greater than zero");
+            }
+        out.open(filename, std::ios_base::binary);
+        if (!out)
+            {
+                throw std::runtime_error("could not open " + filename);
+            }
+        // The header is filled in by close()
+        const char placeholder[header_size] = {};
+        out.write(placeholder, header_size);
+    }
+
+    BinaryFormatWriter::~BinaryFormatWriter()
+    {
+        try
+            {
+                close();
+            }
+        catch (...)
+            {
+            }
+    }
+
+    void
+    BinaryFormatWriter::write_block()
+    {
+        const auto n = positions.size();
+        if (n == 0)
+            {
+                return;
+            }
+        raw.resize(n * sizeof(double) + genotypes.size());
+        std::memcpy(raw.data(), positions.data(), n * sizeof(double));
+        std::memcpy(raw.data() + n * sizeof(double), genotypes.data(),
+                    genotypes.size());
+        const std::vector<char>* block = &raw;
+        if (compression != BinaryFormatCompression::none)
+            {
+                compress_block(compression, raw, compressed);
+                block = &compressed;
+            }
+        index.push_back(static_cast<std::uint64_t>(out.tellp()));
+        index.push_back(block->size());
+        index.push_back(raw.size());
+        out.write(block->data(), static_cast<std::streamsize>(block->size()));
+        if (!out)
+            {
+                throw std::runtime_error("error writing to " + filename);
+            }
+        positions.clear();
+        genotypes.clear();
+    }
+
+    void
+    BinaryFormatWriter::write(const VariantMatrix& m)
+    {
+        if (closed)
+            {
+                throw std::runtime_error(filename + " has been closed");
+            }
+        const auto msites = m.nsites();
+        if (msites == 0)
+            {
+                return;
+            }
+        const auto msam = m.nsam();
+        if (!have_nsam)
+            {
+                nsam = msam;
+                have_nsam = true;
+                positions.reserve(sites_per_block);
+                genotypes.reserve(sites_per_block * nsam);
+            }
+        else if (msam != nsam)
+            {
+                throw std::invalid_argument("sample size differs from that "
+                                            "of previous matrices");
+            }
+        max_allele = std::max(max_allele, m.max_allele());
+        const auto pos = m.cpbegin();
+        // Rows are copied one at a time, as m may
+        // be a window into a larger matrix.
+        for (std::size_t i = 0; i < msites; ++i)
+            {
+                positions.push_back(pos[i]);
+                auto r = get_ConstRowView(m, i);
+                genotypes.insert(genotypes.end(), r.cbegin(), r.cend());
+                if (positions.size() == sites_per_block)
+                    {
+                        write_block();
+                    }
+            }
+        nsites += msites;
+    }
+
+    void
+    BinaryFormatWriter::close()
+    {
+        if (closed)
+            {
+                return;
+            }
+        closed = true;
+        write_block();
+        trailer t;
+        t.index_offset = static_cast<std::uint64_t>(out.tellp());
+        std::memcpy(t.magic, magic, sizeof(magic));
+        out.write(reinterpret_cast<const char*>(index.data()),
+                  static_cast<std::streamsize>(index.size()
+                                               * sizeof(std::uint64_t)));
+        out.write(reinterpret_cast<const char*>(&t), trailer_size);
+
+        header h;
+        std::memcpy(h.magic, magic, sizeof(magic));
+        h.version = format_version;
+        h.max_allele = max_allele;
+        h.compression = static_cast<std::uint8_t>(compression);
+        std::memset(h.padding, 0, sizeof(h.padding));
+        h.nsites = nsites;
+        h.nsam = nsam;
+        h.sites_per_block = sites_per_block;
+        h.nblocks = index.size() / index_entry;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&h), header_size);
+        out.close();
+        if (!out)
+            {
+                throw std::runtime_error("error writing to " + filename);
+            }
+    }
+
+    BinaryFormatReader::BinaryFormatReader(const std::string& filename_)
+        : in(filename_, std::ios_base::binary), filename(filename_),
+          compression_(BinaryFormatCompression::none), nsites_(0), nsam_(0),
+          sites_per_block_(0), max_allele_(0), index(), raw(), compressed()
+    {
+        if (!in)
+            {
+                throw std::runtime_error("could not open " + filename);
+            }
+        in.seekg(0, std::ios_base::end);
+        const auto file_size = static_cast<std::uint64_t>(in.tellg());
+        header h;
+        trailer t;
+        in.seekg(0);
+        if (file_size < header_size + trailer_size
+            || !in.read(reinterpret_cast<char*>(&h), header_size))
+            {
+                throw std::runtime_error(filename + " is too small");
+            }
+        if (std::memcmp(h.magic, magic, sizeof(magic)) != 0
+            || h.version != format_version)
+            {
+                throw std::runtime_error(
+                    filename
+                    + " was not written by Sequence::to_binaryformat, "
+                      "was written by an incompatible version, or has a "
+                      "different byte order");
+            }
+        compression_ = static_cast<BinaryFormatCompression>(h.compression);
+        if (!binaryformat_supports(compression_))
+            {
+                throw std::runtime_error(
+                    filename
+                    + " uses a compression not supported by this build");
+            }
+        in.seekg(static_cast<std::streamoff>(file_size - trailer_size));
+        if (!in.read(reinterpret_cast<char*>(&t), trailer_size)
+            || std::memcmp(t.magic, magic, sizeof(magic)) != 0)
+            {
+                throw std::runtime_error(filename + " is truncated");
+            }
+        // Sizes are checked by division, so that values in a damaged
+        // file cannot overflow the products used below.  A valid file
+        // has nsites * (8 + nsam) bytes of uncompressed blocks, which
+        // must fit in a std::size_t.
+        const std::uint64_t max_size = std::numeric_limits<std::size_t>::max();
+        const bool sizes_ok
+            = h.sites_per_block != 0 && h.nsites <= max_size
+              && h.sites_per_block <= max_size
+              && h.nsam <= max_size - sizeof(double)
+              && (h.nsites == 0
+                  || (h.nsam + sizeof(double)) <= max_size / h.nsites)
+              && h.nblocks
+                     == h.nsites / h.sites_per_block
+                            + (h.nsites % h.sites_per_block != 0)
+              && h.nblocks <= (file_size - header_size - trailer_size)
+                                  / (index_entry * sizeof(std::uint64_t));
+        if (!sizes_ok || t.index_offset < header_size
+            || t.index_offset > file_size - trailer_size
+            || (file_size - trailer_size - t.index_offset)
+                   != h.nblocks * index_entry * sizeof(std::uint64_t))
+            {
+                throw std::runtime_error(filename + " is damaged");
+            }
+        const std::uint64_t nentries = h.nblocks * index_entry;
+        nsites_ = h.nsites;
+        nsam_ = h.nsam;
+        sites_per_block_ = h.sites_per_block;
+        max_allele_ = h.max_allele;
+        index.resize(nentries);
+        in.seekg(static_cast<std::streamoff>(t.index_offset));
+        if (!in.read(reinterpret_cast<char*>(index.data()),
+                     static_cast<std::streamsize>(nentries
+                                                  * sizeof(std::uint64_t))))
+            {
+                throw std::runtime_error("error reading " + filename);
+            }
+        for (std::size_t b = 0; b < nblocks(); ++b)
+            {
+                const auto sites = block_sites(b);
+                const auto expected = (sites.second - sites.first)
+                                      * (sizeof(double) + nsam_);
+                const auto offset = index[index_entry * b];
+                const auto size = index[index_entry * b + 1];
+                if (offset < header_size || offset > t.index_offset
+                    || size > t.index_offset - offset
+                    || index[index_entry * b + 2] != expected)
+                    {
+                        throw std::runtime_error(filename + " is damaged");
+                    }
+            }
+    }
+
+    std::size_t
+    BinaryFormatReader::nsites() const
+    {
+        return nsites_;
+    }
+
+    std::size_t
+    BinaryFormatReader::nsam() const
+    {
+        return nsam_;
+    }
+
+    std::int8_t
+    BinaryFormatReader::max_allele() const
+    {
+        return max_allele_;
+    }
+
+    BinaryFormatCompression
+    BinaryFormatReader::compression() const
+    {
+        return compression_;
+    }
+
+    std::size_t
+    BinaryFormatReader::sites_per_block() const
+    {
+        return sites_per_block_;
+    }
+
+    std::size_t
+    BinaryFormatReader::nblocks() const
+    {
+        return index.size() / index_entry;
+    }
+
+    std::pair<std::size_t, std::size_t>
+    BinaryFormatReader::block_sites(const std::size_t block) const
+    {
+        if (block >= nblocks())
+            {
+                throw std::out_of_range("block index out of range");
+            }
+        const auto first = block * sites_per_block_;
+        return std::make_pair(first,
+                              std::min(first + sites_per_block_, nsites_));
+    }
+
+    void
+    BinaryFormatReader::read_block(const std::size_t block) const
+    {
+        const auto offset = index[index_entry * block];
+        const auto size = index[index_entry * block + 1];
+        raw.resize(index[index_entry * block + 2]);
+        // Uncompressed blocks are read in place
+        const bool in_place = compression_ == BinaryFormatCompression::none
+                              && size == raw.size();
+        auto& dest = in_place ? raw : compressed;
+        dest.resize(size);
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(offset));
+        if (!in.read(dest.data(), static_cast<std::streamsize>(size)))
+            {
+                throw std::runtime_error("error reading " + filename);
+            }
+        if (!in_place && !decompress_block(compression_, compressed, raw))
+            {
+                throw std::runtime_error(filename + " is damaged");
+            }
+    }
+
+    VariantMatrix
+    BinaryFormatReader::read_sites(const std::size_t first,
+                                   const std::size_t last) const
+    {
+        if (first > last || last > nsites_)
+            {
+                throw std::out_of_range("site range out of range");
+            }
+        std::vector<double> pos(last - first);
+        std::vector<std::int8_t> data(pos.size() * nsam_);
+        if (pos.empty())
+            {
+                return VariantMatrix(std::move(data), std::move(pos));
+            }
+        for (std::size_t b = first / sites_per_block_;
+             b <= (last - 1) / sites_per_block_; ++b)
+            {
+                read_block(b);
+                const auto sites = block_sites(b);
+                const auto bsites = sites.second - sites.first;
+                const auto lo = std::max(first, sites.first);
+                const auto hi = std::min(last, sites.second);
+                std::memcpy(pos.data() + (lo - first),
+                            raw.data() + (lo - sites.first) * sizeof(double),
+                            (hi - lo) * sizeof(double));
+                std::memcpy(data.data() + (lo - first) * nsam_,
+                            raw.data() + bsites * sizeof(double)
+                                + (lo - sites.first) * nsam_,
+                            (hi - lo) * nsam_);
+            }
+        return VariantMatrix(std::move(data), std::move(pos), max_allele_);
+    }
+
+    VariantMatrix
+    BinaryFormatReader::read_block_matrix(const std::size_t block) const
+    {
+        const auto sites = block_sites(block);
+        return read_sites(sites.first, sites.second);
+    }
+
+    VariantMatrix
+    BinaryFormatReader::read() const
+    {
+        return read_sites(0, nsites_);
+    }
+
+    void
+    to_binaryformat(const VariantMatrix& m, const std::string& filename,
+                    const BinaryFormatCompression compression,
+                    const std::size_t sites_per_block)
+    {
+        BinaryFormatWriter w(filename, compression, sites_per_block);
+        w.write(m);
+        w.close();
+    }
+
+    VariantMatrix
+    from_binaryformat(const std::string& filename)
+    {
+        return BinaryFormatReader(filename).read();
+    }
+} // namespace Sequence
@@ -0,0 +1,376 @@
+#include <Sequence/BitPackedCapsules.hpp>
+#include <Sequence/VectorCapsules.hpp>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+    constexpr std::size_t word_bits = 64;
+
+    inline std::uint64_t
+    bit(std::size_t sample)
+    {
+        return std::uint64_t(1) << (sample % word_bits);
+    }
+} // namespace
+
+namespace Sequence
+{
+    constexpr std::size_t BitPackedGenotypeCapsule::no_missing_row;
+
+    BitPackedGenotypeCapsule::BitPackedGenotypeCapsule(
+        const std::vector<std::int8_t>& data, std::size_t num_rows)
+        : alleles{}, missing{}, missing_index{}, dense{}, unpacked{},
+          nsites_(num_rows),
+          nsam_((num_rows > 0) ? data.size() / num_rows : 0),
+          words_per_row_((nsam_ + word_bits - 1) / word_bits), packed_(true)
+    {
+        if (num_rows > 0 && data.size() % num_rows != 0)
+            {
+                throw std::invalid_argument("incorrect dimensions");
+            }
+        alleles.resize(nsites_ * words_per_row_, 0);
+        missing_index.resize(nsites_, no_missing_row);
+        for (std::size_t site = 0; site < nsites_; ++site)
+            {
+                auto row = data.data() + site * nsam_;
+                auto arow = alleles.data() + site * words_per_row_;
+                for (std::size_t sample = 0; sample < nsam_; ++sample)
+                    {
+                        auto x = row[sample];
+                        if (x == 1)
+                            {
+                                arow[sample / word_bits] |= bit(sample);
+                            }
+                        else if (x < 0)
+                            {
+                                if (x == std::numeric_limits<std::int8_t>::min())
+                                    {
+                                        throw std::invalid_argument(
+                                            "reserved value encountered");
+                                    }
+                                if (missing_index[site] == no_missing_row)
+                                    {
+                                        missing_index[site] = missing.size();
+                                        missing.resize(missing.size()
+                                                           + words_per_row_,
+                                                       0);
+                                    }
+                                missing[missing_index[site] + sample / word_bits]
+                                    |= bit(sample);
+                            }
+                        else if (x != 0)
+                            {
+                                throw std::invalid_argument(
+                                    "BitPackedGenotypeCapsule requires "
+                                    "allelic states of 0 or 1");
+                            }
+                    }
+            }
+    }
+
+    BitPackedGenotypeCapsule::BitPackedGenotypeCapsule(
+        std::vector<std::uint64_t> alleles_, std::vector<std::uint64_t> missing_,
+        std::vector<std::size_t> missing_index_, std::size_t nsites,
+        std::size_t nsam)
+        : alleles(std::move(alleles_)), missing(std::move(missing_)),
+          missing_index(std::move(missing_index_)), dense{}, unpacked{},
+          nsites_(nsites),
+          nsam_(nsam), words_per_row_((nsam_ + word_bits - 1) / word_bits),
+          packed_(true)
+    {
+    }
+
+    void
+    BitPackedGenotypeCapsule::unpack() const
+    {
+        if (!packed_)
+            {
+                return;
+            }
+        // Concurrent const access may get here from several threads.
+        std::call_once(unpacked, [this]() {
+            dense.resize(nsites_ * nsam_);
+            auto d = dense.data();
+            for (std::size_t site = 0; site < nsites_; ++site)
+                {
+                    auto arow = allele_row(site);
+                    auto mrow = missing_row(site);
+                    for (std::size_t sample = 0; sample < nsam_;
+                         ++sample, ++d)
+                        {
+                            auto w = sample / word_bits;
+                            if (mrow != nullptr && (mrow[w] & bit(sample)))
+                                {
+                                    *d = -1;
+                                }
+                            else
+                                {
+                                    *d = static_cast<std::int8_t>(
+                                        (arow[w] & bit(sample)) != 0);
+                                }
+                        }
+                }
+        });
+    }
+
+    void
+    BitPackedGenotypeCapsule::convert_to_dense()
+    {
+        if (!packed_)
+            {
+                return;
+            }
+        unpack();
+        packed_ = false;
+        std::vector<std::uint64_t>().swap(alleles);
+        std::vector<std::uint64_t>().swap(missing);
+        std::vector<std::size_t>().swap(missing_index);
+    }
+
+    bool
+    BitPackedGenotypeCapsule::packed() const
+    {
+        return packed_;
+    }
+
+    std::size_t
+    BitPackedGenotypeCapsule::words_per_row() const
+    {
+        return words_per_row_;
+    }
+
+    const std::uint64_t*
+    BitPackedGenotypeCapsule::allele_row(std::size_t site) const
+    {
+        return alleles.data() + site * words_per_row_;
+    }
+
+    const std::uint64_t*
+    BitPackedGenotypeCapsule::missing_row(std::size_t site) const
+    {
+        if (missing_index[site] == no_missing_row)
+            {
+                return nullptr;
+            }
+        return missing.data() + missing_index[site];
+    }
+
+    std::int8_t
+    BitPackedGenotypeCapsule::state(std::size_t site, std::size_t sample) const
+    {
+        if (!packed_)
+            {
+                return dense[site * nsam_ + sample];
+            }
+        auto w = sample / word_bits;
+        auto mrow = missing_row(site);
+        if (mrow != nullptr && (mrow[w] & bit(sample)))
+            {
+                return -1;
+            }
+        return static_cast<std::int8_t>((allele_row(site)[w] & bit(sample))
+                                        != 0);
+    }
+
+    std::size_t&
+    BitPackedGenotypeCapsule::nsites()
+    {
+        return nsites_;
+    }
+
+    std::size_t&
+    BitPackedGenotypeCapsule::nsam()
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    BitPackedGenotypeCapsule::nsites() const
+    {
+        return nsites_;
+    }
+
+    std::size_t
+    BitPackedGenotypeCapsule::nsam() const
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    BitPackedGenotypeCapsule::row_offset() const
+    {
+        return 0;
+    }
+
+    std::size_t
+    BitPackedGenotypeCapsule::col_offset() const
+    {
+        return 0;
+    }
+
+    std::size_t
+    BitPackedGenotypeCapsule::stride() const
+    {
+        return nsam_;
+    }
+
+    std::int8_t&
+    BitPackedGenotypeCapsule::operator()(std::size_t site, std::size_t sample)
+    {
+        convert_to_dense();
+        return dense[site * nsam_ + sample];
+    }
+
+    const std::int8_t&
+    BitPackedGenotypeCapsule::operator()(std::size_t site,
+                                         std::size_t sample) const
+    {
+        unpack();
+        return dense[site * nsam_ + sample];
+    }
+
+    std::int8_t*
+    BitPackedGenotypeCapsule::data()
+    {
+        convert_to_dense();
+        return dense.data();
+    }
+
+    const std::int8_t*
+    BitPackedGenotypeCapsule::data() const
+    {
+        unpack();
+        return dense.data();
+    }
+
+    const std::int8_t*
+    BitPackedGenotypeCapsule::cdata() const
+    {
+        unpack();
+        return dense.data();
+    }
+
+    std::unique_ptr<GenotypeCapsule>
+    BitPackedGenotypeCapsule::clone() const
+    {
+        if (!packed_)
+            {
+                return std::unique_ptr<GenotypeCapsule>(
+                    new VectorGenotypeCapsule(this->dense, this->nsites_));
+            }
+        return std::unique_ptr<GenotypeCapsule>(new BitPackedGenotypeCapsule(
+            this->alleles, this->missing, this->missing_index, this->nsites_,
+            this->nsam_));
+    }
+
+    std::int8_t*
+    BitPackedGenotypeCapsule::begin()
+    {
+        return data();
+    }
+
+    const std::int8_t*
+    BitPackedGenotypeCapsule::begin() const
+    {
+        return cdata();
+    }
+
+    std::int8_t*
+    BitPackedGenotypeCapsule::end()
+    {
+        return data() + nsites_ * nsam_;
+    }
+
+    const std::int8_t*
+    BitPackedGenotypeCapsule::end() const
+    {
+        return cdata() + nsites_ * nsam_;
+    }
+
+    const std::int8_t*
+    BitPackedGenotypeCapsule::cbegin() const
+    {
+        return begin();
+    }
+
+    const std::int8_t*
+    BitPackedGenotypeCapsule::cend() const
+    {
+        return end();
+    }
+
+    bool
+    BitPackedGenotypeCapsule::empty() const
+    {
+        return nsites_ * nsam_ == 0;
+    }
+
+    std::size_t
+    BitPackedGenotypeCapsule::size() const
+    {
+        return nsites_ * nsam_;
+    }
+
+    bool
+    BitPackedGenotypeCapsule::resizable() const
+    {
+        return true;
+    }
+
+    void
+    BitPackedGenotypeCapsule::resize(bool remove_sites)
+    {
+        // Masking data requires non-const access, which
+        // has already converted the capsule to dense storage.
+        convert_to_dense();
+        dense.erase(std::remove(std::begin(dense), std::end(dense),
+                                std::numeric_limits<std::int8_t>::min()),
+                    std::end(dense));
+        if (remove_sites)
+            {
+                nsites_ = (nsam_ > 0) ? dense.size() / nsam_ : 0;
+            }
+        else
+            {
+                nsam_ = (nsites_ > 0) ? dense.size() / nsites_ : 0;
+            }
+    }
+
+    std::unique_ptr<GenotypeCapsule>
+    make_genotype_capsule(std::vector<std::int8_t> data, std::size_t num_rows,
+                          std::int8_t max_allele)
+    {
+        if (max_allele < 0 && !data.empty())
+            {
+                max_allele = *std::max_element(data.begin(), data.end());
+            }
+        if (max_allele <= 1
+            && std::all_of(data.begin(), data.end(),
+                           [](const std::int8_t x) { return x >= -1; }))
+            {
+                return std::unique_ptr<GenotypeCapsule>(
+                    new BitPackedGenotypeCapsule(data, num_rows));
+            }
+        return std::unique_ptr<GenotypeCapsule>(
+            new VectorGenotypeCapsule(std::move(data), num_rows));
+    }
+
+    VariantMatrix
+    make_compact_VariantMatrix(std::vector<std::int8_t> data,
+                               std::vector<double> positions,
+                               std::int8_t max_allele)
+    {
+        if (max_allele < 0 && !data.empty())
+            {
+                max_allele = *std::max_element(data.begin(), data.end());
+            }
+        auto nsites = positions.size();
+        std::unique_ptr<PositionCapsule> pc(
+            new VectorPositionCapsule(std::move(positions)));
+        return VariantMatrix(
+            make_genotype_capsule(std::move(data), nsites, max_allele),
+            std::move(pc), max_allele);
+    }
+} // namespace Sequence
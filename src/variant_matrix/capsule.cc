@@ -160,6 +160,15 @@ namespace Sequence
             }
     }
 
+    std::vector<std::int8_t>
+    VectorGenotypeCapsule::release()
+    {
+        nsites_ = nsam_ = 0;
+        std::vector<std::int8_t> rv;
+        rv.swap(buffer);
+        return rv;
+    }
+
     // Position capsule based on std::vector here
     double& VectorPositionCapsule::operator[](std::size_t i)
     {
@@ -264,4 +273,13 @@ namespace Sequence
                            [this](double d) { return std::isnan(d); }),
             std::end(buffer));
     }
+
+    std::vector<double>
+    VectorPositionCapsule::release()
+    {
+        current_size = 0;
+        std::vector<double> rv;
+        rv.swap(buffer);
+        return rv;
+    }
 } // namespace Sequence
@@ -81,6 +81,7 @@ namespace Sequence
                             }
                     }
                 VariantMatrix v(std::move(newdata), std::move(newpos));
+                v.set_haplotype_cache(m.haplotype_cache_enabled());
                 swap(m, v);
             }
         return rv;
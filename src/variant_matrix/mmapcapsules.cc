@@ -0,0 +1,391 @@
+#include <Sequence/MmapCapsules.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/variant_matrix/mmapformat.hpp>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include "../read_only_mapping.hpp"
+
+namespace
+{
+    void
+    raise()
+    {
+        throw std::runtime_error("data are read-only");
+    }
+
+    const char magic[8] = { 'L', 'I', 'B', 'S', 'E', 'Q', 'V', 'M' };
+    const std::uint32_t format_version = 1;
+    constexpr std::size_t header_size = 32;
+
+    struct header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::int8_t max_allele;
+        char padding[3];
+        std::uint64_t nsites, nsam;
+    };
+
+    static_assert(sizeof(header) == header_size,
+                  "unexpected padding in matrix file header");
+} // namespace
+
+namespace Sequence
+{
+    namespace internal
+    {
+        class mapped_matrix_file
+        {
+          private:
+            read_only_mapping mapping;
+
+          public:
+            std::size_t nsites, nsam;
+            std::int8_t max_allele;
+            const double* positions;
+            const std::int8_t* genotypes;
+
+            explicit mapped_matrix_file(const std::string& filename)
+                : mapping(filename), nsites(0), nsam(0), max_allele(0),
+                  positions(nullptr), genotypes(nullptr)
+            {
+                if (mapping.size < header_size)
+                    {
+                        throw std::runtime_error(
+                            filename + " is not a matrix file");
+                    }
+                header h;
+                std::memcpy(&h, mapping.data, header_size);
+                if (std::memcmp(h.magic, magic, sizeof(magic)) != 0
+                    || h.version != format_version)
+                    {
+                        throw std::runtime_error(
+                            filename
+                            + " is not a matrix file, has an unsupported "
+                              "version, or has a different byte order");
+                    }
+                nsites = static_cast<std::size_t>(h.nsites);
+                nsam = static_cast<std::size_t>(h.nsam);
+                max_allele = h.max_allele;
+                // The size is checked by division, as a damaged
+                // header could make nsites * nsam overflow.
+                const std::size_t body = mapping.size - header_size;
+                const bool size_ok
+                    = (nsites == 0)
+                          ? body == 0
+                          : (nsam <= std::numeric_limits<std::size_t>::max()
+                                         - sizeof(double)
+                             && body % nsites == 0
+                             && body / nsites == sizeof(double) + nsam);
+                if (h.nsites != nsites || h.nsam != nsam || !size_ok)
+                    {
+                        throw std::runtime_error(filename
+                                                 + " has incorrect size");
+                    }
+                positions = reinterpret_cast<const double*>(mapping.data
+                                                            + header_size);
+                genotypes = reinterpret_cast<const std::int8_t*>(
+                    mapping.data + header_size + nsites * sizeof(double));
+            }
+        };
+    } // namespace internal
+
+    MappedMatrixFile
+    map_matrix_file(const std::string& filename)
+    {
+        return MappedMatrixFile(new internal::mapped_matrix_file(filename));
+    }
+
+    MmapGenotypeCapsule::MmapGenotypeCapsule(MappedMatrixFile f)
+        : file(std::move(f)), buffer(file->genotypes), nsites_(file->nsites),
+          nsam_(file->nsam)
+    {
+    }
+
+    std::size_t&
+    MmapGenotypeCapsule::nsites()
+    {
+        return nsites_;
+    }
+
+    std::size_t&
+    MmapGenotypeCapsule::nsam()
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    MmapGenotypeCapsule::nsites() const
+    {
+        return nsites_;
+    }
+
+    std::size_t
+    MmapGenotypeCapsule::nsam() const
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    MmapGenotypeCapsule::row_offset() const
+    {
+        return 0;
+    }
+
+    std::size_t
+    MmapGenotypeCapsule::col_offset() const
+    {
+        return 0;
+    }
+
+    std::size_t
+    MmapGenotypeCapsule::stride() const
+    {
+        return nsam_;
+    }
+
+    std::int8_t&
+    MmapGenotypeCapsule::operator()(std::size_t site, std::size_t sample)
+    {
+        raise();
+        return *const_cast<std::int8_t*>(&buffer[site * nsam_ + sample]);
+    }
+
+    const std::int8_t&
+    MmapGenotypeCapsule::operator()(std::size_t site, std::size_t sample) const
+    {
+        return buffer[site * nsam_ + sample];
+    }
+
+    std::int8_t*
+    MmapGenotypeCapsule::data()
+    {
+        raise();
+        return const_cast<std::int8_t*>(buffer);
+    }
+
+    const std::int8_t*
+    MmapGenotypeCapsule::data() const
+    {
+        return buffer;
+    }
+
+    const std::int8_t*
+    MmapGenotypeCapsule::cdata() const
+    {
+        return buffer;
+    }
+
+    std::unique_ptr<GenotypeCapsule>
+    MmapGenotypeCapsule::clone() const
+    {
+        return std::unique_ptr<GenotypeCapsule>(
+            new MmapGenotypeCapsule(file));
+    }
+
+    std::int8_t*
+    MmapGenotypeCapsule::begin()
+    {
+        raise();
+        return const_cast<std::int8_t*>(buffer);
+    }
+
+    const std::int8_t*
+    MmapGenotypeCapsule::begin() const
+    {
+        return buffer;
+    }
+
+    std::int8_t*
+    MmapGenotypeCapsule::end()
+    {
+        raise();
+        return const_cast<std::int8_t*>(buffer) + nsam_ * nsites_;
+    }
+
+    const std::int8_t*
+    MmapGenotypeCapsule::end() const
+    {
+        return buffer + nsam_ * nsites_;
+    }
+
+    const std::int8_t*
+    MmapGenotypeCapsule::cbegin() const
+    {
+        return cdata();
+    }
+
+    const std::int8_t*
+    MmapGenotypeCapsule::cend() const
+    {
+        return cdata() + nsam_ * nsites_;
+    }
+
+    bool
+    MmapGenotypeCapsule::empty() const
+    {
+        return nsam_ == 0 || nsites_ == 0;
+    }
+
+    std::size_t
+    MmapGenotypeCapsule::size() const
+    {
+        return nsam_ * nsites_;
+    }
+
+    bool
+    MmapGenotypeCapsule::resizable() const
+    {
+        return false;
+    }
+
+    MmapPositionCapsule::MmapPositionCapsule(MappedMatrixFile f)
+        : file(std::move(f)), buffer(file->positions),
+          current_size(file->nsites)
+    {
+    }
+
+    double& MmapPositionCapsule::operator[](std::size_t i)
+    {
+        raise();
+        return *const_cast<double*>(&buffer[i]);
+    }
+
+    const double& MmapPositionCapsule::operator[](std::size_t i) const
+    {
+        return buffer[i];
+    }
+
+    double*
+    MmapPositionCapsule::data()
+    {
+        raise();
+        return const_cast<double*>(buffer);
+    }
+
+    const double*
+    MmapPositionCapsule::data() const
+    {
+        return buffer;
+    }
+
+    const double*
+    MmapPositionCapsule::cdata() const
+    {
+        return buffer;
+    }
+
+    std::unique_ptr<PositionCapsule>
+    MmapPositionCapsule::clone() const
+    {
+        return std::unique_ptr<PositionCapsule>(
+            new MmapPositionCapsule(file));
+    }
+
+    double*
+    MmapPositionCapsule::begin()
+    {
+        raise();
+        return const_cast<double*>(buffer);
+    }
+
+    const double*
+    MmapPositionCapsule::begin() const
+    {
+        return buffer;
+    }
+
+    double*
+    MmapPositionCapsule::end()
+    {
+        raise();
+        return const_cast<double*>(buffer) + current_size;
+    }
+
+    const double*
+    MmapPositionCapsule::end() const
+    {
+        return buffer + current_size;
+    }
+
+    const double*
+    MmapPositionCapsule::cbegin() const
+    {
+        return cdata();
+    }
+
+    const double*
+    MmapPositionCapsule::cend() const
+    {
+        return cdata() + current_size;
+    }
+
+    bool
+    MmapPositionCapsule::empty() const
+    {
+        return current_size == 0;
+    }
+
+    std::size_t
+    MmapPositionCapsule::size() const
+    {
+        return current_size;
+    }
+
+    std::size_t
+    MmapPositionCapsule::nsites() const
+    {
+        return current_size;
+    }
+
+    bool
+    MmapPositionCapsule::resizable() const
+    {
+        return false;
+    }
+
+    void
+    to_mmapformat(const VariantMatrix& m, const std::string& filename)
+    {
+        std::ofstream out(filename, std::ios_base::binary);
+        if (!out)
+            {
+                throw std::runtime_error("could not open " + filename);
+            }
+        header h;
+        std::memcpy(h.magic, magic, sizeof(magic));
+        h.version = format_version;
+        h.max_allele = m.max_allele();
+        std::memset(h.padding, 0, sizeof(h.padding));
+        h.nsites = m.nsites();
+        h.nsam = m.nsam();
+        out.write(reinterpret_cast<const char*>(&h), header_size);
+        out.write(reinterpret_cast<const char*>(m.cpbegin()),
+                  static_cast<std::streamsize>(m.nsites() * sizeof(double)));
+        // Rows are written one at a time, as m may
+        // be a window into a larger matrix.
+        for (std::size_t i = 0; i < m.nsites(); ++i)
+            {
+                auto r = get_ConstRowView(m, i);
+                out.write(reinterpret_cast<const char*>(r.cbegin()),
+                          static_cast<std::streamsize>(r.size()));
+            }
+        if (!out)
+            {
+                throw std::runtime_error("error writing to " + filename);
+            }
+    }
+
+    VariantMatrix
+    from_mmapformat(const std::string& filename)
+    {
+        auto f = map_matrix_file(filename);
+        auto max_allele = f->max_allele;
+        std::unique_ptr<GenotypeCapsule> gc(new MmapGenotypeCapsule(f));
+        std::unique_ptr<PositionCapsule> pc(
+            new MmapPositionCapsule(std::move(f)));
+        return VariantMatrix(std::move(gc), std::move(pc), max_allele);
+    }
+} // namespace Sequence
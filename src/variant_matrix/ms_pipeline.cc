@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <Sequence/AlleleCountMatrix.hpp>
+#include <Sequence/variant_matrix/msformat.hpp>
+#include <Sequence/variant_matrix/ms_pipeline.hpp>
+
+namespace
+{
+    struct pipeline_slot
+    // A replicate in the queue.  The matrix is reused
+    // for every replicate that passes through the slot.
+    {
+        Sequence::VariantMatrix m;
+        std::function<void(std::size_t)> result;
+        bool done;
+        pipeline_slot()
+            : m(std::vector<std::int8_t>{}, std::vector<double>{}),
+              result{}, done(false)
+        {
+        }
+    };
+
+    class ms_pipeline
+    {
+      private:
+        const Sequence::internal::ms_pipeline_task& task;
+        std::vector<pipeline_slot> slots;
+        std::vector<std::thread> workers;
+        // Indexes of slots waiting for a worker
+        std::deque<std::size_t> waiting;
+        std::mutex mutex;
+        std::condition_variable work_cv, done_cv;
+        std::exception_ptr error;
+        bool stopping;
+
+        void
+        work()
+        {
+            for (;;)
+                {
+                    std::size_t slot;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        work_cv.wait(lock, [this]() {
+                            return stopping || !waiting.empty();
+                        });
+                        if (stopping)
+                            {
+                                return;
+                            }
+                        slot = waiting.front();
+                        waiting.pop_front();
+                    }
+                    std::function<void(std::size_t)> result;
+                    std::exception_ptr e;
+                    try
+                        {
+                            result = task(slots[slot].m);
+                        }
+                    catch (...)
+                        {
+                            e = std::current_exception();
+                        }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        slots[slot].result = std::move(result);
+                        slots[slot].done = true;
+                        if (e && !error)
+                            {
+                                error = e;
+                            }
+                    }
+                    done_cv.notify_one();
+                }
+        }
+
+      public:
+        ms_pipeline(const Sequence::internal::ms_pipeline_task& task_,
+                    const unsigned nthreads, const std::size_t depth)
+            : task(task_), slots(depth), workers{}, waiting{}, mutex{},
+              work_cv{}, done_cv{}, error{}, stopping(false)
+        {
+            workers.reserve(nthreads);
+            for (unsigned i = 0; i < nthreads; ++i)
+                {
+                    workers.emplace_back(&ms_pipeline::work, this);
+                }
+        }
+
+        ~ms_pipeline()
+        // Workers finish their current replicate,
+        // and any still waiting are abandoned.
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            work_cv.notify_all();
+            for (auto& w : workers)
+                {
+                    w.join();
+                }
+        }
+
+        std::size_t
+        run(std::istream& input)
+        {
+            Sequence::MsFormatReader reader(input);
+            const std::size_t depth = slots.size();
+            std::size_t nread = 0, nemitted = 0;
+            bool exhausted = false;
+            while (!exhausted || nemitted < nread)
+                {
+                    if (!exhausted && nread - nemitted < depth)
+                        {
+                            // The slot is free, as its previous
+                            // replicate has been passed on.
+                            auto& slot = slots[nread % depth];
+                            if (!reader.next(slot.m))
+                                {
+                                    exhausted = true;
+                                }
+                            else
+                                {
+                                    {
+                                        std::lock_guard<std::mutex> lock(
+                                            mutex);
+                                        slot.done = false;
+                                        waiting.push_back(nread % depth);
+                                    }
+                                    work_cv.notify_one();
+                                    ++nread;
+                                }
+                        }
+                    // Pass on finished results in order.  Only wait
+                    // if no more replicates may be read.
+                    const bool must_wait
+                        = exhausted || nread - nemitted == depth;
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (must_wait && nemitted < nread)
+                        {
+                            done_cv.wait(lock, [&]() {
+                                return error || slots[nemitted % depth].done;
+                            });
+                        }
+                    while (!error && nemitted < nread
+                           && slots[nemitted % depth].done)
+                        {
+                            auto result
+                                = std::move(slots[nemitted % depth].result);
+                            slots[nemitted % depth].done = false;
+                            lock.unlock();
+                            result(nemitted);
+                            ++nemitted;
+                            lock.lock();
+                        }
+                    if (error)
+                        {
+                            std::rethrow_exception(error);
+                        }
+                }
+            return nread;
+        }
+    };
+} // namespace
+
+namespace Sequence
+{
+    namespace internal
+    {
+        std::size_t
+        run_ms_pipeline(std::istream& input, const ms_pipeline_task& task,
+                        unsigned nthreads, std::size_t queue_depth)
+        {
+            if (nthreads == 0)
+                {
+                    nthreads
+                        = std::max(1u, std::thread::hardware_concurrency());
+                }
+            if (queue_depth == 0)
+                {
+                    queue_depth = 2 * static_cast<std::size_t>(nthreads);
+                }
+            ms_pipeline pipeline(task, nthreads, queue_depth);
+            return pipeline.run(input);
+        }
+
+        std::size_t
+        run_ms_pipeline(std::istream& input, const ms_pipeline_task& task,
+                        const Executor& executor, const std::size_t batch_size)
+        {
+            if (batch_size == 0)
+                {
+                    throw std::invalid_argument(
+                        "batch size must be positive");
+                }
+            MsFormatReader reader(input);
+            // While one batch is analyzed, the next is read into the other
+            std::vector<pipeline_slot> batches[2]
+                = { std::vector<pipeline_slot>(batch_size),
+                    std::vector<pipeline_slot>(batch_size) };
+            std::size_t nfilled[2] = { 0, 0 };
+            const auto fill = [&reader](std::vector<pipeline_slot>& batch) {
+                std::size_t n = 0;
+                while (n < batch.size() && reader.next(batch[n].m))
+                    {
+                        ++n;
+                    }
+                return n;
+            };
+            nfilled[0] = fill(batches[0]);
+            std::size_t nemitted = 0;
+            for (std::size_t current = 0; nfilled[current];
+                 current = 1 - current)
+                {
+                    auto& batch = batches[current];
+                    const auto next = 1 - current;
+                    std::vector<std::function<void()>> tasks;
+                    tasks.emplace_back([&fill, &batches, &nfilled, next]() {
+                        nfilled[next] = fill(batches[next]);
+                    });
+                    for (std::size_t i = 0; i < nfilled[current]; ++i)
+                        {
+                            tasks.emplace_back([&task, &batch, i]() {
+                                batch[i].result = task(batch[i].m);
+                            });
+                        }
+                    run_tasks(executor, tasks);
+                    for (std::size_t i = 0; i < nfilled[current]; ++i)
+                        {
+                            auto result = std::move(batch[i].result);
+                            batch[i].result = nullptr;
+                            result(nemitted++);
+                        }
+                }
+            return nemitted;
+        }
+    } // namespace internal
+
+    std::vector<ClassicSummaryStatistics>
+    msformat_classic_summstats(std::istream& input,
+                               const std::int8_t refstate,
+                               const unsigned nthreads,
+                               const std::size_t queue_depth)
+    {
+        std::vector<ClassicSummaryStatistics> rv;
+        analyze_msformat(
+            input,
+            [refstate](const VariantMatrix& m) {
+                return classic_summstats(AlleleCountMatrix(m), refstate);
+            },
+            [&rv](std::size_t, ClassicSummaryStatistics&& s) {
+                rv.push_back(s);
+            },
+            nthreads, queue_depth);
+        return rv;
+    }
+} // namespace Sequence
@@ -0,0 +1,616 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <locale>
+#include <stdexcept>
+#include <string>
+#include <Sequence/variant_matrix/msformat.hpp>
+
+namespace
+{
+    // Number of genotype lines written
+    // into the matrix at once
+    constexpr std::size_t lines_per_block = 64;
+
+    inline bool
+    starts_with(const std::string& s, const char* prefix)
+    {
+        return s.compare(0, std::strlen(prefix), prefix) == 0;
+    }
+
+    void
+    change_row_length(std::vector<std::int8_t>& data,
+                      const std::size_t nsites, const std::size_t from,
+                      const std::size_t to, const std::size_t nsam)
+    // Move the first nsam elements of each row of a
+    // row-major matrix from rows of length "from" to
+    // rows of length "to".
+    {
+        if (to > from)
+            {
+                data.resize(nsites * to);
+                for (std::size_t s = nsites; s > 0; --s)
+                    {
+                        std::memmove(data.data() + (s - 1) * to,
+                                     data.data() + (s - 1) * from, nsam);
+                    }
+            }
+        else
+            {
+                for (std::size_t s = 0; s < nsites; ++s)
+                    {
+                        std::memmove(data.data() + s * to,
+                                     data.data() + s * from, nsam);
+                    }
+                data.resize(nsites * to);
+            }
+    }
+
+    std::int8_t
+    write_block(const std::vector<char>& block, const std::size_t nlines,
+                const std::size_t nsites, const std::size_t row_length,
+                const std::size_t first_sample, std::int8_t* data)
+    // Write nlines genotype lines, for samples starting at
+    // first_sample, so that each site gets a contiguous run of
+    // nlines values.  Returns the largest allele.
+    {
+        unsigned max_allele = 0;
+        for (std::size_t s = 0; s < nsites; ++s)
+            {
+                auto out = data + s * row_length + first_sample;
+                for (std::size_t i = 0; i < nlines; ++i)
+                    {
+                        const unsigned x
+                            = static_cast<unsigned char>(block[i * nsites + s])
+                              - static_cast<unsigned>('0');
+                        if (x > 9)
+                            {
+                                throw std::runtime_error(
+                                    "invalid character in ms-format "
+                                    "genotypes");
+                            }
+                        out[i] = static_cast<std::int8_t>(x);
+                        max_allele = std::max(max_allele, x);
+                    }
+            }
+        return static_cast<std::int8_t>(max_allele);
+    }
+
+    // Buffered output is passed to the stream once it reaches this size
+    constexpr std::size_t flush_size = 1 << 20;
+
+    const double powers_of_ten[]
+        = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8, 1e9,
+            1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17 };
+    constexpr int max_digits = 17;
+
+    void
+    flush(std::ostream& o, std::vector<char>& buffer)
+    {
+        o.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+    bool
+    round_scaled(const double x, const int decimals, std::uint64_t& n)
+    // Round x * 10^decimals to the nearest integer.  x * 10^decimals
+    // may be off by half a unit in the last place, so false is
+    // returned for values near a tie, where printf, which rounds the
+    // exact binary value, could round the other way.
+    {
+        if (decimals < 0 || decimals > max_digits)
+            {
+                return false;
+            }
+        const double scaled = x * powers_of_ten[decimals];
+        // 2^52, beyond which scaled has no fractional part
+        if (!(scaled < 4503599627370496.0))
+            {
+                return false;
+            }
+        const double whole = std::floor(scaled);
+        const double fraction = scaled - whole;
+        if (std::abs(fraction - 0.5) <= scaled * 4e-16)
+            {
+                return false;
+            }
+        n = static_cast<std::uint64_t>(whole) + (fraction > 0.5);
+        return true;
+    }
+
+    void
+    append_fixed(std::uint64_t n, const int decimals, const bool trim,
+                 std::vector<char>& buffer)
+    // Append n / 10^decimals with the given number of decimals.  If
+    // trim is true, trailing zeros, and a trailing decimal point,
+    // are removed, as by the %g format of printf.
+    {
+        char digits[2 * max_digits + 2];
+        int len = 0;
+        do
+            {
+                digits[len++] = static_cast<char>('0' + n % 10);
+                n /= 10;
+            }
+        while (n);
+        while (len <= decimals)
+            {
+                digits[len++] = '0';
+            }
+        int last = 0;
+        if (trim)
+            {
+                while (last < decimals && digits[last] == '0')
+                    {
+                        ++last;
+                    }
+            }
+        for (int i = len - 1; i >= decimals; --i)
+            {
+                buffer.push_back(digits[i]);
+            }
+        if (last < decimals)
+            {
+                buffer.push_back('.');
+                for (int i = decimals - 1; i >= last; --i)
+                    {
+                        buffer.push_back(digits[i]);
+                    }
+            }
+    }
+
+    bool
+    format_fixed(const double x, const int precision,
+                 std::vector<char>& buffer)
+    // As printf's %.*f, for non-negative x
+    {
+        std::uint64_t n;
+        if (!(x >= 0.0) || std::signbit(x) || !round_scaled(x, precision, n))
+            {
+                return false;
+            }
+        append_fixed(n, precision, false, buffer);
+        return true;
+    }
+
+    bool
+    format_general(const double x, int precision, std::vector<char>& buffer)
+    // As printf's %.*g, for non-negative x that do not
+    // need an exponent.
+    {
+        if (std::signbit(x) || !(x >= 0.0))
+            {
+                return false;
+            }
+        if (x == 0.0)
+            {
+                buffer.push_back('0');
+                return true;
+            }
+        if (precision == 0)
+            {
+                precision = 1;
+            }
+        // %g uses the exponent that x has after rounding to precision
+        // significant digits, and an exponent is written unless it is
+        // from -4 to precision - 1.
+        if (!(x >= 1e-5) || !(x < 1e17) || precision > max_digits)
+            {
+                return false;
+            }
+        int exponent = static_cast<int>(std::floor(std::log10(x)));
+        for (int attempt = 0; attempt < 3; ++attempt)
+            {
+                if (exponent < -4 || exponent >= precision)
+                    {
+                        return false;
+                    }
+                const int decimals = precision - 1 - exponent;
+                std::uint64_t n;
+                if (!round_scaled(x, decimals, n))
+                    {
+                        return false;
+                    }
+                if (n >= static_cast<std::uint64_t>(
+                        powers_of_ten[precision]))
+                    {
+                        ++exponent;
+                    }
+                else if (n < static_cast<std::uint64_t>(
+                             powers_of_ten[precision - 1]))
+                    {
+                        --exponent;
+                    }
+                else
+                    {
+                        append_fixed(n, decimals, true, buffer);
+                        return true;
+                    }
+            }
+        return false;
+    }
+
+    void
+    append_positions(const Sequence::VariantMatrix& m, std::ostream& o,
+                     std::vector<char>& buffer)
+    {
+        const auto flags = o.flags();
+        const auto floatfield = flags & std::ios_base::floatfield;
+        const auto& punct = std::use_facet<std::numpunct<char>>(o.getloc());
+        // Formats other than these are left to the stream
+        const bool fast
+            = (floatfield == std::ios_base::fmtflags()
+               || floatfield == std::ios_base::fixed)
+              && !(flags
+                   & (std::ios_base::showpoint | std::ios_base::showpos
+                      | std::ios_base::uppercase))
+              && punct.decimal_point() == '.' && punct.grouping().empty();
+        const bool fixed = floatfield == std::ios_base::fixed;
+        const auto precision = static_cast<int>(o.precision());
+        for (auto p = m.cpbegin(); p < m.cpend(); ++p)
+            {
+                if (!fast
+                    || !(fixed ? format_fixed(*p, precision, buffer)
+                               : format_general(*p, precision, buffer)))
+                    {
+                        flush(o, buffer);
+                        o << *p;
+                    }
+                buffer.push_back(' ');
+                if (buffer.size() >= flush_size)
+                    {
+                        flush(o, buffer);
+                    }
+            }
+    }
+
+    void
+    append_haplotypes(const Sequence::VariantMatrix& m, std::ostream& o,
+                      std::vector<char>& buffer)
+    // Haplotypes are transposed out of the row-major genotypes in
+    // blocks, so that each row is read in runs of several values.
+    {
+        const auto nsites = m.nsites(), nsam = m.nsam();
+        if (nsam == 0)
+            {
+                return;
+            }
+        const bool cached = m.haplotype_cache_enabled();
+        const auto stride = m.genotype_stride();
+        const auto first
+            = cached ? m.haplotype_major_data()
+                     : m.cdata() + m.genotype_row_offset() * stride
+                           + m.genotype_col_offset();
+        // Alleles 0 through 9 give one character each, so that
+        // lines have a fixed length.
+        const auto single_digit = [](const std::int8_t g) {
+            return static_cast<unsigned char>(g) <= 9;
+        };
+        bool single_digits = true;
+        if (cached)
+            {
+                single_digits
+                    = std::all_of(first, first + nsites * nsam, single_digit);
+            }
+        else
+            {
+                for (std::size_t site = 0; site < nsites && single_digits;
+                     ++site)
+                    {
+                        const auto row = first + site * stride;
+                        single_digits
+                            = std::all_of(row, row + nsam, single_digit);
+                    }
+            }
+        if (!single_digits)
+            {
+                for (std::size_t i = 0; i < nsam; ++i)
+                    {
+                        auto col = Sequence::get_ConstColView(m, i);
+                        for (auto state : col)
+                            {
+                                const auto s = std::to_string(
+                                    static_cast<int>(state));
+                                buffer.insert(buffer.end(), s.begin(),
+                                              s.end());
+                            }
+                        if (i < nsam - 1)
+                            {
+                                buffer.push_back('\n');
+                            }
+                        if (buffer.size() >= flush_size)
+                            {
+                                flush(o, buffer);
+                            }
+                    }
+                return;
+            }
+        const auto line_length = nsites + 1;
+        for (std::size_t i = 0; i < nsam; i += lines_per_block)
+            {
+                const auto nlines = std::min(lines_per_block, nsam - i);
+                const auto start = buffer.size();
+                buffer.resize(start + nlines * line_length);
+                auto lines = buffer.data() + start;
+                if (cached)
+                    {
+                        for (std::size_t j = 0; j < nlines; ++j)
+                            {
+                                const auto h = first + (i + j) * nsites;
+                                auto line = lines + j * line_length;
+                                for (std::size_t site = 0; site < nsites;
+                                     ++site)
+                                    {
+                                        line[site]
+                                            = static_cast<char>('0' + h[site]);
+                                    }
+                            }
+                    }
+                else
+                    {
+                        for (std::size_t site = 0; site < nsites; ++site)
+                            {
+                                const auto row = first + site * stride + i;
+                                for (std::size_t j = 0; j < nlines; ++j)
+                                    {
+                                        lines[j * line_length + site]
+                                            = static_cast<char>('0' + row[j]);
+                                    }
+                            }
+                    }
+                for (std::size_t j = 0; j < nlines; ++j)
+                    {
+                        lines[j * line_length + nsites] = '\n';
+                    }
+                if (i + nlines == nsam)
+                    {
+                        // No newline after the last haplotype
+                        buffer.pop_back();
+                    }
+                if (buffer.size() >= flush_size)
+                    {
+                        flush(o, buffer);
+                    }
+            }
+    }
+
+    void
+    append_replicate(const Sequence::VariantMatrix& m, std::ostream& o,
+                     std::vector<char>& buffer)
+    {
+        const auto header
+            = "//\nsegsites: " + std::to_string(m.nsites()) + "\npositions: ";
+        buffer.insert(buffer.end(), header.begin(), header.end());
+        append_positions(m, o, buffer);
+        buffer.push_back('\n');
+        append_haplotypes(m, o, buffer);
+    }
+} // namespace
+
+namespace Sequence
+{
+    MsFormatReader::MsFormatReader(std::istream& input_stream)
+        : input(input_stream), line{}, block{}, nsam_hint(0), nreplicates_(0)
+    {
+    }
+
+    bool
+    MsFormatReader::read_line()
+    // Read a line, without its end-of-line characters.
+    // Returns false if there is no more input.
+    {
+        auto buffer = input.rdbuf();
+        line.clear();
+        auto c = buffer->sbumpc();
+        if (c == std::char_traits<char>::eof())
+            {
+                return false;
+            }
+        while (c != std::char_traits<char>::eof() && c != '\n')
+            {
+                line.push_back(static_cast<char>(c));
+                c = buffer->sbumpc();
+            }
+        if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+        return true;
+    }
+
+    void
+    MsFormatReader::skip_whitespace()
+    {
+        auto buffer = input.rdbuf();
+        auto c = buffer->sgetc();
+        while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            {
+                c = buffer->snextc();
+            }
+        if (c == std::char_traits<char>::eof())
+            {
+                input.setstate(std::ios_base::eofbit);
+            }
+    }
+
+    bool
+    MsFormatReader::next(VariantMatrix& m)
+    {
+        bool found = false;
+        while (!found && read_line())
+            {
+                found = starts_with(line, "//");
+            }
+        if (!found)
+            {
+                input.setstate(std::ios_base::eofbit);
+                return false;
+            }
+        while (true)
+            {
+                if (!read_line() || starts_with(line, "//"))
+                    {
+                        throw std::runtime_error(
+                            "ms-format replicate has no segsites line");
+                    }
+                if (starts_with(line, "segsites:"))
+                    {
+                        break;
+                    }
+            }
+        const char* p = line.c_str() + std::strlen("segsites:");
+        char* end;
+        const auto nsites
+            = static_cast<std::size_t>(std::strtoull(p, &end, 10));
+        if (end == p)
+            {
+                throw std::runtime_error("invalid ms-format segsites line");
+            }
+
+        std::vector<std::int8_t> data;
+        std::vector<double> positions;
+        const bool cache = m.haplotype_cache_enabled();
+        m.release(data, positions);
+        data.clear();
+        positions.clear();
+        if (nsites)
+            {
+                if (!read_line() || !starts_with(line, "positions:"))
+                    {
+                        throw std::runtime_error(
+                            "ms-format replicate has no positions line");
+                    }
+                p = line.c_str() + std::strlen("positions:");
+                positions.reserve(nsites);
+                for (std::size_t i = 0; i < nsites; ++i)
+                    {
+                        const double x = std::strtod(p, &end);
+                        if (end == p)
+                            {
+                                throw std::runtime_error(
+                                    "too few ms-format positions");
+                            }
+                        positions.push_back(x);
+                        p = end;
+                    }
+            }
+
+        // Each genotype line is one sample, and is written into
+        // rows of length row_length, which is the sample size of
+        // the previous replicate, and is changed if it is wrong.
+        auto buffer = input.rdbuf();
+        const auto eof = std::char_traits<char>::eof();
+        std::size_t row_length = nsam_hint ? nsam_hint : lines_per_block;
+        std::size_t nsam = 0, nlines = 0;
+        std::int8_t max_allele = 0;
+        block.resize(lines_per_block * nsites);
+        data.resize(nsites * row_length);
+        const auto flush = [&]() {
+            if (nsam + nlines > row_length)
+                {
+                    const auto length
+                        = std::max(2 * row_length, nsam + nlines);
+                    change_row_length(data, nsites, row_length, length, nsam);
+                    row_length = length;
+                }
+            max_allele = std::max(max_allele,
+                                  write_block(block, nlines, nsites,
+                                              row_length, nsam, data.data()));
+            nsam += nlines;
+            nlines = 0;
+        };
+        while (nsites)
+            {
+                const auto c = buffer->sgetc();
+                if (c == eof || c == '\n' || c == '\r' || c == '/')
+                    {
+                        break;
+                    }
+                auto n = buffer->sgetn(block.data() + nlines * nsites,
+                                       static_cast<std::streamsize>(nsites));
+                auto c2 = buffer->sbumpc();
+                if (c2 == '\r')
+                    {
+                        c2 = buffer->sbumpc();
+                    }
+                if (static_cast<std::size_t>(n) != nsites
+                    || (c2 != '\n' && c2 != eof))
+                    {
+                        throw std::runtime_error(
+                            "ms-format genotype line has the wrong length");
+                    }
+                if (++nlines == lines_per_block)
+                    {
+                        flush();
+                    }
+            }
+        flush();
+        if (nsites && !nsam)
+            {
+                throw std::runtime_error(
+                    "ms-format replicate has no genotypes");
+            }
+        if (nsam != row_length)
+            {
+                change_row_length(data, nsites, row_length, nsam, nsam);
+            }
+        if (nsam)
+            {
+                nsam_hint = nsam;
+            }
+
+        VariantMatrix rv(std::move(data), std::move(positions), max_allele);
+        rv.set_haplotype_cache(cache);
+        m.swap(rv);
+        ++nreplicates_;
+        skip_whitespace();
+        return true;
+    }
+
+    VariantMatrix
+    MsFormatReader::next()
+    {
+        VariantMatrix m(std::vector<std::int8_t>{}, std::vector<double>{});
+        if (!next(m))
+            {
+                throw std::runtime_error("no more ms-format replicates");
+            }
+        return m;
+    }
+
+    std::size_t
+    MsFormatReader::nreplicates() const
+    {
+        return nreplicates_;
+    }
+
+    MsFormatWriter::MsFormatWriter(std::ostream& output_stream)
+        : output(output_stream), buffer(), nreplicates_(0)
+    {
+    }
+
+    void
+    MsFormatWriter::write(const VariantMatrix& m)
+    {
+        append_replicate(m, output, buffer);
+        buffer.push_back('\n');
+        buffer.push_back('\n');
+        flush(output, buffer);
+        ++nreplicates_;
+    }
+
+    std::size_t
+    MsFormatWriter::nreplicates() const
+    {
+        return nreplicates_;
+    }
+
+    void
+    to_msformat(const VariantMatrix& m, std::ostream& o)
+    {
+        std::vector<char> buffer;
+        append_replicate(m, o, buffer);
+        flush(o, buffer);
+    }
+} // namespace Sequence
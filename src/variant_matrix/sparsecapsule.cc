@@ -0,0 +1,347 @@
+#include <Sequence/SparseCapsules.hpp>
+#include <Sequence/VectorCapsules.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace Sequence
+{
+    SparseGenotypeCapsule::SparseGenotypeCapsule(
+        const std::vector<std::int8_t>& data, std::size_t num_rows)
+        : row_ptr{}, col_index{}, values{}, dense{}, unpacked{}, nsites_(num_rows),
+          nsam_((num_rows > 0) ? data.size() / num_rows : 0), sparse_(true)
+    {
+        if (num_rows > 0 && data.size() % num_rows != 0)
+            {
+                throw std::invalid_argument("incorrect dimensions");
+            }
+        const auto nsam = nsam_;
+        fill([&data, nsam](const std::size_t site) {
+            return data.data() + site * nsam;
+        });
+    }
+
+    SparseGenotypeCapsule::SparseGenotypeCapsule(const VariantMatrix& m)
+        : row_ptr{}, col_index{}, values{}, dense{}, unpacked{}, nsites_(m.nsites()),
+          nsam_(m.nsam()), sparse_(true)
+    {
+        fill([&m](const std::size_t site) {
+            return get_ConstRowView(m, site).cbegin();
+        });
+    }
+
+    template <typename RowFunction>
+    void
+    SparseGenotypeCapsule::fill(const RowFunction& row)
+    {
+        if (nsam_ > std::numeric_limits<std::uint32_t>::max())
+            {
+                throw std::invalid_argument(
+                    "too many samples for SparseGenotypeCapsule");
+            }
+        row_ptr.reserve(nsites_ + 1);
+        row_ptr.push_back(0);
+        for (std::size_t site = 0; site < nsites_; ++site)
+            {
+                const std::int8_t* r = row(site);
+                for (std::size_t sample = 0; sample < nsam_; ++sample)
+                    {
+                        if (r[sample] != 0)
+                            {
+                                col_index.push_back(
+                                    static_cast<std::uint32_t>(sample));
+                                values.push_back(r[sample]);
+                            }
+                    }
+                row_ptr.push_back(values.size());
+            }
+        col_index.shrink_to_fit();
+        values.shrink_to_fit();
+    }
+
+    void
+    SparseGenotypeCapsule::unpack() const
+    {
+        if (!sparse_)
+            {
+                return;
+            }
+        // Concurrent const access may get here from several threads.
+        std::call_once(unpacked, [this]() {
+            dense.assign(nsites_ * nsam_, 0);
+            for (std::size_t site = 0; site < nsites_; ++site)
+                {
+                    for (std::size_t k = row_ptr[site];
+                         k < row_ptr[site + 1]; ++k)
+                        {
+                            dense[site * nsam_ + col_index[k]] = values[k];
+                        }
+                }
+        });
+    }
+
+    void
+    SparseGenotypeCapsule::convert_to_dense()
+    {
+        if (!sparse_)
+            {
+                return;
+            }
+        unpack();
+        sparse_ = false;
+        std::vector<std::size_t>().swap(row_ptr);
+        std::vector<std::uint32_t>().swap(col_index);
+        std::vector<std::int8_t>().swap(values);
+    }
+
+    bool
+    SparseGenotypeCapsule::sparse() const
+    {
+        return sparse_;
+    }
+
+    std::size_t
+    SparseGenotypeCapsule::nnz() const
+    {
+        if (!sparse_)
+            {
+                return static_cast<std::size_t>(std::count_if(
+                    dense.begin(), dense.end(),
+                    [](const std::int8_t x) { return x != 0; }));
+            }
+        return values.size();
+    }
+
+    std::size_t
+    SparseGenotypeCapsule::nnz(std::size_t site) const
+    {
+        return row_ptr[site + 1] - row_ptr[site];
+    }
+
+    const std::uint32_t*
+    SparseGenotypeCapsule::samples(std::size_t site) const
+    {
+        return col_index.data() + row_ptr[site];
+    }
+
+    const std::int8_t*
+    SparseGenotypeCapsule::states(std::size_t site) const
+    {
+        return values.data() + row_ptr[site];
+    }
+
+    std::int8_t
+    SparseGenotypeCapsule::state(std::size_t site, std::size_t sample) const
+    {
+        if (!sparse_)
+            {
+                return dense[site * nsam_ + sample];
+            }
+        auto b = samples(site), e = b + nnz(site);
+        auto i = std::lower_bound(b, e, sample);
+        if (i == e || *i != sample)
+            {
+                return 0;
+            }
+        return values[row_ptr[site]
+                      + static_cast<std::size_t>(std::distance(b, i))];
+    }
+
+    std::size_t&
+    SparseGenotypeCapsule::nsites()
+    {
+        return nsites_;
+    }
+
+    std::size_t&
+    SparseGenotypeCapsule::nsam()
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    SparseGenotypeCapsule::nsites() const
+    {
+        return nsites_;
+    }
+
+    std::size_t
+    SparseGenotypeCapsule::nsam() const
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    SparseGenotypeCapsule::row_offset() const
+    {
+        return 0;
+    }
+
+    std::size_t
+    SparseGenotypeCapsule::col_offset() const
+    {
+        return 0;
+    }
+
+    std::size_t
+    SparseGenotypeCapsule::stride() const
+    {
+        return nsam_;
+    }
+
+    std::int8_t&
+    SparseGenotypeCapsule::operator()(std::size_t site, std::size_t sample)
+    {
+        convert_to_dense();
+        return dense[site * nsam_ + sample];
+    }
+
+    const std::int8_t&
+    SparseGenotypeCapsule::operator()(std::size_t site,
+                                      std::size_t sample) const
+    {
+        unpack();
+        return dense[site * nsam_ + sample];
+    }
+
+    std::int8_t*
+    SparseGenotypeCapsule::data()
+    {
+        convert_to_dense();
+        return dense.data();
+    }
+
+    const std::int8_t*
+    SparseGenotypeCapsule::data() const
+    {
+        unpack();
+        return dense.data();
+    }
+
+    const std::int8_t*
+    SparseGenotypeCapsule::cdata() const
+    {
+        unpack();
+        return dense.data();
+    }
+
+    std::unique_ptr<GenotypeCapsule>
+    SparseGenotypeCapsule::clone() const
+    {
+        if (!sparse_)
+            {
+                return std::unique_ptr<GenotypeCapsule>(
+                    new VectorGenotypeCapsule(this->dense, this->nsites_));
+            }
+        std::unique_ptr<SparseGenotypeCapsule> rv(
+            new SparseGenotypeCapsule(std::vector<std::int8_t>(), 0));
+        rv->row_ptr = this->row_ptr;
+        rv->col_index = this->col_index;
+        rv->values = this->values;
+        rv->nsites_ = this->nsites_;
+        rv->nsam_ = this->nsam_;
+        return std::unique_ptr<GenotypeCapsule>(rv.release());
+    }
+
+    std::int8_t*
+    SparseGenotypeCapsule::begin()
+    {
+        return data();
+    }
+
+    const std::int8_t*
+    SparseGenotypeCapsule::begin() const
+    {
+        return cdata();
+    }
+
+    std::int8_t*
+    SparseGenotypeCapsule::end()
+    {
+        return data() + nsites_ * nsam_;
+    }
+
+    const std::int8_t*
+    SparseGenotypeCapsule::end() const
+    {
+        return cdata() + nsites_ * nsam_;
+    }
+
+    const std::int8_t*
+    SparseGenotypeCapsule::cbegin() const
+    {
+        return begin();
+    }
+
+    const std::int8_t*
+    SparseGenotypeCapsule::cend() const
+    {
+        return end();
+    }
+
+    bool
+    SparseGenotypeCapsule::empty() const
+    {
+        return nsites_ * nsam_ == 0;
+    }
+
+    std::size_t
+    SparseGenotypeCapsule::size() const
+    {
+        return nsites_ * nsam_;
+    }
+
+    bool
+    SparseGenotypeCapsule::resizable() const
+    {
+        return true;
+    }
+
+    void
+    SparseGenotypeCapsule::resize(bool remove_sites)
+    {
+        // Masking data requires non-const access, which
+        // has already converted the capsule to dense storage.
+        convert_to_dense();
+        dense.erase(std::remove(std::begin(dense), std::end(dense),
+                                std::numeric_limits<std::int8_t>::min()),
+                    std::end(dense));
+        if (remove_sites)
+            {
+                nsites_ = (nsam_ > 0) ? dense.size() / nsam_ : 0;
+            }
+        else
+            {
+                nsam_ = (nsites_ > 0) ? dense.size() / nsites_ : 0;
+            }
+    }
+
+    VariantMatrix
+    make_sparse_VariantMatrix(const std::vector<std::int8_t>& data,
+                              std::vector<double> positions,
+                              std::int8_t max_allele)
+    {
+        if (max_allele < 0 && !data.empty())
+            {
+                max_allele = *std::max_element(data.begin(), data.end());
+            }
+        auto nsites = positions.size();
+        std::unique_ptr<PositionCapsule> pc(
+            new VectorPositionCapsule(std::move(positions)));
+        std::unique_ptr<GenotypeCapsule> gc(
+            new SparseGenotypeCapsule(data, nsites));
+        return VariantMatrix(std::move(gc), std::move(pc), max_allele);
+    }
+
+    VariantMatrix
+    make_sparse_VariantMatrix(const VariantMatrix& m)
+    {
+        std::unique_ptr<GenotypeCapsule> gc(new SparseGenotypeCapsule(m));
+        std::unique_ptr<PositionCapsule> pc(new VectorPositionCapsule(
+            std::vector<double>(m.cpbegin(), m.cpend())));
+        return VariantMatrix(std::move(gc), std::move(pc), m.max_allele());
+    }
+} // namespace Sequence
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <stdexcept>
+#include <Sequence/VariantMatrix.hpp>
+#include "state_count_kernels.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEQUENCE_X86_STATE_COUNTS
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Rows whose largest state is less than this are counted with
+    // one vector comparison per state.  Others use the scalar code.
+    constexpr std::int8_t max_vector_states = 8;
+
+    inline void
+    throw_mask()
+    {
+        throw std::invalid_argument("reserved value encountered");
+    }
+
+    // Counts for the elements that remain after
+    // the last full vector has been processed.
+    inline void
+    count_tail(const std::int8_t* row, const std::size_t i,
+               const std::size_t n, std::int32_t* c)
+    {
+        for (std::size_t j = i; j < n; ++j)
+            {
+                if (row[j] >= 0)
+                    {
+                        ++c[static_cast<std::size_t>(row[j])];
+                    }
+            }
+    }
+
+    // The largest value in the elements that remain
+    // after the last full vector has been processed.
+    inline std::int8_t
+    tail_max(const std::int8_t* row, const std::size_t i, const std::size_t n,
+             std::int8_t maxstate)
+    {
+        for (std::size_t j = i; j < n; ++j)
+            {
+                if (row[j] == Sequence::VariantMatrix::mask)
+                    {
+                        throw_mask();
+                    }
+                maxstate = std::max(maxstate, row[j]);
+            }
+        return maxstate;
+    }
+
+#ifdef SEQUENCE_X86_STATE_COUNTS
+#ifdef __SSE2__
+    std::int8_t
+    count_states_sse2(const std::int8_t* row, const std::size_t n,
+                      std::int32_t* counts, const std::size_t ncounts)
+    {
+        // SSE2 lacks signed byte max, so values are
+        // offset by 128 and compared as unsigned.
+        const __m128i bias = _mm_set1_epi8(-128);
+        const __m128i maskv = _mm_set1_epi8(Sequence::VariantMatrix::mask);
+        __m128i vmax = _mm_xor_si128(_mm_set1_epi8(-1), bias);
+        __m128i masked = _mm_setzero_si128();
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+            {
+                __m128i v = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(row + i));
+                vmax = _mm_max_epu8(vmax, _mm_xor_si128(v, bias));
+                masked = _mm_or_si128(masked, _mm_cmpeq_epi8(v, maskv));
+            }
+        if (_mm_movemask_epi8(masked))
+            {
+                throw_mask();
+            }
+        alignas(16) std::int8_t lanes[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes),
+                        _mm_xor_si128(vmax, bias));
+        auto maxstate = tail_max(row, i, n,
+                                 *std::max_element(lanes, lanes + 16));
+        if (maxstate < 0)
+            {
+                return -1;
+            }
+        if (maxstate >= max_vector_states
+            || static_cast<std::size_t>(maxstate) >= ncounts)
+            {
+                return Sequence::detail::count_states_scalar(row, n, counts,
+                                                             ncounts);
+            }
+        const auto nstates = static_cast<std::size_t>(maxstate) + 1;
+        __m128i states[max_vector_states];
+        std::int32_t c[max_vector_states] = { 0 };
+        for (std::size_t k = 0; k < nstates; ++k)
+            {
+                states[k] = _mm_set1_epi8(static_cast<char>(k));
+            }
+        for (i = 0; i + 16 <= n; i += 16)
+            {
+                __m128i v = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(row + i));
+                for (std::size_t k = 0; k < nstates; ++k)
+                    {
+                        c[k] += __builtin_popcount(static_cast<unsigned>(
+                            _mm_movemask_epi8(_mm_cmpeq_epi8(v, states[k]))));
+                    }
+            }
+        count_tail(row, i, n, c);
+        for (std::size_t k = 0; k < nstates; ++k)
+            {
+                counts[k] += c[k];
+            }
+        return maxstate;
+    }
+#endif
+
+    __attribute__((target("avx2,popcnt"))) std::int8_t
+    count_states_avx2(const std::int8_t* row, const std::size_t n,
+                      std::int32_t* counts, const std::size_t ncounts)
+    {
+        const __m256i maskv = _mm256_set1_epi8(Sequence::VariantMatrix::mask);
+        __m256i vmax = _mm256_set1_epi8(-1);
+        __m256i masked = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+            {
+                __m256i v = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(row + i));
+                vmax = _mm256_max_epi8(vmax, v);
+                masked = _mm256_or_si256(masked, _mm256_cmpeq_epi8(v, maskv));
+            }
+        if (!_mm256_testz_si256(masked, masked))
+            {
+                throw_mask();
+            }
+        alignas(32) std::int8_t lanes[32];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), vmax);
+        auto maxstate = tail_max(row, i, n,
+                                 *std::max_element(lanes, lanes + 32));
+        if (maxstate < 0)
+            {
+                return -1;
+            }
+        if (maxstate >= max_vector_states
+            || static_cast<std::size_t>(maxstate) >= ncounts)
+            {
+                return Sequence::detail::count_states_scalar(row, n, counts,
+                                                             ncounts);
+            }
+        const auto nstates = static_cast<std::size_t>(maxstate) + 1;
+        __m256i states[max_vector_states];
+        std::int32_t c[max_vector_states] = { 0 };
+        for (std::size_t k = 0; k < nstates; ++k)
+            {
+                states[k] = _mm256_set1_epi8(static_cast<char>(k));
+            }
+        for (i = 0; i + 32 <= n; i += 32)
+            {
+                __m256i v = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(row + i));
+                for (std::size_t k = 0; k < nstates; ++k)
+                    {
+                        c[k] += __builtin_popcount(
+                            static_cast<unsigned>(_mm256_movemask_epi8(
+                                _mm256_cmpeq_epi8(v, states[k]))));
+                    }
+            }
+        count_tail(row, i, n, c);
+        for (std::size_t k = 0; k < nstates; ++k)
+            {
+                counts[k] += c[k];
+            }
+        return maxstate;
+    }
+#endif
+
+    using kernel_type = std::int8_t (*)(const std::int8_t*, const std::size_t,
+                                        std::int32_t*, const std::size_t);
+
+    kernel_type
+    select_kernel()
+    {
+#ifdef SEQUENCE_X86_STATE_COUNTS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            {
+                return count_states_avx2;
+            }
+#ifdef __SSE2__
+        return count_states_sse2;
+#endif
+#endif
+        return Sequence::detail::count_states_scalar;
+    }
+} // namespace
+
+namespace Sequence
+{
+    namespace detail
+    {
+        std::int8_t
+        count_states_scalar(const std::int8_t* row, const std::size_t n,
+                            std::int32_t* counts, const std::size_t ncounts)
+        {
+            std::int8_t maxstate = -1;
+            for (std::size_t i = 0; i < n; ++i)
+                {
+                    auto x = row[i];
+                    if (x >= 0)
+                        {
+                            maxstate = std::max(maxstate, x);
+                            if (static_cast<std::size_t>(x) < ncounts)
+                                {
+                                    ++counts[static_cast<std::size_t>(x)];
+                                }
+                        }
+                    else if (x == VariantMatrix::mask)
+                        {
+                            throw_mask();
+                        }
+                }
+            return maxstate;
+        }
+
+        std::int8_t
+        count_states(const std::int8_t* row, const std::size_t n,
+                     std::int32_t* counts, const std::size_t ncounts)
+        {
+            static const kernel_type kernel = select_kernel();
+            return kernel(row, n, counts, ncounts);
+        }
+    } // namespace detail
+} // namespace Sequence
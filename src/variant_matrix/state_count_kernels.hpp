@@ -0,0 +1,35 @@
+#ifndef SEQUENCE_VARIANT_MATRIX_STATE_COUNT_KERNELS_HPP
+#define SEQUENCE_VARIANT_MATRIX_STATE_COUNT_KERNELS_HPP
+
+// These functions are not exported.
+// They are used internally.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Sequence
+{
+    namespace detail
+    {
+        // Add the number of occurrences of each state in
+        // row[0, n) to counts[0, ncounts).  States >= ncounts
+        // are not counted.  Returns the largest non-missing
+        // state in the row, or -1 if all data are missing.
+        // std::invalid_argument is thrown if VariantMatrix::mask
+        // is encountered.
+        //
+        // The implementation is chosen at run time based on
+        // the instruction sets supported by the CPU.
+        std::int8_t count_states(const std::int8_t* row, const std::size_t n,
+                                 std::int32_t* counts,
+                                 const std::size_t ncounts);
+
+        // The portable implementation of count_states.
+        std::int8_t count_states_scalar(const std::int8_t* row,
+                                        const std::size_t n,
+                                        std::int32_t* counts,
+                                        const std::size_t ncounts);
+    } // namespace detail
+} // namespace Sequence
+
+#endif
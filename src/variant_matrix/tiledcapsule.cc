@@ -0,0 +1,615 @@
+#include <Sequence/TiledCapsules.hpp>
+#include <Sequence/VectorCapsules.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    struct close_file
+    {
+        void
+        operator()(std::FILE* f) const
+        {
+            if (f != nullptr)
+                {
+                    std::fclose(f);
+                }
+        }
+    };
+} // namespace
+
+namespace Sequence
+{
+    constexpr std::size_t TiledGenotypeCapsule::default_block_sites;
+    constexpr std::size_t TiledGenotypeCapsule::default_block_samples;
+
+    TiledGenotypeCapsule::TiledGenotypeCapsule(
+        std::size_t nsites, std::size_t nsam, std::size_t block_sites,
+        std::size_t block_samples, std::size_t max_resident_blocks)
+        : tiles{}, dense{}, unpacked{}, nsites_(nsites), nsam_(nsam),
+          block_sites_(block_sites), block_samples_(block_samples),
+          site_blocks_(0), sample_blocks_(0),
+          max_resident_(max_resident_blocks), nresident(0), clock(0),
+          spill(nullptr), tiled_(true)
+    {
+        if (block_sites_ == 0 || block_samples_ == 0)
+            {
+                throw std::invalid_argument(
+                    "block dimensions must be greater than zero");
+            }
+        if (nsites_ > 0 && nsam_ > 0)
+            {
+                site_blocks_ = (nsites_ + block_sites_ - 1) / block_sites_;
+                sample_blocks_ = (nsam_ + block_samples_ - 1) / block_samples_;
+            }
+        tiles.resize(site_blocks_ * sample_blocks_);
+        for (std::size_t i = 0; i < tiles.size(); ++i)
+            {
+                auto sb = i / sample_blocks_, cb = i % sample_blocks_;
+                tiles[i].nsites
+                    = std::min(block_sites_, nsites_ - sb * block_sites_);
+                tiles[i].nsam
+                    = std::min(block_samples_, nsam_ - cb * block_samples_);
+                tiles[i].last_use = 0;
+                tiles[i].spilled = false;
+            }
+    }
+
+    TiledGenotypeCapsule::TiledGenotypeCapsule(
+        const std::vector<std::int8_t>& data, std::size_t num_rows,
+        std::size_t block_sites, std::size_t block_samples,
+        std::size_t max_resident_blocks)
+        : TiledGenotypeCapsule(num_rows,
+                               (num_rows > 0) ? data.size() / num_rows : 0,
+                               block_sites, block_samples,
+                               max_resident_blocks)
+    {
+        if (num_rows > 0 && data.size() % num_rows != 0)
+            {
+                throw std::invalid_argument("incorrect dimensions");
+            }
+        const auto nsam = nsam_;
+        fill([&data, nsam](const std::size_t site) {
+            return data.data() + site * nsam;
+        });
+    }
+
+    TiledGenotypeCapsule::TiledGenotypeCapsule(
+        const VariantMatrix& m, std::size_t block_sites,
+        std::size_t block_samples, std::size_t max_resident_blocks)
+        : TiledGenotypeCapsule(m.nsites(), m.nsam(), block_sites,
+                               block_samples, max_resident_blocks)
+    {
+        fill([&m](const std::size_t site) {
+            return get_ConstRowView(m, site).cbegin();
+        });
+    }
+
+    template <typename RowFunction>
+    void
+    TiledGenotypeCapsule::fill(const RowFunction& row)
+    // Tiles are filled one site block at a time,
+    // so that at most one site block needs to be
+    // in memory in addition to the resident tiles.
+    {
+        for (std::size_t sb = 0; sb < site_blocks_; ++sb)
+            {
+                auto first = tiles.begin() + static_cast<std::ptrdiff_t>(
+                                                 sb * sample_blocks_);
+                for (auto t = first;
+                     t < first + static_cast<std::ptrdiff_t>(sample_blocks_);
+                     ++t)
+                    {
+                        t->data.resize(t->nsites * t->nsam);
+                    }
+                for (std::size_t s = 0; s < first->nsites; ++s)
+                    {
+                        const std::int8_t* r = row(sb * block_sites_ + s);
+                        for (std::size_t cb = 0; cb < sample_blocks_; ++cb)
+                            {
+                                auto& t = tiles[sb * sample_blocks_ + cb];
+                                std::copy(r + cb * block_samples_,
+                                          r + cb * block_samples_ + t.nsam,
+                                          t.data.begin()
+                                              + static_cast<std::ptrdiff_t>(
+                                                  s * t.nsam));
+                            }
+                    }
+                for (auto t = first;
+                     t < first + static_cast<std::ptrdiff_t>(sample_blocks_);
+                     ++t)
+                    {
+                        t->last_use = ++clock;
+                        ++nresident;
+                    }
+                if (max_resident_ > 0)
+                    {
+                        evict_until(max_resident_);
+                    }
+            }
+    }
+
+    void
+    TiledGenotypeCapsule::evict_until(std::size_t n) const
+    {
+        const std::size_t tile_bytes = block_sites_ * block_samples_;
+        while (nresident > n)
+            {
+                std::size_t lru = tiles.size();
+                for (std::size_t i = 0; i < tiles.size(); ++i)
+                    {
+                        if (!tiles[i].data.empty()
+                            && (lru == tiles.size()
+                                || tiles[i].last_use < tiles[lru].last_use))
+                            {
+                                lru = i;
+                            }
+                    }
+                auto& t = tiles[lru];
+                // The data cannot change while the capsule is
+                // tiled, so a tile is only ever written once.
+                if (!t.spilled)
+                    {
+                        if (spill == nullptr)
+                            {
+                                spill = std::shared_ptr<std::FILE>(
+                                    std::tmpfile(), close_file());
+                                if (spill == nullptr)
+                                    {
+                                        throw std::runtime_error(
+                                            "could not create temporary file");
+                                    }
+                            }
+                        if (std::fseek(spill.get(),
+                                       static_cast<long>(lru * tile_bytes),
+                                       SEEK_SET)
+                                != 0
+                            || std::fwrite(t.data.data(), 1, t.data.size(),
+                                           spill.get())
+                                   != t.data.size())
+                            {
+                                throw std::runtime_error(
+                                    "error writing to temporary file");
+                            }
+                        t.spilled = true;
+                    }
+                std::vector<std::int8_t>().swap(t.data);
+                --nresident;
+            }
+    }
+
+    const TiledGenotypeCapsule::tile&
+    TiledGenotypeCapsule::load(std::size_t i) const
+    {
+        auto& t = tiles[i];
+        // Without a bound, all tiles are resident and there is
+        // nothing to record, so that const access writes nothing.
+        if (max_resident_ == 0 && !t.data.empty())
+            {
+                return t;
+            }
+        if (t.data.empty())
+            {
+                if (max_resident_ > 0)
+                    {
+                        evict_until(max_resident_ - 1);
+                    }
+                try
+                    {
+                        read_spilled(i, t.data);
+                    }
+                catch (...)
+                    {
+                        std::vector<std::int8_t>().swap(t.data);
+                        throw;
+                    }
+                ++nresident;
+            }
+        t.last_use = ++clock;
+        return t;
+    }
+
+    void
+    TiledGenotypeCapsule::read_spilled(std::size_t i,
+                                       std::vector<std::int8_t>& out) const
+    {
+        const std::size_t tile_bytes = block_sites_ * block_samples_;
+        out.resize(tiles[i].nsites * tiles[i].nsam);
+        if (std::fseek(spill.get(), static_cast<long>(i * tile_bytes),
+                       SEEK_SET)
+                != 0
+            || std::fread(out.data(), 1, out.size(), spill.get())
+                   != out.size())
+            {
+                throw std::runtime_error("error reading from temporary file");
+            }
+    }
+
+    void
+    TiledGenotypeCapsule::copy_region(const std::size_t first_site,
+                                      const std::size_t nsites,
+                                      const std::size_t first_sample,
+                                      const std::size_t nsam,
+                                      std::int8_t* out) const
+    {
+        if (first_site + nsites > nsites_ || first_sample + nsam > nsam_)
+            {
+                throw std::out_of_range("region out of range");
+            }
+        if (nsites == 0 || nsam == 0)
+            {
+                return;
+            }
+        const auto last_site = first_site + nsites,
+                   last_sample = first_sample + nsam;
+        for (auto sb = first_site / block_sites_;
+             sb <= (last_site - 1) / block_sites_; ++sb)
+            {
+                for (auto cb = first_sample / block_samples_;
+                     cb <= (last_sample - 1) / block_samples_; ++cb)
+                    {
+                        const auto b = block(sb * sample_blocks_ + cb);
+                        const auto s0 = std::max(first_site, b.first_site),
+                                   s1 = std::min(last_site,
+                                                 b.first_site + b.nsites);
+                        const auto c0 = std::max(first_sample, b.first_sample),
+                                   c1 = std::min(last_sample,
+                                                 b.first_sample + b.nsam);
+                        for (auto site = s0; site < s1; ++site)
+                            {
+                                auto row = b.data
+                                           + (site - b.first_site) * b.nsam;
+                                std::copy(row + (c0 - b.first_sample),
+                                          row + (c1 - b.first_sample),
+                                          out + (site - first_site) * nsam
+                                              + (c0 - first_sample));
+                            }
+                    }
+            }
+    }
+
+    void
+    TiledGenotypeCapsule::unpack() const
+    {
+        if (!tiled_)
+            {
+                return;
+            }
+        std::call_once(unpacked, [this]() {
+            dense.resize(nsites_ * nsam_);
+            for (std::size_t i = 0; i < tiles.size(); ++i)
+                {
+                    auto b = block(i);
+                    for (std::size_t s = 0; s < b.nsites; ++s)
+                        {
+                            std::copy(b.data + s * b.nsam,
+                                      b.data + (s + 1) * b.nsam,
+                                      dense.begin()
+                                          + static_cast<std::ptrdiff_t>(
+                                              (b.first_site + s) * nsam_
+                                              + b.first_sample));
+                        }
+                }
+        });
+    }
+
+    void
+    TiledGenotypeCapsule::convert_to_dense()
+    {
+        if (!tiled_)
+            {
+                return;
+            }
+        unpack();
+        tiled_ = false;
+        std::vector<tile>().swap(tiles);
+        nresident = 0;
+        spill.reset();
+    }
+
+    bool
+    TiledGenotypeCapsule::tiled() const
+    {
+        return tiled_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::block_sites() const
+    {
+        return block_sites_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::block_samples() const
+    {
+        return block_samples_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::site_blocks() const
+    {
+        return site_blocks_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::sample_blocks() const
+    {
+        return sample_blocks_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::nblocks() const
+    {
+        return site_blocks_ * sample_blocks_;
+    }
+
+    GenotypeBlock
+    TiledGenotypeCapsule::block(std::size_t i) const
+    {
+        if (!tiled_)
+            {
+                throw std::runtime_error(
+                    "capsule has been converted to dense storage");
+            }
+        if (i >= tiles.size())
+            {
+                throw std::out_of_range("block index out of range");
+            }
+        const auto& t = load(i);
+        GenotypeBlock b;
+        b.data = t.data.data();
+        b.first_site = (i / sample_blocks_) * block_sites_;
+        b.first_sample = (i % sample_blocks_) * block_samples_;
+        b.nsites = t.nsites;
+        b.nsam = t.nsam;
+        return b;
+    }
+
+    void
+    TiledGenotypeCapsule::set_max_resident_blocks(std::size_t n)
+    {
+        max_resident_ = n;
+        if (!tiled_)
+            {
+                return;
+            }
+        if (max_resident_ > 0)
+            {
+                evict_until(max_resident_);
+            }
+        else
+            {
+                // Without a bound, all tiles are kept resident
+                for (std::size_t i = 0; i < tiles.size(); ++i)
+                    {
+                        if (tiles[i].data.empty())
+                            {
+                                read_spilled(i, tiles[i].data);
+                                ++nresident;
+                            }
+                    }
+            }
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::max_resident_blocks() const
+    {
+        return max_resident_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::resident_blocks() const
+    {
+        return nresident;
+    }
+
+    TiledGenotypeCapsule::block_iterator
+    TiledGenotypeCapsule::blocks_begin() const
+    {
+        return block_iterator(this, 0);
+    }
+
+    TiledGenotypeCapsule::block_iterator
+    TiledGenotypeCapsule::blocks_end() const
+    {
+        return block_iterator(this, nblocks());
+    }
+
+    std::size_t&
+    TiledGenotypeCapsule::nsites()
+    {
+        return nsites_;
+    }
+
+    std::size_t&
+    TiledGenotypeCapsule::nsam()
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::nsites() const
+    {
+        return nsites_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::nsam() const
+    {
+        return nsam_;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::row_offset() const
+    {
+        return 0;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::col_offset() const
+    {
+        return 0;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::stride() const
+    {
+        return nsam_;
+    }
+
+    std::int8_t&
+    TiledGenotypeCapsule::operator()(std::size_t site, std::size_t sample)
+    {
+        convert_to_dense();
+        return dense[site * nsam_ + sample];
+    }
+
+    const std::int8_t&
+    TiledGenotypeCapsule::operator()(std::size_t site,
+                                     std::size_t sample) const
+    {
+        unpack();
+        return dense[site * nsam_ + sample];
+    }
+
+    std::int8_t*
+    TiledGenotypeCapsule::data()
+    {
+        convert_to_dense();
+        return dense.data();
+    }
+
+    const std::int8_t*
+    TiledGenotypeCapsule::data() const
+    {
+        unpack();
+        return dense.data();
+    }
+
+    const std::int8_t*
+    TiledGenotypeCapsule::cdata() const
+    {
+        unpack();
+        return dense.data();
+    }
+
+    std::unique_ptr<GenotypeCapsule>
+    TiledGenotypeCapsule::clone() const
+    {
+        if (!tiled_)
+            {
+                return std::unique_ptr<GenotypeCapsule>(
+                    new VectorGenotypeCapsule(this->dense, this->nsites_));
+            }
+        std::unique_ptr<TiledGenotypeCapsule> rv(new TiledGenotypeCapsule(
+            nsites_, nsam_, block_sites_, block_samples_, max_resident_));
+        // Spilled tiles are read directly, so that cloning
+        // does not change which tiles of this capsule are resident.
+        for (std::size_t i = 0; i < tiles.size(); ++i)
+            {
+                if (tiles[i].data.empty())
+                    {
+                        read_spilled(i, rv->tiles[i].data);
+                    }
+                else
+                    {
+                        rv->tiles[i].data = tiles[i].data;
+                    }
+                rv->tiles[i].last_use = ++rv->clock;
+                ++rv->nresident;
+                if (max_resident_ > 0)
+                    {
+                        rv->evict_until(max_resident_);
+                    }
+            }
+        return std::unique_ptr<GenotypeCapsule>(rv.release());
+    }
+
+    std::int8_t*
+    TiledGenotypeCapsule::begin()
+    {
+        return data();
+    }
+
+    const std::int8_t*
+    TiledGenotypeCapsule::begin() const
+    {
+        return cdata();
+    }
+
+    std::int8_t*
+    TiledGenotypeCapsule::end()
+    {
+        return data() + nsites_ * nsam_;
+    }
+
+    const std::int8_t*
+    TiledGenotypeCapsule::end() const
+    {
+        return cdata() + nsites_ * nsam_;
+    }
+
+    const std::int8_t*
+    TiledGenotypeCapsule::cbegin() const
+    {
+        return begin();
+    }
+
+    const std::int8_t*
+    TiledGenotypeCapsule::cend() const
+    {
+        return end();
+    }
+
+    bool
+    TiledGenotypeCapsule::empty() const
+    {
+        return nsites_ * nsam_ == 0;
+    }
+
+    std::size_t
+    TiledGenotypeCapsule::size() const
+    {
+        return nsites_ * nsam_;
+    }
+
+    bool
+    TiledGenotypeCapsule::resizable() const
+    {
+        return true;
+    }
+
+    void
+    TiledGenotypeCapsule::resize(bool remove_sites)
+    {
+        // Masking data requires non-const access, which
+        // has already converted the capsule to dense storage.
+        convert_to_dense();
+        dense.erase(std::remove(std::begin(dense), std::end(dense),
+                                std::numeric_limits<std::int8_t>::min()),
+                    std::end(dense));
+        if (remove_sites)
+            {
+                nsites_ = (nsam_ > 0) ? dense.size() / nsam_ : 0;
+            }
+        else
+            {
+                nsam_ = (nsites_ > 0) ? dense.size() / nsites_ : 0;
+            }
+    }
+
+    VariantMatrix
+    make_tiled_VariantMatrix(const VariantMatrix& m, std::size_t block_sites,
+                             std::size_t block_samples,
+                             std::size_t max_resident_blocks)
+    {
+        std::unique_ptr<GenotypeCapsule> gc(new TiledGenotypeCapsule(
+            m, block_sites, block_samples, max_resident_blocks));
+        std::unique_ptr<PositionCapsule> pc(new VectorPositionCapsule(
+            std::vector<double>(m.cpbegin(), m.cpend())));
+        return VariantMatrix(std::move(gc), std::move(pc), m.max_allele());
+    }
+} // namespace Sequence
@@ -1,4 +1,6 @@
 #include <Sequence/NonOwningCapsules.hpp>
+#include <Sequence/TiledCapsules.hpp>
+#include <Sequence/VectorCapsules.hpp>
 #include <Sequence/variant_matrix/windows.hpp>
 
 namespace Sequence
@@ -27,6 +29,26 @@ namespace Sequence
             }
         auto pb = std::lower_bound(m.pbegin(), m.pend(), beg);
         auto pe = std::upper_bound(pb, m.pend(), end);
+        auto tiled = dynamic_cast<const TiledGenotypeCapsule*>(
+            &m.genotype_capsule());
+        if (tiled != nullptr && tiled->tiled())
+            {
+                // Copy the window from the tiles covering it, rather
+                // than building the dense copy of the whole matrix.
+                const auto nsites = static_cast<std::size_t>(
+                    (pb == m.pend()) ? 0 : pe - pb);
+                const auto row_offset
+                    = static_cast<std::size_t>(pb - m.pbegin());
+                std::vector<std::int8_t> data(nsites * (j - i));
+                tiled->copy_region(row_offset, nsites, i, j - i,
+                                   data.data());
+                std::unique_ptr<GenotypeCapsule> gc(
+                    new VectorGenotypeCapsule(std::move(data), nsites));
+                std::unique_ptr<PositionCapsule> pc(
+                    new NonOwningPositionCapsule(pb, nsites));
+                return VariantMatrix(std::move(gc), std::move(pc),
+                                     nsites ? m.max_allele() : -1);
+            }
         if (pb == m.pend())
             {
                 std::unique_ptr<GenotypeCapsule> gc(
@@ -44,4 +66,24 @@ namespace Sequence
             new NonOwningPositionCapsule(pb, pe - pb));
         return VariantMatrix(std::move(gc), std::move(pc), m.max_allele());
     }
+
+    AlleleCountMatrix
+    make_window(const AlleleCountMatrix& c, const VariantMatrix& m,
+                const double beg, const double end)
+    {
+        if (end < beg)
+            {
+                throw std::invalid_argument("end must be >= beg");
+            }
+        if (c.nrow != m.nsites())
+            {
+                throw std::invalid_argument(
+                    "AlleleCountMatrix and VariantMatrix differ in size");
+            }
+        auto pb = std::lower_bound(m.pbegin(), m.pend(), beg);
+        auto pe = std::upper_bound(pb, m.pend(), end);
+        return make_row_range(
+            c, static_cast<std::size_t>(std::distance(m.pbegin(), pb)),
+            static_cast<std::size_t>(std::distance(m.pbegin(), pe)));
+    }
 } // namespace Sequence
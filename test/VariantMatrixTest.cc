@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <numeric> //for std::iota
 #include <iterator>
+#include <iomanip>
 #include <sstream>
 #include <fstream>
 #include <iostream>
@@ -201,4 +202,212 @@ BOOST_AUTO_TEST_CASE(test_io_roundtrip)
     BOOST_REQUIRE_EQUAL(m != vm, false);
 }
 
+namespace
+{
+    Sequence::VariantMatrix
+    random_replicate(const std::size_t nsam, const std::size_t nsites,
+                     const unsigned seed)
+    {
+        std::vector<std::int8_t> data(nsam * nsites);
+        std::vector<double> pos(nsites);
+        unsigned x = seed;
+        for (auto& d : data)
+            {
+                x = x * 1103515245u + 12345u;
+                d = static_cast<std::int8_t>((x >> 16) % 3 == 0);
+            }
+        for (std::size_t i = 0; i < nsites; ++i)
+            {
+                pos[i] = static_cast<double>(i + 1) / 4.0;
+            }
+        return Sequence::VariantMatrix(std::move(data), std::move(pos));
+    }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_reader_multiple_replicates)
+// Sample sizes change between replicates, so that the
+// storage of the reused matrix grows and shrinks.
+{
+    std::vector<Sequence::VariantMatrix> replicates;
+    replicates.emplace_back(random_replicate(10, 20, 1));
+    replicates.emplace_back(random_replicate(150, 7, 2));
+    replicates.emplace_back(random_replicate(3, 40, 3));
+    replicates.emplace_back(random_replicate(64, 64, 4));
+    std::ostringstream o;
+    o << "ms 10 4 -t 5\n1 2 3\n\n";
+    for (auto& r : replicates)
+        {
+            // Trees, as printed by ms -T, are skipped
+            std::ostringstream replicate;
+            Sequence::to_msformat(r, replicate);
+            o << "//\n(1:0.5,2:0.5);\n" << replicate.str().substr(3)
+              << "\n\n";
+        }
+    std::istringstream in(o.str());
+    Sequence::MsFormatReader reader(in);
+    Sequence::VariantMatrix vm(std::vector<std::int8_t>{},
+                               std::vector<double>{});
+    for (auto& r : replicates)
+        {
+            BOOST_REQUIRE(reader.next(vm));
+            BOOST_REQUIRE_EQUAL(vm.nsam(), r.nsam());
+            BOOST_REQUIRE(vm == r);
+            BOOST_REQUIRE_EQUAL(vm.max_allele(), 1);
+        }
+    BOOST_REQUIRE(!reader.next(vm));
+    BOOST_REQUIRE(in.eof());
+    BOOST_REQUIRE(vm == replicates.back());
+    BOOST_REQUIRE_EQUAL(reader.nreplicates(), replicates.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_reader_formats)
+{
+    // Windows line endings, no segregating sites,
+    // and alleles other than 0 and 1
+    std::istringstream in("//\r\nsegsites: 2\r\npositions: 0.1 0.2\r\n"
+                          "01\r\n20\r\n\r\n//\nsegsites: 0\n\n"
+                          "//\nsegsites: 1\npositions: 0.5\n1\n0");
+    Sequence::MsFormatReader reader(in);
+    auto a = reader.next();
+    BOOST_REQUIRE_EQUAL(a.nsites(), 2);
+    BOOST_REQUIRE_EQUAL(a.nsam(), 2);
+    BOOST_REQUIRE_EQUAL(a.get(0, 1), 2);
+    BOOST_REQUIRE_EQUAL(a.get(1, 0), 1);
+    BOOST_REQUIRE_EQUAL(a.max_allele(), 2);
+    auto b = reader.next();
+    BOOST_REQUIRE_EQUAL(b.nsites(), 0);
+    auto c = reader.next();
+    BOOST_REQUIRE_EQUAL(c.nsam(), 2);
+    BOOST_REQUIRE_EQUAL(c.position(0), 0.5);
+    BOOST_REQUIRE_THROW(reader.next(), std::runtime_error);
+
+    std::istringstream bad("//\nsegsites: 2\npositions: 0.1 0.2\n01\n1\n");
+    BOOST_REQUIRE_THROW(Sequence::from_msformat(bad), std::runtime_error);
+    std::istringstream bad2("//\nsegsites: 2\npositions: 0.1 0.2\n0x\n");
+    BOOST_REQUIRE_THROW(Sequence::from_msformat(bad2), std::runtime_error);
+}
+
+namespace
+{
+    // The formatted-output implementation that preceded
+    // Sequence::MsFormatWriter
+    std::string
+    reference_msformat(const Sequence::VariantMatrix& m,
+                       const std::ostream& format)
+    {
+        std::ostringstream o;
+        o.copyfmt(format);
+        o << "//\nsegsites: " << m.nsites() << "\npositions: ";
+        for (auto p = m.cpbegin(); p < m.cpend(); ++p)
+            {
+                o << *p << ' ';
+            }
+        o << '\n';
+        for (std::size_t i = 0; i < m.nsam(); ++i)
+            {
+                auto col = Sequence::get_ConstColView(m, i);
+                for (auto state : col)
+                    {
+                        o << static_cast<int>(state);
+                    }
+                if (i < m.nsam() - 1)
+                    {
+                        o << '\n';
+                    }
+            }
+        return o.str();
+    }
+
+    void
+    compare_to_reference(const Sequence::VariantMatrix& m,
+                         const std::ostream& format)
+    {
+        std::ostringstream o;
+        o.copyfmt(format);
+        Sequence::to_msformat(m, o);
+        BOOST_REQUIRE_EQUAL(o.str(), reference_msformat(m, format));
+    }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_writer_matches_stream_output)
+{
+    // Ties, values that round up to the next power of ten,
+    // values needing an exponent, and values near zero
+    std::vector<double> pos = { 0.,         0.125,      0.5,      1e-5,
+                                9.9999996,  0.99999995, 123456789, 1.5e-5,
+                                0.00012345, 2.5,        1e17,     0.3 };
+    unsigned x = 1;
+    for (int i = 0; i < 500; ++i)
+        {
+            x = x * 1103515245u + 12345u;
+            pos.push_back(static_cast<double>(x) / 4294967296.0);
+            pos.push_back(static_cast<double>(x >> 8) / 16.0);
+        }
+    std::sort(pos.begin(), pos.end());
+    std::vector<std::int8_t> data(pos.size() * 70);
+    for (std::size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = static_cast<std::int8_t>(i % 7 % 2);
+        }
+    Sequence::VariantMatrix r(data, pos);
+    std::ostringstream format;
+    compare_to_reference(r, format);
+    format << std::setprecision(10);
+    compare_to_reference(r, format);
+    format << std::setprecision(0);
+    compare_to_reference(r, format);
+    format << std::fixed << std::setprecision(4);
+    compare_to_reference(r, format);
+    format << std::setprecision(0);
+    compare_to_reference(r, format);
+    format << std::scientific;
+    compare_to_reference(r, format);
+    format << std::defaultfloat << std::showpoint;
+    compare_to_reference(r, format);
+
+    format.copyfmt(std::ostringstream());
+    compare_to_reference(m, format);
+    // A window into m, and the haplotype-major copy
+    compare_to_reference(
+        Sequence::make_slice(m, m.position(3), m.position(40), 5, 19), format);
+    auto cached = m.deepcopy();
+    cached.set_haplotype_cache(true);
+    compare_to_reference(cached, format);
+    // Missing data and alleles with two digits
+    r.data()[3] = Sequence::VariantMatrix::mask;
+    r.data()[80] = 10;
+    compare_to_reference(r, format);
+    compare_to_reference(Sequence::VariantMatrix(std::vector<std::int8_t>{},
+                                                 std::vector<double>{}),
+                         format);
+}
+
+BOOST_AUTO_TEST_CASE(test_writer_round_trip)
+{
+    std::vector<Sequence::VariantMatrix> replicates;
+    replicates.emplace_back(random_replicate(10, 20, 1));
+    replicates.emplace_back(random_replicate(150, 7, 2));
+    replicates.emplace_back(random_replicate(3, 0, 3));
+    replicates.emplace_back(random_replicate(64, 64, 4));
+    std::ostringstream o;
+    Sequence::MsFormatWriter writer(o);
+    for (auto& r : replicates)
+        {
+            writer.write(r);
+        }
+    BOOST_REQUIRE_EQUAL(writer.nreplicates(), replicates.size());
+    std::istringstream in(o.str());
+    Sequence::MsFormatReader reader(in);
+    for (auto& r : replicates)
+        {
+            auto vm = reader.next();
+            BOOST_REQUIRE_EQUAL(vm.nsites(), r.nsites());
+            if (r.nsites())
+                {
+                    BOOST_REQUIRE(vm == r);
+                }
+        }
+    BOOST_REQUIRE_THROW(reader.next(), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
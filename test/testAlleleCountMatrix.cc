@@ -1,11 +1,16 @@
 //! \file testAlleleCountMatrix.cc @brief Tests for Sequence/VariantMatrix.hpp
 #include "msprime_data_fixture.hpp"
 #include <Sequence/AlleleCountMatrix.hpp>
+#include <Sequence/StateCounts.hpp>
+#include <Sequence/BitPackedCapsules.hpp>
+#include <Sequence/SparseCapsules.hpp>
 #include <Sequence/variant_matrix/windows.hpp>
+#include <Sequence/summstats/classics.hpp>
 #include <boost/test/unit_test.hpp>
 #include <algorithm>
 #include <numeric> //for std::iota
 #include <iterator>
+#include <random>
 
 BOOST_FIXTURE_TEST_SUITE(test_allele_count_matrix, vmatrix_from_msprime)
 
@@ -17,6 +22,97 @@ BOOST_AUTO_TEST_CASE(test_max_allele_exception)
     BOOST_REQUIRE_THROW(Sequence::AlleleCountMatrix ac(m), std::runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(test_counts_many_states)
+{
+    // Sample sizes and numbers of states are chosen
+    // to cover full vectors, remainders, and data
+    // where vectorized counting is not used.
+    std::mt19937 rng(42);
+    for (std::size_t nsam : { 1, 15, 37, 64, 101 })
+        {
+            for (int max_allele : { 1, 3, 7, 8, 20 })
+                {
+                    std::uniform_int_distribution<int> state(-1, max_allele);
+                    std::vector<std::int8_t> data(10 * nsam);
+                    for (auto& d : data)
+                        {
+                            d = static_cast<std::int8_t>(state(rng));
+                        }
+                    std::vector<double> pos(10);
+                    std::iota(pos.begin(), pos.end(), 0.);
+                    Sequence::VariantMatrix x(data, pos);
+                    Sequence::AlleleCountMatrix ac(x);
+                    BOOST_REQUIRE_EQUAL(
+                        ac.ncol, static_cast<std::size_t>(x.max_allele()) + 1);
+                    Sequence::StateCounts sc;
+                    for (std::size_t i = 0; i < x.nsites(); ++i)
+                        {
+                            std::vector<std::int32_t> expected(ac.ncol, 0);
+                            for (std::size_t j = 0; j < nsam; ++j)
+                                {
+                                    if (x.get(i, j) >= 0)
+                                        {
+                                            ++expected[static_cast<std::size_t>(
+                                                x.get(i, j))];
+                                        }
+                                }
+                            auto r = ac.row(i);
+                            BOOST_REQUIRE(
+                                std::equal(r.first, r.second, expected.begin()));
+                            auto row = Sequence::get_ConstRowView(x, i);
+                            sc(row);
+                            BOOST_REQUIRE(std::equal(expected.begin(),
+                                                     expected.end(),
+                                                     sc.counts.begin()));
+                            BOOST_REQUIRE_EQUAL(
+                                sc.n, std::accumulate(expected.begin(),
+                                                      expected.end(), 0u));
+                        }
+                }
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_reserved_value_exception)
+{
+    m.data()[m.nsam() * 2 + 33] = Sequence::VariantMatrix::mask;
+    BOOST_REQUIRE_THROW(Sequence::AlleleCountMatrix ac(m),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_counts)
+{
+    // Enough sites for the work to be split into several tasks
+    std::mt19937 rng(101);
+    std::uniform_int_distribution<int> state(-1, 1);
+    std::vector<std::int8_t> data(20000 * 21);
+    for (auto& d : data)
+        {
+            d = static_cast<std::int8_t>(state(rng));
+        }
+    std::vector<double> pos(20000);
+    std::iota(pos.begin(), pos.end(), 0.);
+    Sequence::VariantMatrix x(data, pos);
+    Sequence::AlleleCountMatrix serial(x);
+    auto executor = Sequence::make_thread_executor(4);
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(x, 4u).counts == serial.counts);
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(x, executor).counts
+                  == serial.counts);
+    auto packed = Sequence::make_compact_VariantMatrix(data, pos);
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(packed, executor).counts
+                  == serial.counts);
+    auto sparse = Sequence::make_sparse_VariantMatrix(x);
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(sparse, executor).counts
+                  == serial.counts);
+
+    // Errors in any task are reported
+    x.get(15000, 3) = Sequence::VariantMatrix::mask;
+    BOOST_REQUIRE_THROW(Sequence::AlleleCountMatrix(x, executor),
+                        std::invalid_argument);
+    x.get(15000, 3) = 2;
+    BOOST_REQUIRE_THROW(Sequence::AlleleCountMatrix(x, executor),
+                        std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE(counts_from_windows)
 {
     for (std::size_t i = 0; i < m.nsites(); ++i)
@@ -26,5 +122,48 @@ BOOST_AUTO_TEST_CASE(counts_from_windows)
         }
 }
 
+BOOST_AUTO_TEST_CASE(test_row_range)
+{
+    auto r = Sequence::make_row_range(c, 3, 10);
+    BOOST_REQUIRE_EQUAL(r.nrow, 7);
+    BOOST_REQUIRE_EQUAL(r.ncol, c.ncol);
+    BOOST_REQUIRE_EQUAL(r.nsam, c.nsam);
+    // The counts are shared, not copied
+    BOOST_REQUIRE(r.counts.data() == c.counts.data() + 3 * c.ncol);
+    BOOST_REQUIRE(std::equal(r.row(0).first, r.row(6).second,
+                             c.row(3).first));
+    const std::vector<std::int32_t> v = r.counts;
+    BOOST_REQUIRE(r.counts == v);
+    BOOST_REQUIRE_EQUAL(Sequence::make_row_range(c, 5, 5).nrow, 0);
+    BOOST_REQUIRE_THROW(Sequence::make_row_range(c, 0, c.nrow + 1),
+                        std::out_of_range);
+    BOOST_REQUIRE_THROW(Sequence::make_row_range(c, 5, 4),
+                        std::invalid_argument);
+    BOOST_REQUIRE_THROW(r.row(7), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(test_windows_from_counts)
+{
+    for (std::size_t i = 0; i + 10 < m.nsites(); i += 5)
+        {
+            auto w = Sequence::make_window(m, m.position(i), m.position(i + 10));
+            Sequence::AlleleCountMatrix wc(w);
+            auto v = Sequence::make_window(c, m, m.position(i),
+                                           m.position(i + 10));
+            BOOST_REQUIRE(v.counts == wc.counts);
+            BOOST_REQUIRE_EQUAL(v.nrow, wc.nrow);
+            BOOST_REQUIRE_EQUAL(Sequence::thetapi(v), Sequence::thetapi(wc));
+            BOOST_REQUIRE_EQUAL(Sequence::thetaw(v), Sequence::thetaw(wc));
+            BOOST_REQUIRE_EQUAL(Sequence::tajd(v), Sequence::tajd(wc));
+            BOOST_REQUIRE_EQUAL(Sequence::faywuh(v, 0),
+                                Sequence::faywuh(wc, 0));
+        }
+    auto e = Sequence::make_window(c, m, -2.0, -1.0);
+    BOOST_REQUIRE_EQUAL(e.nrow, 0);
+    auto w = Sequence::make_window(m, 0.1, 0.2);
+    BOOST_REQUIRE_THROW(Sequence::make_window(c, w, 0.1, 0.2),
+                        std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
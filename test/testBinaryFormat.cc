@@ -0,0 +1,223 @@
+//! \file testBinaryFormat.cc @brief Tests for Sequence/variant_matrix/binaryformat.hpp
+
+#include <cstdint>
+#include <fstream>
+#include <unistd.h>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/variant_matrix/binaryformat.hpp>
+#include <Sequence/variant_matrix/windows.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+struct binary_file_fixture : public vmatrix_from_msprime
+{
+    const char* filename;
+    std::vector<Sequence::BinaryFormatCompression> codecs;
+    binary_file_fixture()
+        : vmatrix_from_msprime(), filename("binaryformat_test.bin"),
+          codecs{}
+    {
+        for (auto c : { Sequence::BinaryFormatCompression::none,
+                        Sequence::BinaryFormatCompression::zlib,
+                        Sequence::BinaryFormatCompression::zstd })
+            {
+                if (Sequence::binaryformat_supports(c))
+                    {
+                        codecs.push_back(c);
+                    }
+            }
+    }
+    ~binary_file_fixture() { unlink(filename); }
+};
+
+namespace
+{
+    // Copy of sites [first, last) of m
+    Sequence::VariantMatrix
+    site_range(const Sequence::VariantMatrix& m, const std::size_t first,
+               const std::size_t last)
+    {
+        std::vector<std::int8_t> data(m.cdata() + first * m.nsam(),
+                                      m.cdata() + last * m.nsam());
+        std::vector<double> pos(m.cpbegin() + first, m.cpbegin() + last);
+        return Sequence::VariantMatrix(std::move(data), std::move(pos));
+    }
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(test_binary_format, binary_file_fixture)
+
+BOOST_AUTO_TEST_CASE(test_round_trip)
+{
+    for (auto c : codecs)
+        {
+            Sequence::to_binaryformat(m, filename, c, 7);
+            Sequence::BinaryFormatReader r(filename);
+            BOOST_REQUIRE(r.compression() == c);
+            BOOST_REQUIRE_EQUAL(r.nsites(), m.nsites());
+            BOOST_REQUIRE_EQUAL(r.nsam(), m.nsam());
+            BOOST_REQUIRE_EQUAL(r.max_allele(), m.max_allele());
+            BOOST_REQUIRE_EQUAL(r.nblocks(), (m.nsites() + 6) / 7);
+            auto x = Sequence::from_binaryformat(filename);
+            BOOST_REQUIRE(x == m);
+            BOOST_REQUIRE_EQUAL(x.max_allele(), m.max_allele());
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_read_sites)
+{
+    for (auto c : codecs)
+        {
+            Sequence::to_binaryformat(m, filename, c, 5);
+            Sequence::BinaryFormatReader r(filename);
+            // Ranges within a block, across blocks, and empty
+            for (auto range : { std::make_pair(0, 3), std::make_pair(3, 17),
+                                std::make_pair(5, 10), std::make_pair(9, 9),
+                                std::make_pair(11, 12) })
+                {
+                    auto x = r.read_sites(range.first, range.second);
+                    BOOST_REQUIRE_EQUAL(x.nsites(),
+                                        range.second - range.first);
+                    for (std::size_t i = 0; i < x.nsites(); ++i)
+                        {
+                            BOOST_REQUIRE_EQUAL(
+                                x.position(i),
+                                m.position(range.first + i));
+                            auto a = Sequence::get_ConstRowView(x, i);
+                            auto b = Sequence::get_ConstRowView(
+                                m, range.first + i);
+                            BOOST_REQUIRE(
+                                std::equal(a.cbegin(), a.cend(), b.cbegin()));
+                        }
+                }
+            auto last = r.block_sites(r.nblocks() - 1);
+            BOOST_REQUIRE_EQUAL(last.second, m.nsites());
+            auto x = r.read_block_matrix(r.nblocks() - 1);
+            BOOST_REQUIRE_EQUAL(x.nsites(), last.second - last.first);
+            BOOST_REQUIRE_THROW(r.read_sites(0, m.nsites() + 1),
+                                std::out_of_range);
+            BOOST_REQUIRE_THROW(r.block_sites(r.nblocks()),
+                                std::out_of_range);
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_streaming_writer)
+{
+    // Pieces that do not fill whole blocks are
+    // written by several calls to write.
+    {
+        Sequence::BinaryFormatWriter w(filename, codecs.back(), 4);
+        std::size_t first = 0;
+        for (std::size_t n : { 3, 6, 1, 0 })
+            {
+                const auto last = n ? first + n : m.nsites();
+                w.write(site_range(m, first, last));
+                first = last;
+            }
+    }
+    BOOST_REQUIRE(Sequence::from_binaryformat(filename) == m);
+}
+
+BOOST_AUTO_TEST_CASE(test_sample_size_mismatch)
+{
+    Sequence::BinaryFormatWriter w(filename);
+    w.write(m);
+    auto s = Sequence::make_slice(m, m.position(0), m.position(5), 0, 10);
+    BOOST_REQUIRE_THROW(w.write(s), std::invalid_argument);
+    BOOST_REQUIRE_NO_THROW(w.write(site_range(m, 0, 5)));
+}
+
+BOOST_AUTO_TEST_CASE(test_empty_matrix)
+{
+    Sequence::VariantMatrix e(std::vector<std::int8_t>{},
+                              std::vector<double>{});
+    Sequence::to_binaryformat(e, filename);
+    Sequence::BinaryFormatReader r(filename);
+    BOOST_REQUIRE_EQUAL(r.nsites(), 0);
+    BOOST_REQUIRE_EQUAL(r.nblocks(), 0);
+    BOOST_REQUIRE_EQUAL(r.read().nsites(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_invalid_arguments)
+{
+    BOOST_REQUIRE_THROW(Sequence::BinaryFormatWriter(
+                            filename, Sequence::BinaryFormatCompression::none,
+                            0),
+                        std::invalid_argument);
+    for (auto c : { Sequence::BinaryFormatCompression::zlib,
+                    Sequence::BinaryFormatCompression::zstd })
+        {
+            if (!Sequence::binaryformat_supports(c))
+                {
+                    BOOST_REQUIRE_THROW(
+                        Sequence::BinaryFormatWriter(filename, c),
+                        std::invalid_argument);
+                }
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_damaged_file)
+{
+    for (auto c : codecs)
+        {
+            Sequence::to_binaryformat(m, filename, c, 8);
+            {
+                // Overwrite the start of the first block
+                std::fstream f(filename, std::ios_base::in
+                                             | std::ios_base::out
+                                             | std::ios_base::binary);
+                f.seekp(48);
+                const char junk[16] = { 1, 2, 3, 4, 5, 6, 7, 8,
+                                        9, 10, 11, 12, 13, 14, 15, 16 };
+                f.write(junk, sizeof(junk));
+            }
+            Sequence::BinaryFormatReader r(filename);
+            if (c == Sequence::BinaryFormatCompression::none)
+                {
+                    BOOST_REQUIRE(!(r.read() == m));
+                }
+            else
+                {
+                    BOOST_REQUIRE_THROW(r.read(), std::runtime_error);
+                }
+            // A truncated file is detected when opened
+            std::vector<char> buffer;
+            {
+                std::ifstream in(filename, std::ios_base::binary);
+                buffer.assign(std::istreambuf_iterator<char>(in),
+                              std::istreambuf_iterator<char>());
+            }
+            std::ofstream out(filename, std::ios_base::binary);
+            out.write(buffer.data(),
+                      static_cast<std::streamsize>(buffer.size() - 3));
+            out.close();
+            BOOST_REQUIRE_THROW(Sequence::BinaryFormatReader(filename).nsites(),
+                                std::runtime_error);
+        }
+    {
+        // Sample sizes for which the size of a block, or of the
+        // whole matrix, overflows are detected when opened
+        Sequence::to_binaryformat(site_range(m, 0, 4), filename,
+                                  Sequence::BinaryFormatCompression::none, 4);
+        for (std::uint64_t nsam :
+             { m.nsam() + (std::uint64_t(1) << 62), ~std::uint64_t(0) - 4 })
+            {
+                std::fstream f(filename, std::ios_base::in | std::ios_base::out
+                                             | std::ios_base::binary);
+                f.seekp(24);
+                f.write(reinterpret_cast<const char*>(&nsam), sizeof(nsam));
+                f.close();
+                BOOST_REQUIRE_THROW(Sequence::BinaryFormatReader{ filename },
+                                    std::runtime_error);
+            }
+    }
+    std::ofstream out(filename);
+    out << "not a matrix file\n";
+    out.close();
+    BOOST_REQUIRE_THROW(Sequence::from_binaryformat(filename),
+                        std::runtime_error);
+    unlink(filename);
+    BOOST_REQUIRE_THROW(Sequence::from_binaryformat(filename),
+                        std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,180 @@
+//! \file testBitPackedCapsule.cc @brief Tests for Sequence/BitPackedCapsules.hpp
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <Sequence/BitPackedCapsules.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/AlleleCountMatrix.hpp>
+#include <Sequence/summstats/classics.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+struct packed_and_dense_matrices : public vmatrix_from_msprime
+{
+    Sequence::VariantMatrix packed;
+    packed_and_dense_matrices()
+        : vmatrix_from_msprime(),
+          packed(Sequence::make_compact_VariantMatrix(
+              std::vector<std::int8_t>(m.cdata(),
+                                       m.cdata() + m.nsites() * m.nsam()),
+              std::vector<double>(m.cpbegin(), m.cpend())))
+    {
+    }
+
+    const Sequence::BitPackedGenotypeCapsule*
+    capsule() const
+    {
+        return dynamic_cast<const Sequence::BitPackedGenotypeCapsule*>(
+            &packed.genotype_capsule());
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(test_bitpacked_capsule, packed_and_dense_matrices)
+
+BOOST_AUTO_TEST_CASE(test_factory_picks_bitpacked)
+{
+    BOOST_REQUIRE(capsule() != nullptr);
+    BOOST_REQUIRE(capsule()->packed());
+    BOOST_REQUIRE_EQUAL(packed.nsites(), m.nsites());
+    BOOST_REQUIRE_EQUAL(packed.nsam(), m.nsam());
+    BOOST_REQUIRE_EQUAL(packed.max_allele(), m.max_allele());
+}
+
+BOOST_AUTO_TEST_CASE(test_factory_picks_vector)
+{
+    std::vector<std::int8_t> data{ 0, 1, 2, 0, 1, 1 };
+    auto x = Sequence::make_compact_VariantMatrix(data,
+                                                  std::vector<double>{ 1, 2 });
+    BOOST_REQUIRE(dynamic_cast<const Sequence::BitPackedGenotypeCapsule*>(
+                      &x.genotype_capsule())
+                  == nullptr);
+    // Missing data other than -1 cannot be packed without loss
+    data[2] = -2;
+    x = Sequence::make_compact_VariantMatrix(data,
+                                             std::vector<double>{ 1, 2 });
+    BOOST_REQUIRE(dynamic_cast<const Sequence::BitPackedGenotypeCapsule*>(
+                      &x.genotype_capsule())
+                  == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_invalid_states)
+{
+    BOOST_REQUIRE_THROW(Sequence::BitPackedGenotypeCapsule(
+                            std::vector<std::int8_t>{ 0, 1, 2, 0 }, 2),
+                        std::invalid_argument);
+    BOOST_REQUIRE_THROW(
+        Sequence::BitPackedGenotypeCapsule(
+            std::vector<std::int8_t>{ 0, 1, Sequence::VariantMatrix::mask, 0 },
+            2),
+        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_views)
+{
+    const auto& cpacked = packed;
+    for (std::size_t i = 0; i < m.nsites(); ++i)
+        {
+            auto a = Sequence::get_ConstRowView(m, i);
+            auto b = Sequence::get_ConstRowView(cpacked, i);
+            BOOST_REQUIRE(std::equal(a.begin(), a.end(), b.begin()));
+        }
+    for (std::size_t i = 0; i < m.nsam(); ++i)
+        {
+            auto a = Sequence::get_ConstColView(m, i);
+            auto b = Sequence::get_ConstColView(cpacked, i);
+            BOOST_REQUIRE(std::equal(a.begin(), a.end(), b.begin()));
+        }
+    // Const access does not discard the packed data
+    BOOST_REQUIRE(capsule()->packed());
+    BOOST_REQUIRE(m == cpacked);
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_data)
+{
+    m.get(0, 0) = -1;
+    m.get(3, 7) = -1;
+    auto x = Sequence::make_compact_VariantMatrix(
+        std::vector<std::int8_t>(m.cdata(), m.cdata() + m.nsites() * m.nsam()),
+        std::vector<double>(m.cpbegin(), m.cpend()));
+    auto c = dynamic_cast<const Sequence::BitPackedGenotypeCapsule*>(
+        &x.genotype_capsule());
+    BOOST_REQUIRE(c != nullptr);
+    BOOST_REQUIRE(c->missing_row(0) != nullptr);
+    BOOST_REQUIRE(c->missing_row(1) == nullptr);
+    BOOST_REQUIRE_EQUAL(c->state(0, 0), -1);
+    BOOST_REQUIRE_EQUAL(c->state(3, 7), -1);
+    for (std::size_t i = 0; i < m.nsites(); ++i)
+        {
+            for (std::size_t j = 0; j < m.nsam(); ++j)
+                {
+                    BOOST_REQUIRE_EQUAL(c->state(i, j), m.cget(i, j));
+                }
+        }
+    Sequence::AlleleCountMatrix ac(x);
+    BOOST_REQUIRE(ac.counts == Sequence::AlleleCountMatrix(m).counts);
+    BOOST_REQUIRE(c->packed());
+}
+
+BOOST_AUTO_TEST_CASE(test_allele_counts_and_stats)
+{
+    Sequence::AlleleCountMatrix ac(packed);
+    BOOST_REQUIRE(capsule()->packed());
+    BOOST_REQUIRE(ac.counts == c.counts);
+    BOOST_REQUIRE_EQUAL(ac.ncol, c.ncol);
+    BOOST_REQUIRE_EQUAL(ac.nrow, c.nrow);
+    BOOST_REQUIRE_EQUAL(Sequence::thetapi(ac), Sequence::thetapi(c));
+    BOOST_REQUIRE_EQUAL(Sequence::tajd(ac), Sequence::tajd(c));
+    BOOST_REQUIRE(Sequence::difference_matrix(packed)
+                  == Sequence::difference_matrix(m));
+    BOOST_REQUIRE_EQUAL(Sequence::number_of_haplotypes(packed),
+                        Sequence::number_of_haplotypes(m));
+}
+
+BOOST_AUTO_TEST_CASE(test_mutation_converts_to_dense)
+{
+    packed.get(0, 0) = 1 - packed.get(0, 0);
+    BOOST_REQUIRE(!capsule()->packed());
+    BOOST_REQUIRE(packed != m);
+    packed.get(0, 0) = m.get(0, 0);
+    BOOST_REQUIRE(packed == m);
+    Sequence::AlleleCountMatrix ac(packed);
+    BOOST_REQUIRE(ac.counts == c.counts);
+}
+
+BOOST_AUTO_TEST_CASE(test_deepcopy)
+{
+    auto copy = packed.deepcopy();
+    BOOST_REQUIRE(copy == m);
+    BOOST_REQUIRE(dynamic_cast<const Sequence::BitPackedGenotypeCapsule*>(
+                      &copy.genotype_capsule())
+                  != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_const_access)
+// Both threads may be the first to need the dense buffer.
+{
+    const Sequence::VariantMatrix& cp = packed;
+    std::vector<const std::int8_t*> pointers(4, nullptr);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < pointers.size(); ++t)
+        {
+            threads.emplace_back([&cp, &pointers, t]() {
+                pointers[t] = cp.cdata();
+            });
+        }
+    for (auto& t : threads)
+        {
+            t.join();
+        }
+    for (auto p : pointers)
+        {
+            BOOST_REQUIRE_EQUAL(p, pointers[0]);
+        }
+    BOOST_REQUIRE(capsule()->packed());
+    BOOST_REQUIRE(std::equal(m.cdata(), m.cdata() + m.nsites() * m.nsam(),
+                             pointers[0]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
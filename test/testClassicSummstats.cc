@@ -3,6 +3,7 @@
 #include <cmath>
 #include <algorithm>
 #include <numeric>
+#include <random>
 #include <set>
 #include <string>
 #include <vector>
@@ -10,6 +11,7 @@
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
 #include <Sequence/summstats/classics.hpp>
+#include <Sequence/summstats/lhaf.hpp>
 #include "msprime_data_fixture.hpp"
 #include <boost/test/unit_test.hpp>
 
@@ -106,6 +108,55 @@ manual_haplotype_labels_no_missing_data(const Sequence::VariantMatrix& m)
     return l;
 }
 
+std::vector<std::pair<std::size_t, std::size_t>>
+manual_rmin_intervals(const Sequence::VariantMatrix& m)
+// Hudson and Kaplan's algorithm, using sets of
+// two-site haplotypes for the four-gamete test.
+{
+    std::vector<std::size_t> biallelic;
+    for (std::size_t i = 0; i < m.nsites(); ++i)
+        {
+            auto r = Sequence::get_ConstRowView(m, i);
+            std::set<std::int8_t> states;
+            for (auto x : r)
+                {
+                    if (x >= 0)
+                        {
+                            states.insert(x);
+                        }
+                }
+            if (states.size() == 2)
+                {
+                    biallelic.push_back(i);
+                }
+        }
+    std::vector<std::pair<std::size_t, std::size_t>> rv;
+    std::size_t x = 0;
+    for (std::size_t a = 1; a < biallelic.size(); ++a)
+        {
+            for (std::size_t b = a; b > x; --b)
+                {
+                    auto ra = Sequence::get_ConstRowView(m, biallelic[a]);
+                    auto rb = Sequence::get_ConstRowView(m, biallelic[b - 1]);
+                    std::set<std::pair<std::int8_t, std::int8_t>> gametes;
+                    for (std::size_t k = 0; k < m.nsam(); ++k)
+                        {
+                            if (ra[k] >= 0 && rb[k] >= 0)
+                                {
+                                    gametes.emplace(rb[k], ra[k]);
+                                }
+                        }
+                    if (gametes.size() == 4)
+                        {
+                            rv.emplace_back(biallelic[b - 1], biallelic[a]);
+                            x = a;
+                            break;
+                        }
+                }
+        }
+    return rv;
+}
+
 BOOST_FIXTURE_TEST_SUITE(test_classic_stats, vmatrix_from_msprime)
 
 BOOST_AUTO_TEST_CASE(test_thetapi)
@@ -271,6 +322,44 @@ BOOST_AUTO_TEST_CASE(test_thetah_multiple_derived_states)
         auto h = Sequence::thetah(Sequence::AlleleCountMatrix(m3), 0));
 }
 
+BOOST_AUTO_TEST_CASE(test_classic_summstats)
+{
+    auto same = [](const double a, const double b) {
+        return a == b || (std::isnan(a) && std::isnan(b));
+    };
+    // Add some missing data
+    m.get(0, 0) = -1;
+    m.get(5, 7) = -1;
+    Sequence::AlleleCountMatrix ac(m);
+    for (std::int8_t refstate = 0; refstate < 2; ++refstate)
+        {
+            auto s = Sequence::classic_summstats(ac, refstate);
+            BOOST_REQUIRE(same(s.thetapi, Sequence::thetapi(ac)));
+            BOOST_REQUIRE(same(s.thetaw, Sequence::thetaw(ac)));
+            BOOST_REQUIRE(same(s.thetah, Sequence::thetah(ac, refstate)));
+            BOOST_REQUIRE(same(s.thetal, Sequence::thetal(ac, refstate)));
+            BOOST_REQUIRE(same(s.hprime, Sequence::hprime(ac, refstate)));
+            BOOST_REQUIRE(same(s.faywuh, Sequence::faywuh(ac, refstate)));
+            BOOST_REQUIRE(same(s.tajd, Sequence::tajd(ac)));
+            BOOST_REQUIRE_EQUAL(s.nvariable_sites,
+                                Sequence::nvariable_sites(ac));
+            BOOST_REQUIRE_EQUAL(s.nbiallelic_sites,
+                                Sequence::nbiallelic_sites(ac));
+            BOOST_REQUIRE_EQUAL(s.total_number_of_mutations,
+                                Sequence::total_number_of_mutations(ac));
+        }
+    BOOST_REQUIRE_THROW(Sequence::classic_summstats(ac, 2),
+                        std::invalid_argument);
+    // A site with two derived states
+    m.get(1, 0) = 2;
+    std::vector<std::int8_t> temp(m.data(), m.data() + m.nsites() * m.nsam());
+    std::vector<double> tpos(m.pbegin(), m.pend());
+    Sequence::VariantMatrix m2(temp, tpos);
+    BOOST_REQUIRE_THROW(
+        Sequence::classic_summstats(Sequence::AlleleCountMatrix(m2), 0),
+        std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE(test_number_of_differences)
 {
     auto nd = Sequence::difference_matrix(m);
@@ -308,6 +397,45 @@ BOOST_AUTO_TEST_CASE(test_is_different_matrix)
         }
 }
 
+BOOST_AUTO_TEST_CASE(test_difference_matrix_missing_and_multiallelic_data)
+{
+    // Sites and states are chosen so that the data
+    // span several words and bit planes.
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> state(-1, 5);
+    std::size_t nsam = 37, nsites = 150;
+    std::vector<std::int8_t> data(nsam * nsites);
+    for (auto& d : data)
+        {
+            d = static_cast<std::int8_t>(state(rng));
+        }
+    std::vector<double> pos(nsites);
+    std::iota(pos.begin(), pos.end(), 0.);
+    Sequence::VariantMatrix x(data, pos);
+    std::vector<std::int32_t> expected;
+    for (std::size_t i = 0; i < nsam - 1; ++i)
+        {
+            for (std::size_t j = i + 1; j < nsam; ++j)
+                {
+                    std::int32_t ndiffs = 0;
+                    for (std::size_t k = 0; k < nsites; ++k)
+                        {
+                            auto a = x.get(k, i), b = x.get(k, j);
+                            ndiffs += (a >= 0 && b >= 0 && a != b);
+                        }
+                    expected.push_back(ndiffs);
+                }
+        }
+    BOOST_REQUIRE(Sequence::difference_matrix(x) == expected);
+    auto isdiff = Sequence::is_different_matrix(x);
+    for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            BOOST_REQUIRE_EQUAL(isdiff[i], expected[i] > 0);
+        }
+    x.set_haplotype_cache(true);
+    BOOST_REQUIRE(Sequence::difference_matrix(x) == expected);
+}
+
 BOOST_AUTO_TEST_CASE(test_number_haplotype_labels)
 {
     auto labels = Sequence::label_haplotypes(m);
@@ -337,6 +465,79 @@ BOOST_AUTO_TEST_CASE(test_haploype_label_correctness)
         }
 }
 
+BOOST_AUTO_TEST_CASE(test_haplotype_labels_are_first_occurrence)
+{
+    auto labels = Sequence::label_haplotypes(m);
+    for (std::size_t i = 0; i < m.nsam(); ++i)
+        {
+            auto ci = Sequence::get_ConstColView(m, i);
+            std::size_t first = 0;
+            for (; first < i; ++first)
+                {
+                    auto cj = Sequence::get_ConstColView(m, first);
+                    if (std::equal(ci.cbegin(), ci.cend(), cj.cbegin()))
+                        {
+                            break;
+                        }
+                }
+            BOOST_REQUIRE_EQUAL(labels[i], first);
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_haplotype_labels_with_missing_data)
+{
+    std::mt19937 generator(101);
+    std::bernoulli_distribution is_missing(0.2);
+    for (std::size_t i = 0; i < m.nsites(); ++i)
+        {
+            for (std::size_t j = 0; j < m.nsam(); ++j)
+                {
+                    if (is_missing(generator))
+                        {
+                            m.get(i, j) = -1;
+                        }
+                }
+        }
+    // The final haplotype is entirely missing data
+    for (std::size_t i = 0; i < m.nsites(); ++i)
+        {
+            m.get(i, m.nsam() - 1) = -1;
+        }
+    // Haplotypes sharing a label are compatible with the
+    // first member of the group, which is the lowest index
+    // not compatible with any earlier group.
+    auto dm = Sequence::difference_matrix(m);
+    auto ndiff = [&dm, this](std::size_t i, std::size_t j) {
+        auto n = m.nsam();
+        return dm[n * (n - 1) / 2 - (n - i) * (n - i - 1) / 2 + j - i - 1];
+    };
+    std::vector<std::int32_t> expected(m.nsam());
+    std::vector<int> processed(m.nsam(), 0);
+    for (std::size_t i = 0; i < m.nsam(); ++i)
+        {
+            expected[i] = static_cast<std::int32_t>(i);
+        }
+    expected.back() = -1;
+    for (std::size_t i = 0; i + 1 < m.nsam(); ++i)
+        {
+            if (processed[i])
+                {
+                    continue;
+                }
+            for (std::size_t j = i + 1; j + 1 < m.nsam(); ++j)
+                {
+                    if (ndiff(i, j) == 0)
+                        {
+                            expected[j] = expected[i];
+                            processed[j] = 1;
+                        }
+                }
+        }
+    BOOST_REQUIRE(Sequence::label_haplotypes(m) == expected);
+    m.set_haplotype_cache(true);
+    BOOST_REQUIRE(Sequence::label_haplotypes(m) == expected);
+}
+
 BOOST_AUTO_TEST_CASE(test_num_haplotypes)
 {
     auto nh = Sequence::number_of_haplotypes(m);
@@ -410,12 +611,69 @@ BOOST_AUTO_TEST_CASE(test_haplotype_diversity)
     BOOST_CHECK_CLOSE(hd, mhd, 1e-6);
 }
 
-// TODO: need an independent test of this???
-//BOOST_AUTO_TEST_CASE(test_rmin)
-//{
-//    auto rm = Sequence::rmin(m);
-//    BOOST_REQUIRE_EQUAL(rm, 1);
-//}
+BOOST_AUTO_TEST_CASE(test_rmin)
+{
+    // Add some missing data and a non-biallelic site
+    m.get(2, 0) = -1;
+    m.get(7, 3) = -1;
+    m.get(4, 1) = 2;
+    auto intervals = Sequence::rmin_intervals(m);
+    auto expected = manual_rmin_intervals(m);
+    BOOST_REQUIRE(intervals == expected);
+    BOOST_REQUIRE_EQUAL(Sequence::rmin(m), expected.size());
+
+    using interval = std::pair<std::size_t, std::size_t>;
+    std::vector<std::int8_t> data = { 0, 0, 1, 1, 0, 1, 0, 1,
+                                      0, 1, 1, 0, 0, 0, 0, 1 };
+    Sequence::VariantMatrix x(data, std::vector<double>{ 1, 2, 3, 4 });
+    BOOST_REQUIRE(Sequence::rmin_intervals(x)
+                  == (std::vector<interval>{ interval(0, 1), interval(1, 2) }));
+    BOOST_REQUIRE_EQUAL(Sequence::rmin(x), 2);
+    BOOST_REQUIRE(Sequence::rmin_intervals(x) == manual_rmin_intervals(x));
+    // Missing data cannot create a fourth gamete
+    x.get(1, 3) = -1;
+    BOOST_REQUIRE(Sequence::rmin_intervals(x)
+                  == std::vector<interval>{ interval(0, 2) });
+    BOOST_REQUIRE(Sequence::rmin_intervals(x) == manual_rmin_intervals(x));
+}
+
+BOOST_AUTO_TEST_CASE(test_lhaf)
+{
+    m.get(3, 5) = -1;
+    m.get(6, 2) = 2;
+    const std::vector<double> powers = { 0.5, 1.0, 2.0 };
+    for (std::int8_t refstate = 0; refstate < 2; ++refstate)
+        {
+            auto batch = Sequence::lhaf(m, refstate, powers);
+            BOOST_REQUIRE_EQUAL(batch.size(), powers.size());
+            for (std::size_t p = 0; p < powers.size(); ++p)
+                {
+                    BOOST_REQUIRE(batch[p]
+                                  == Sequence::lhaf(m, refstate, powers[p]));
+                    for (std::size_t i = 0; i < m.nsam(); ++i)
+                        {
+                            double score = 0.0;
+                            for (std::size_t site = 0; site < m.nsites();
+                                 ++site)
+                                {
+                                    auto r = Sequence::get_ConstRowView(m, site);
+                                    if (r[i] < 0 || r[i] == refstate)
+                                        {
+                                            continue;
+                                        }
+                                    auto d = std::count_if(
+                                        r.begin(), r.end(),
+                                        [refstate](const std::int8_t x) {
+                                            return x >= 0 && x != refstate;
+                                        });
+                                    score += std::pow(static_cast<double>(d),
+                                                      powers[p]);
+                                }
+                            BOOST_REQUIRE_EQUAL(batch[p][i], score);
+                        }
+                }
+        }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
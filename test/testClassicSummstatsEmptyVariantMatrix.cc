@@ -83,6 +83,20 @@ BOOST_AUTO_TEST_CASE(test_hprime)
     BOOST_REQUIRE_EQUAL(std::isnan(hp), true);
 }
 
+BOOST_AUTO_TEST_CASE(test_classic_summstats)
+{
+    for (auto& c : { empty_counts, invariant_counts })
+        {
+            auto s = Sequence::classic_summstats(c, 0);
+            BOOST_REQUIRE_EQUAL(s.thetapi, 0.0);
+            BOOST_REQUIRE_EQUAL(s.thetaw, 0.0);
+            BOOST_REQUIRE_EQUAL(std::isnan(s.tajd), true);
+            BOOST_REQUIRE_EQUAL(std::isnan(s.faywuh), true);
+            BOOST_REQUIRE_EQUAL(std::isnan(s.hprime), true);
+            BOOST_REQUIRE_EQUAL(s.nvariable_sites, 0);
+        }
+}
+
 // Tests of haplotype statistics are more complex.
 // It is not as obvious (to me) what to do for an empty
 // matrix.
@@ -0,0 +1,70 @@
+//! \file testExecutor.cc @brief Tests for Sequence/Executor.hpp
+
+#include <atomic>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include <Sequence/Executor.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(test_executor)
+
+BOOST_AUTO_TEST_CASE(test_thread_pool)
+{
+    Sequence::ThreadPool pool(3);
+    BOOST_REQUIRE_EQUAL(pool.size(), 3);
+    std::vector<int> results(100, 0);
+    std::vector<std::function<void()>> tasks;
+    for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            tasks.emplace_back([&results, i]() {
+                results[i] = static_cast<int>(i);
+            });
+        }
+    // The pool is reused
+    for (int rep = 0; rep < 5; ++rep)
+        {
+            std::fill(results.begin(), results.end(), -1);
+            pool.run(tasks);
+            for (std::size_t i = 0; i < results.size(); ++i)
+                {
+                    BOOST_REQUIRE_EQUAL(results[i], i);
+                }
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_exceptions)
+{
+    std::atomic<int> ran(0);
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < 10; ++i)
+        {
+            tasks.emplace_back([&ran, i]() {
+                ++ran;
+                if (i == 5)
+                    {
+                        throw std::runtime_error("task failed");
+                    }
+            });
+        }
+    auto executor = Sequence::make_thread_executor(2);
+    BOOST_REQUIRE_THROW(Sequence::run_tasks(executor, tasks),
+                        std::runtime_error);
+    // All tasks have finished before the exception is rethrown
+    BOOST_REQUIRE_EQUAL(ran.load(), 10);
+}
+
+BOOST_AUTO_TEST_CASE(test_serial)
+{
+    std::vector<int> order;
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < 4; ++i)
+        {
+            tasks.emplace_back([&order, i]() { order.push_back(i); });
+        }
+    Sequence::run_tasks(Sequence::Executor(), tasks);
+    BOOST_REQUIRE((order == std::vector<int>{ 0, 1, 2, 3 }));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include <string>
 #include <set>
 #include <iostream>
+#include <stdexcept>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
 #include <Sequence/summstats/garud.hpp>
@@ -13,6 +14,50 @@
 #include "msprime_data_fixture.hpp"
 #include <boost/test/unit_test.hpp>
 
+namespace
+{
+    Sequence::VariantMatrix
+    sites(const Sequence::VariantMatrix& m, std::size_t first,
+          std::size_t last)
+    {
+        std::vector<std::int8_t> data;
+        std::vector<double> pos;
+        for (auto i = first; i < last; ++i)
+            {
+                auto r = Sequence::get_ConstRowView(m, i);
+                data.insert(data.end(), r.begin(), r.end());
+                pos.push_back(m.position(i));
+            }
+        return Sequence::VariantMatrix(std::move(data), std::move(pos),
+                                       m.max_allele());
+    }
+
+    bool
+    same_value(const double a, const double b)
+    {
+        return a == b || (std::isnan(a) && std::isnan(b));
+    }
+
+    void
+    compare_scan(const Sequence::VariantMatrix& m, std::size_t window_size,
+                 std::size_t step_size)
+    {
+        auto scan = Sequence::garud_statistics_scan(m, window_size, step_size);
+        std::size_t k = 0;
+        for (std::size_t start = 0; start + window_size <= m.nsites();
+             start += step_size, ++k)
+            {
+                BOOST_REQUIRE(k < scan.size());
+                auto G = Sequence::garud_statistics(
+                    sites(m, start, start + window_size));
+                BOOST_REQUIRE(same_value(scan[k].H1, G.H1));
+                BOOST_REQUIRE(same_value(scan[k].H12, G.H12));
+                BOOST_REQUIRE(same_value(scan[k].H2H1, G.H2H1));
+            }
+        BOOST_REQUIRE_EQUAL(k, scan.size());
+    }
+} // namespace
+
 BOOST_FIXTURE_TEST_SUITE(test_garud_stats, vmatrix_from_msprime)
 
 BOOST_AUTO_TEST_CASE(test_garud_stats)
@@ -80,4 +125,43 @@ BOOST_AUTO_TEST_CASE(test_garud_stats)
     BOOST_CHECK_CLOSE(H2 / H1, G.H2H1, 1e-6);
 }
 
+BOOST_AUTO_TEST_CASE(test_garud_stats_scan)
+{
+    compare_scan(m, 10, 1);
+    compare_scan(m, 25, 7);
+    compare_scan(m, 5, 20);
+    compare_scan(m, m.nsites(), 1);
+    BOOST_REQUIRE(Sequence::garud_statistics_scan(m, m.nsites() + 1, 1)
+                      .empty());
+    BOOST_REQUIRE_THROW(Sequence::garud_statistics_scan(m, 0, 1),
+                        std::invalid_argument);
+    BOOST_REQUIRE_THROW(Sequence::garud_statistics_scan(m, 1, 0),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_garud_stats_scan_missing_and_multiallelic_data)
+{
+    m.get(3, 0) = -1;
+    m.get(40, 5) = -1;
+    m.get(41, 5) = -1;
+    m.get(20, 2) = 2;
+    m.get(21, 9) = 3;
+    compare_scan(m, 10, 1);
+    compare_scan(m, 25, 7);
+}
+
+BOOST_AUTO_TEST_CASE(test_garud_stats_scan_all_missing_window)
+{
+    for (std::size_t i = 10; i < 20; ++i)
+        {
+            for (std::size_t j = 0; j < m.nsam(); ++j)
+                {
+                    m.get(i, j) = -1;
+                }
+        }
+    BOOST_REQUIRE_NO_THROW(Sequence::garud_statistics_scan(m, 10, 10));
+    compare_scan(m, 10, 10);
+    compare_scan(m, 5, 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,177 @@
+//! \file testHaplotypeCache.cc @brief Tests for VariantMatrix::set_haplotype_cache
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/variant_matrix/filtering.hpp>
+#include <Sequence/variant_matrix/windows.hpp>
+#include <Sequence/summstats/classics.hpp>
+#include <Sequence/summstats/generic.hpp>
+#include <Sequence/summstats/nsl.hpp>
+#include <Sequence/summstats/nslx.hpp>
+#include <Sequence/summstats/lhaf.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+namespace
+{
+    bool
+    same_value(const double a, const double b)
+    {
+        return a == b || (std::isnan(a) && std::isnan(b));
+    }
+
+    bool
+    same_nsl(const std::vector<Sequence::nSLiHS>& a,
+             const std::vector<Sequence::nSLiHS>& b)
+    {
+        if (a.size() != b.size())
+            {
+                return false;
+            }
+        for (std::size_t i = 0; i < a.size(); ++i)
+            {
+                if (!same_value(a[i].nsl, b[i].nsl)
+                    || !same_value(a[i].ihs, b[i].ihs))
+                    {
+                        return false;
+                    }
+            }
+        return true;
+    }
+
+    void
+    compare_with_and_without_cache(Sequence::VariantMatrix& m)
+    {
+        m.set_haplotype_cache(false);
+        auto dm = Sequence::difference_matrix(m);
+        auto labels = Sequence::label_haplotypes(m);
+        auto nsl = Sequence::nsl(m, 0);
+        auto nslx = Sequence::nslx(m, 0, 3);
+        auto lhaf = Sequence::lhaf(m, 0, 1.0);
+        m.set_haplotype_cache(true);
+        BOOST_REQUIRE(Sequence::difference_matrix(m) == dm);
+        BOOST_REQUIRE(Sequence::label_haplotypes(m) == labels);
+        BOOST_REQUIRE(same_nsl(Sequence::nsl(m, 0), nsl));
+        BOOST_REQUIRE(same_nsl(Sequence::nslx(m, 0, 3), nslx));
+        BOOST_REQUIRE(Sequence::lhaf(m, 0, 1.0) == lhaf);
+    }
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(test_haplotype_cache, vmatrix_from_msprime)
+
+BOOST_AUTO_TEST_CASE(test_cache_contents)
+{
+    BOOST_REQUIRE(!m.haplotype_cache_enabled());
+    BOOST_REQUIRE_THROW(m.haplotype_major_data(), std::runtime_error);
+    m.set_haplotype_cache(true);
+    auto v = Sequence::get_HaplotypeMajorView(m);
+    BOOST_REQUIRE_EQUAL(v.nsam, m.nsam());
+    BOOST_REQUIRE_EQUAL(v.nsites, m.nsites());
+    for (std::size_t i = 0; i < m.nsam(); ++i)
+        {
+            auto c = Sequence::get_ConstColView(m, i);
+            auto h = v.haplotype(i);
+            BOOST_REQUIRE(std::equal(c.begin(), c.end(), h.begin()));
+        }
+    BOOST_REQUIRE_THROW(v.haplotype(m.nsam()), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(test_stats_match)
+{
+    compare_with_and_without_cache(m);
+}
+
+BOOST_AUTO_TEST_CASE(test_stats_match_with_missing_data)
+{
+    m.get(0, 0) = -1;
+    m.get(3, 7) = -1;
+    for (std::size_t i = 0; i < m.nsites(); ++i)
+        {
+            m.get(i, 4) = -1;
+        }
+    compare_with_and_without_cache(m);
+}
+
+BOOST_AUTO_TEST_CASE(test_invalidation)
+{
+    m.set_haplotype_cache(true);
+    auto dm = Sequence::difference_matrix(m);
+    auto c = Sequence::get_ColView(m, 0);
+    std::fill(c.begin(), c.end(), 1);
+    auto dm2 = Sequence::difference_matrix(m);
+    BOOST_REQUIRE(dm != dm2);
+    m.set_haplotype_cache(false);
+    BOOST_REQUIRE(Sequence::difference_matrix(m) == dm2);
+}
+
+BOOST_AUTO_TEST_CASE(test_filtering)
+{
+    m.set_haplotype_cache(true);
+    Sequence::difference_matrix(m);
+    Sequence::filter_haplotypes(
+        m, [](const Sequence::ColView& c) { return c[0] == 1; });
+    BOOST_REQUIRE(m.haplotype_cache_enabled());
+    compare_with_and_without_cache(m);
+    Sequence::filter_sites(
+        m, [](const Sequence::RowView& r) { return r[0] == 1; });
+    BOOST_REQUIRE(m.haplotype_cache_enabled());
+    compare_with_and_without_cache(m);
+}
+
+BOOST_AUTO_TEST_CASE(test_window)
+{
+    auto w = Sequence::make_slice(m, m.position(3), m.position(20), 2, 9);
+    compare_with_and_without_cache(w);
+}
+
+// Any of the threads may be the first to need the cache.
+BOOST_AUTO_TEST_CASE(test_concurrent_const_access)
+{
+    m.set_haplotype_cache(true);
+    const Sequence::VariantMatrix& cm = m;
+    std::vector<const std::int8_t*> pointers(4, nullptr);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < pointers.size(); ++t)
+        {
+            threads.emplace_back([&cm, &pointers, t]() {
+                pointers[t] = cm.haplotype_major_data();
+            });
+        }
+    for (auto& t : threads)
+        {
+            t.join();
+        }
+    for (auto p : pointers)
+        {
+            BOOST_REQUIRE_EQUAL(p, pointers[0]);
+        }
+    for (std::size_t i = 0; i < m.nsam(); ++i)
+        {
+            auto c = Sequence::get_ConstColView(m, i);
+            BOOST_REQUIRE(std::equal(c.begin(), c.end(),
+                                     pointers[0] + i * m.nsites()));
+        }
+    // Invalidation allows the cache to be built again.
+    m.get(0, 0) = m.get(0, 0) == 0 ? 1 : 0;
+    BOOST_REQUIRE_EQUAL(cm.haplotype_major_data()[0], m.get(0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(test_deepcopy_and_swap)
+{
+    m.set_haplotype_cache(true);
+    auto x = m.deepcopy();
+    BOOST_REQUIRE(x.haplotype_cache_enabled());
+    Sequence::VariantMatrix y(std::vector<std::int8_t>{ 0, 1, 1, 0 },
+                              std::vector<double>{ 1, 2 });
+    swap(x, y);
+    BOOST_REQUIRE(!x.haplotype_cache_enabled());
+    BOOST_REQUIRE(y.haplotype_cache_enabled());
+    BOOST_REQUIRE(Sequence::difference_matrix(y)
+                  == Sequence::difference_matrix(m));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,221 @@
+//! \file testIndexedFasta.cc @brief Tests for Sequence/IndexedFasta.hpp
+
+#include <Sequence/IndexedFasta.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <boost/test/unit_test.hpp>
+
+struct indexed_fasta_fixture
+{
+    const char *filename, *fai;
+    std::vector<std::string> names, seqs;
+    indexed_fasta_fixture()
+        : filename("indexed_fasta_test.fa"),
+          fai("indexed_fasta_test.fa.fai"), names{ "r1", "r2", "r3", "r4" },
+          seqs{ "ACGTACGTACGGGGGTTTTTACGTA", "NNNNACGT", "", "TTAGGC" }
+    {
+        // Lines of 10 bases, lines of 3 bases ending in "\r\n",
+        // an empty record, and a last line without a newline.
+        std::ofstream out(filename, std::ios_base::binary);
+        out << ">r1 a description\nACGTACGTAC\nGGGGGTTTTT\nACGTA\n"
+            << ">r2\r\nNNN\r\nNAC\r\nGT\r\n"
+            << ">r3\n"
+            << ">r4\tmore\nTTAGGC";
+    }
+    ~indexed_fasta_fixture()
+    {
+        unlink(filename);
+        unlink(fai);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(test_indexed_fasta, indexed_fasta_fixture)
+
+BOOST_AUTO_TEST_CASE(test_build_index)
+{
+    auto index = Sequence::build_fasta_index(filename);
+    BOOST_REQUIRE_EQUAL(index.size(), 4);
+    // Length, offset, line bases, and line width
+    std::vector<std::vector<std::uint64_t>> expected
+        = { { 25, 18, 10, 11 }, { 8, 51, 3, 5 }, { 0, 69, 0, 0 },
+            { 6, 78, 6, 6 } };
+    for (std::size_t i = 0; i < index.size(); ++i)
+        {
+            BOOST_REQUIRE_EQUAL(index[i].name, names[i]);
+            BOOST_REQUIRE_EQUAL(index[i].length, expected[i][0]);
+            BOOST_REQUIRE_EQUAL(index[i].offset, expected[i][1]);
+            BOOST_REQUIRE_EQUAL(index[i].line_bases, expected[i][2]);
+            BOOST_REQUIRE_EQUAL(index[i].line_width, expected[i][3]);
+        }
+    Sequence::write_fasta_index(index, fai);
+    auto x = Sequence::read_fasta_index(fai);
+    BOOST_REQUIRE_EQUAL(x.size(), index.size());
+    for (std::size_t i = 0; i < index.size(); ++i)
+        {
+            BOOST_REQUIRE_EQUAL(x[i].name, index[i].name);
+            BOOST_REQUIRE_EQUAL(x[i].offset, index[i].offset);
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_records)
+{
+    Sequence::IndexedFasta f(filename);
+    BOOST_REQUIRE_EQUAL(f.size(), 4);
+    for (std::size_t i = 0; i < names.size(); ++i)
+        {
+            BOOST_REQUIRE(f.contains(names[i]));
+            BOOST_REQUIRE_EQUAL(f.record(names[i]), i);
+            BOOST_REQUIRE_EQUAL(f.view(i).str(), seqs[i]);
+            auto x = f.fasta(names[i]);
+            BOOST_REQUIRE_EQUAL(x.name, names[i]);
+            BOOST_REQUIRE_EQUAL(x.seq, seqs[i]);
+        }
+    BOOST_REQUIRE(!f.contains("r5"));
+    BOOST_REQUIRE_THROW(f.view("r5"), std::out_of_range);
+    BOOST_REQUIRE_THROW(f.view(4), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(test_regions)
+{
+    Sequence::IndexedFasta f(filename);
+    for (std::size_t i = 0; i < names.size(); ++i)
+        {
+            const auto& s = seqs[i];
+            for (std::size_t beg = 0; beg <= s.size(); ++beg)
+                {
+                    for (std::size_t end = beg; end <= s.size(); ++end)
+                        {
+                            const auto expected = s.substr(beg, end - beg);
+                            auto v = f.view(names[i], beg, end);
+                            BOOST_REQUIRE_EQUAL(v.size(), expected.size());
+                            BOOST_REQUIRE_EQUAL(v.str(), expected);
+                            BOOST_REQUIRE_EQUAL(
+                                std::string(v.begin(), v.end()), expected);
+                            BOOST_REQUIRE_EQUAL(v.end() - v.begin(),
+                                                expected.size());
+                            for (std::size_t j = 0; j < v.size(); ++j)
+                                {
+                                    BOOST_REQUIRE_EQUAL(v[j], expected[j]);
+                                    BOOST_REQUIRE_EQUAL(
+                                        *(v.end() - (v.size() - j)),
+                                        expected[j]);
+                                }
+                            if (v.contiguous())
+                                {
+                                    BOOST_REQUIRE_EQUAL(
+                                        std::string(v.data(), v.size()),
+                                        expected);
+                                }
+                        }
+                }
+        }
+    BOOST_REQUIRE(f.view("r1", 2, 8).contiguous());
+    BOOST_REQUIRE(!f.view("r1", 8, 12).contiguous());
+    BOOST_REQUIRE_THROW(f.view("r1", 3, 26), std::out_of_range);
+    BOOST_REQUIRE_THROW(f.view("r1", 4, 3), std::out_of_range);
+    auto x = f.fasta("r1", 8, 12);
+    BOOST_REQUIRE_EQUAL(x.name, "r1:9-12");
+    BOOST_REQUIRE_EQUAL(x.seq, "ACGG");
+}
+
+BOOST_AUTO_TEST_CASE(test_iterator_arithmetic)
+{
+    Sequence::IndexedFasta f(filename);
+    auto v = f.view("r1", 7, 25);
+    auto i = v.end();
+    std::string reversed;
+    while (i != v.begin())
+        {
+            reversed.push_back(*--i);
+        }
+    std::reverse(reversed.begin(), reversed.end());
+    BOOST_REQUIRE_EQUAL(reversed, v.str());
+    BOOST_REQUIRE(v.begin() < v.end());
+    BOOST_REQUIRE_EQUAL(v.begin()[13], v[13]);
+    BOOST_REQUIRE((v.begin() + 13) - 13 == v.begin());
+    BOOST_REQUIRE_EQUAL(std::count(v.begin(), v.end(), 'G'), 6);
+}
+
+BOOST_AUTO_TEST_CASE(test_matches_fasta_read)
+{
+    std::ifstream in(filename);
+    Sequence::IndexedFasta f(filename);
+    for (std::size_t i = 0; i < f.size(); ++i)
+        {
+            Sequence::Fasta x;
+            x.read(in);
+            std::string seq(x.seq);
+            seq.erase(std::remove(seq.begin(), seq.end(), '\r'), seq.end());
+            BOOST_REQUIRE_EQUAL(f.fasta(i).seq, seq);
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_fai_file)
+{
+    // An existing .fai file is used rather than scanning the file,
+    // so an index that does not match the file is detected.
+    auto index = Sequence::build_fasta_index(filename);
+    Sequence::write_fasta_index(index, fai);
+    BOOST_REQUIRE_EQUAL(Sequence::IndexedFasta(filename).view("r4").str(),
+                        seqs[3]);
+    index[3].length = 10;
+    Sequence::write_fasta_index(index, fai);
+    BOOST_REQUIRE_THROW(Sequence::IndexedFasta{ filename },
+                        std::runtime_error);
+    // Empty records must also start within the file.
+    index[3].length = 6;
+    index[2].offset = 1000;
+    Sequence::write_fasta_index(index, fai);
+    BOOST_REQUIRE_THROW(Sequence::IndexedFasta{ filename },
+                        std::runtime_error);
+    {
+        std::ofstream out(fai);
+        out << "r1\t25\tx\n";
+    }
+    BOOST_REQUIRE_THROW(Sequence::read_fasta_index(fai), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_bad_input)
+{
+    {
+        std::ofstream out(filename);
+        out << ">r1\nACGT\nAC\nACGT\n";
+    }
+    BOOST_REQUIRE_THROW(Sequence::build_fasta_index(filename),
+                        std::runtime_error);
+    {
+        std::ofstream out(filename);
+        out << ">r1\nACGT\nACGTA\n";
+    }
+    BOOST_REQUIRE_THROW(Sequence::build_fasta_index(filename),
+                        std::runtime_error);
+    {
+        std::ofstream out(filename);
+        out << "ACGT\n";
+    }
+    BOOST_REQUIRE_THROW(Sequence::build_fasta_index(filename),
+                        std::runtime_error);
+    {
+        std::ofstream out(filename);
+        out << ">r1\nACGT\n>r1\nACGT\n";
+    }
+    BOOST_REQUIRE_THROW(Sequence::IndexedFasta{ filename },
+                        std::runtime_error);
+    {
+        // Blank lines may end a record
+        std::ofstream out(filename);
+        out << ">r1\nACGT\nAC\n\n>r2\nA\n";
+    }
+    Sequence::IndexedFasta f(filename);
+    BOOST_REQUIRE_EQUAL(f.view("r1").str(), "ACGTAC");
+    BOOST_REQUIRE_EQUAL(f.view("r2").str(), "A");
+    unlink(filename);
+    BOOST_REQUIRE_THROW(Sequence::IndexedFasta{ filename },
+                        std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,12 +4,103 @@
 #include <algorithm>
 #include <vector>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <Sequence/VariantMatrix.hpp>
 #include <Sequence/VariantMatrixViews.hpp>
 #include <Sequence/summstats/ld.hpp>
 #include <boost/test/unit_test.hpp>
 #include "msprime_data_fixture.hpp"
 
+namespace
+{
+    bool
+    close_enough(const double a, const double b)
+    {
+        return (std::isnan(a) && std::isnan(b)) || std::fabs(a - b) < 1e-12;
+    }
+
+    std::vector<Sequence::PairwiseLD>
+    brute_force_ld(const Sequence::VariantMatrix& m,
+                   const double max_distance)
+    {
+        std::vector<std::size_t> biallelic;
+        for (std::size_t i = 0; i < m.nsites(); ++i)
+            {
+                auto r = Sequence::get_ConstRowView(m, i);
+                std::vector<std::int8_t> states;
+                for (auto x : r)
+                    {
+                        if (x >= 0
+                            && std::find(states.begin(), states.end(), x)
+                                   == states.end())
+                            {
+                                states.push_back(x);
+                            }
+                    }
+                if (states.size() == 2)
+                    {
+                        biallelic.push_back(i);
+                    }
+            }
+        std::vector<Sequence::PairwiseLD> rv;
+        for (std::size_t a = 0; a < biallelic.size(); ++a)
+            {
+                auto ri = Sequence::get_ConstRowView(m, biallelic[a]);
+                auto si = *std::max_element(ri.begin(), ri.end());
+                for (std::size_t b = a + 1; b < biallelic.size(); ++b)
+                    {
+                        if (m.position(biallelic[b]) - m.position(biallelic[a])
+                            > max_distance)
+                            {
+                                break;
+                            }
+                        auto rj = Sequence::get_ConstRowView(m, biallelic[b]);
+                        auto sj = *std::max_element(rj.begin(), rj.end());
+                        double n = 0, ni = 0, nj = 0, nij = 0;
+                        for (std::size_t k = 0; k < m.nsam(); ++k)
+                            {
+                                if (ri[k] < 0 || rj[k] < 0)
+                                    {
+                                        continue;
+                                    }
+                                ++n;
+                                ni += (ri[k] == si);
+                                nj += (rj[k] == sj);
+                                nij += (ri[k] == si && rj[k] == sj);
+                            }
+                        Sequence::PairwiseLD ld;
+                        ld.i = biallelic[a];
+                        ld.j = biallelic[b];
+                        double p = ni / n, q = nj / n;
+                        ld.D = nij / n - p * q;
+                        ld.rsq = ld.D * ld.D / (p * (1 - p) * q * (1 - q));
+                        double dmax = (ld.D < 0)
+                                          ? std::min(p * q, (1 - p) * (1 - q))
+                                          : std::min(p * (1 - q), (1 - p) * q);
+                        ld.Dprime = ld.D / dmax;
+                        rv.push_back(ld);
+                    }
+            }
+        return rv;
+    }
+
+    void
+    compare_ld(const std::vector<Sequence::PairwiseLD>& a,
+               const std::vector<Sequence::PairwiseLD>& b)
+    {
+        BOOST_REQUIRE_EQUAL(a.size(), b.size());
+        for (std::size_t k = 0; k < a.size(); ++k)
+            {
+                BOOST_REQUIRE_EQUAL(a[k].i, b[k].i);
+                BOOST_REQUIRE_EQUAL(a[k].j, b[k].j);
+                BOOST_REQUIRE(close_enough(a[k].rsq, b[k].rsq));
+                BOOST_REQUIRE(close_enough(a[k].D, b[k].D));
+                BOOST_REQUIRE(close_enough(a[k].Dprime, b[k].Dprime));
+            }
+    }
+} // namespace
+
 BOOST_FIXTURE_TEST_SUITE(test_LD, vmatrix_from_msprime)
 
 BOOST_AUTO_TEST_CASE(test_two_locus_haplotype_counts)
@@ -38,4 +129,101 @@ BOOST_AUTO_TEST_CASE(test_two_locus_haplotype_counts)
         }
 }
 
+BOOST_AUTO_TEST_CASE(test_pairwise_ld)
+{
+    for (double d : { 0.0, 0.01, 0.1, 1.0 })
+        {
+            auto ld = Sequence::pairwise_ld(m, d);
+            compare_ld(ld, brute_force_ld(m, d));
+        }
+    auto all = Sequence::pairwise_ld(m, 1.0);
+    BOOST_REQUIRE(!all.empty());
+    for (auto& ld : all)
+        {
+            BOOST_REQUIRE(ld.rsq >= 0.0 && ld.rsq <= 1.0 + 1e-12);
+            BOOST_REQUIRE(ld.Dprime >= -1.0 - 1e-12
+                          && ld.Dprime <= 1.0 + 1e-12);
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_pairwise_ld_missing_and_multiallelic_data)
+{
+    m.get(0, 0) = -1;
+    m.get(1, 3) = -1;
+    m.get(1, 4) = -1;
+    m.get(2, 1) = 2;
+    // A site that is monomorphic among samples
+    // without missing data at another site
+    for (std::size_t k = 0; k < m.nsam(); ++k)
+        {
+            m.get(5, k) = (k == 0);
+            m.get(6, k) = (k == 0) ? -1 : m.get(6, k);
+        }
+    auto ld = Sequence::pairwise_ld(m, 1.0);
+    compare_ld(ld, brute_force_ld(m, 1.0));
+    BOOST_REQUIRE(std::none_of(
+        ld.begin(), ld.end(),
+        [](const Sequence::PairwiseLD& x) { return x.i == 2 || x.j == 2; }));
+}
+
+BOOST_AUTO_TEST_CASE(test_pairwise_ld_parallel)
+{
+    // Enough sites for several batches of tasks
+    std::vector<std::int8_t> data;
+    std::vector<double> pos;
+    for (std::size_t r = 0; r < 100; ++r)
+        {
+            for (std::size_t i = 0; i < m.nsites(); ++i)
+                {
+                    auto row = Sequence::get_ConstRowView(m, i);
+                    data.insert(data.end(), row.begin(), row.end());
+                    pos.push_back(static_cast<double>(r)
+                                  + m.position(i) * 0.99);
+                }
+        }
+    Sequence::VariantMatrix x(std::move(data), std::move(pos));
+    auto serial = Sequence::pairwise_ld(x, 0.5);
+    auto threaded
+        = Sequence::pairwise_ld(x, 0.5, Sequence::make_thread_executor(4));
+    compare_ld(threaded, serial);
+    std::size_t n = 0;
+    Sequence::for_each_pairwise_ld(
+        x, 0.5,
+        [&n, &serial](const Sequence::PairwiseLD& ld) {
+            BOOST_REQUIRE_EQUAL(ld.i, serial[n].i);
+            BOOST_REQUIRE_EQUAL(ld.j, serial[n].j);
+            ++n;
+        },
+        Sequence::make_thread_executor(3));
+    BOOST_REQUIRE_EQUAL(n, serial.size());
+    BOOST_REQUIRE_THROW(Sequence::pairwise_ld(x, -1.0), std::invalid_argument);
+    BOOST_REQUIRE_THROW(
+        Sequence::pairwise_ld(x, std::numeric_limits<double>::quiet_NaN()),
+        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_pairwise_ld_all_pairs_parallel)
+{
+    // With no maximum distance, pairs are split across tasks
+    // in the middle of rows, and there are several batches.
+    std::vector<std::int8_t> data;
+    std::vector<double> pos;
+    for (std::size_t r = 0; r < 4; ++r)
+        {
+            for (std::size_t i = 0; i < m.nsites(); ++i)
+                {
+                    auto row = Sequence::get_ConstRowView(m, i);
+                    data.insert(data.end(), row.begin(), row.end());
+                    pos.push_back(static_cast<double>(r)
+                                  + m.position(i) * 0.99);
+                }
+        }
+    Sequence::VariantMatrix x(std::move(data), std::move(pos));
+    const auto inf = std::numeric_limits<double>::infinity();
+    auto serial = Sequence::pairwise_ld(x, inf);
+    BOOST_REQUIRE_EQUAL(serial.size(), x.nsites() * (x.nsites() - 1) / 2);
+    compare_ld(Sequence::pairwise_ld(x, inf, Sequence::make_thread_executor(4)),
+               serial);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,138 @@
+//! \file testLDSummaries.cc @brief Tests for Sequence/summstats/ld_summaries.hpp
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/variant_matrix/windows.hpp>
+#include <Sequence/summstats/ld.hpp>
+#include <Sequence/summstats/ld_summaries.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+namespace
+{
+    bool
+    close_enough(const double a, const double b)
+    {
+        return (std::isnan(a) && std::isnan(b))
+               || std::fabs(a - b) <= 1e-10 * std::fabs(b);
+    }
+
+    Sequence::OmegaResult
+    brute_force_omega(const std::vector<Sequence::PairwiseLD>& ld,
+                      const std::size_t nsites)
+    {
+        Sequence::OmegaResult rv;
+        for (std::size_t l = 0; l + 1 < nsites; ++l)
+            {
+                double within = 0.0, between = 0.0;
+                std::size_t nwithin = 0, nbetween = 0;
+                for (auto& x : ld)
+                    {
+                        if ((x.j <= l) || (x.i > l))
+                            {
+                                within += x.rsq;
+                                ++nwithin;
+                            }
+                        else
+                            {
+                                between += x.rsq;
+                                ++nbetween;
+                            }
+                    }
+                bool left = false, right = false;
+                for (auto& x : ld)
+                    {
+                        left = left || x.j <= l;
+                        right = right || x.i > l;
+                    }
+                if (!left || !right || !nbetween)
+                    {
+                        continue;
+                    }
+                double omega = (within / static_cast<double>(nwithin))
+                               / (between / static_cast<double>(nbetween));
+                if (std::isnan(rv.omega_max) || omega > rv.omega_max)
+                    {
+                        rv.omega_max = omega;
+                        rv.left_site = l;
+                    }
+            }
+        return rv;
+    }
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(test_ld_summaries, vmatrix_from_msprime)
+
+BOOST_AUTO_TEST_CASE(test_ld_summaries_match_pairwise_table)
+{
+    const auto window = Sequence::make_window(m, 0.1, 0.4);
+    auto ld = Sequence::pairwise_ld(window, 1.0);
+    BOOST_REQUIRE(!ld.empty());
+    const double width = 0.05;
+    auto s = Sequence::ld_summaries(window, width, 4);
+
+    double zns = 0.0;
+    std::vector<double> sums(4, 0.0);
+    std::vector<std::size_t> counts(4, 0);
+    for (auto& x : ld)
+        {
+            zns += x.rsq;
+            auto k = static_cast<std::size_t>(
+                (window.position(x.j) - window.position(x.i)) / width);
+            if (k < 4)
+                {
+                    sums[k] += x.rsq;
+                    ++counts[k];
+                }
+        }
+    zns /= static_cast<double>(ld.size());
+    BOOST_REQUIRE(close_enough(s.zns, zns));
+    BOOST_REQUIRE(s.decay_npairs == counts);
+    for (std::size_t k = 0; k < 4; ++k)
+        {
+            BOOST_REQUIRE(close_enough(
+                s.decay[k],
+                counts[k] ? sums[k] / static_cast<double>(counts[k])
+                          : std::numeric_limits<double>::quiet_NaN()));
+        }
+
+    auto omega = brute_force_omega(ld, window.nsites());
+    BOOST_REQUIRE(!std::isnan(s.omega.omega_max));
+    BOOST_REQUIRE(close_enough(s.omega.omega_max, omega.omega_max));
+    BOOST_REQUIRE_EQUAL(s.omega.left_site, omega.left_site);
+
+    auto threaded = Sequence::ld_summaries(window, width, 4,
+                                           Sequence::make_thread_executor(2));
+    BOOST_REQUIRE(close_enough(threaded.zns, s.zns));
+    BOOST_REQUIRE(close_enough(threaded.omega.omega_max, s.omega.omega_max));
+}
+
+BOOST_AUTO_TEST_CASE(test_ld_accumulators_edge_cases)
+{
+    Sequence::ZnSAccumulator zns;
+    BOOST_REQUIRE(std::isnan(zns.value()));
+    Sequence::PairwiseLD x;
+    x.i = 0;
+    x.j = 1;
+    x.rsq = x.D = x.Dprime = std::numeric_limits<double>::quiet_NaN();
+    zns(x);
+    BOOST_REQUIRE_EQUAL(zns.npairs(), 0);
+
+    Sequence::OmegaAccumulator omega(3);
+    BOOST_REQUIRE(std::isnan(omega.value().omega_max));
+    x.rsq = 0.5;
+    x.i = 2;
+    BOOST_REQUIRE_THROW(omega(x), std::invalid_argument);
+
+    BOOST_REQUIRE_THROW(Sequence::LDDecayAccumulator(0.0, 10),
+                        std::invalid_argument);
+    Sequence::LDDecayAccumulator decay(1.0, 2);
+    decay(x, 5.0);
+    BOOST_REQUIRE_EQUAL(decay.npairs()[0] + decay.npairs()[1], 0);
+    BOOST_REQUIRE(std::isnan(decay.mean_rsq()[0]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
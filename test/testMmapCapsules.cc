@@ -0,0 +1,115 @@
+//! \file testMmapCapsules.cc @brief Tests for Sequence/MmapCapsules.hpp
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+#include <Sequence/MmapCapsules.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/AlleleCountMatrix.hpp>
+#include <Sequence/variant_matrix/mmapformat.hpp>
+#include <Sequence/variant_matrix/windows.hpp>
+#include <Sequence/summstats/classics.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+struct mmap_file_fixture : public vmatrix_from_msprime
+{
+    const char* filename;
+    mmap_file_fixture() : vmatrix_from_msprime(), filename("mmap_test.bin")
+    {
+        Sequence::to_mmapformat(m, filename);
+    }
+    ~mmap_file_fixture() { unlink(filename); }
+};
+
+BOOST_FIXTURE_TEST_SUITE(test_mmap_capsules, mmap_file_fixture)
+
+BOOST_AUTO_TEST_CASE(test_round_trip)
+{
+    auto x = Sequence::from_mmapformat(filename);
+    BOOST_REQUIRE(dynamic_cast<const Sequence::MmapGenotypeCapsule*>(
+                      &x.genotype_capsule())
+                  != nullptr);
+    BOOST_REQUIRE(x == m);
+    Sequence::AlleleCountMatrix ac(x);
+    BOOST_REQUIRE(ac.counts == c.counts);
+    BOOST_REQUIRE(Sequence::difference_matrix(x)
+                  == Sequence::difference_matrix(m));
+}
+
+BOOST_AUTO_TEST_CASE(test_mapping_outlives_file)
+{
+    auto x = Sequence::from_mmapformat(filename);
+    unlink(filename);
+    auto y = x.deepcopy();
+    BOOST_REQUIRE(y == m);
+}
+
+BOOST_AUTO_TEST_CASE(test_read_only)
+{
+    auto x = Sequence::from_mmapformat(filename);
+    BOOST_REQUIRE_THROW(x.data(), std::runtime_error);
+    BOOST_REQUIRE_THROW(x.position(0) = 0.0, std::runtime_error);
+    const auto& cx = x;
+    BOOST_REQUIRE_EQUAL(cx.position(0), m.position(0));
+    BOOST_REQUIRE_EQUAL(cx.get(1, 1), m.get(1, 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_write_window)
+{
+    auto w = Sequence::make_slice(m, m.position(3), m.position(10), 2, 9);
+    Sequence::to_mmapformat(w, filename);
+    auto x = Sequence::from_mmapformat(filename);
+    BOOST_REQUIRE_EQUAL(x.nsites(), w.nsites());
+    BOOST_REQUIRE_EQUAL(x.nsam(), w.nsam());
+    for (std::size_t i = 0; i < w.nsites(); ++i)
+        {
+            auto a = Sequence::get_ConstRowView(w, i);
+            auto b = Sequence::get_ConstRowView(x, i);
+            BOOST_REQUIRE(std::equal(a.begin(), a.end(), b.begin()));
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_empty_matrix)
+{
+    Sequence::VariantMatrix e(std::vector<std::int8_t>{},
+                              std::vector<double>{});
+    Sequence::to_mmapformat(e, filename);
+    auto x = Sequence::from_mmapformat(filename);
+    BOOST_REQUIRE(x.empty());
+    BOOST_REQUIRE_EQUAL(x.nsites(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_bad_input)
+{
+    {
+        std::ofstream o(filename);
+        o << "this is not a matrix file, but it is long enough";
+    }
+    BOOST_REQUIRE_THROW(Sequence::from_mmapformat(filename),
+                        std::runtime_error);
+    BOOST_REQUIRE_THROW(Sequence::from_mmapformat("no_such_file.bin"),
+                        std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_overflowing_header)
+// 2^62 sites of 8 + 8 bytes wrap around to zero bytes of data
+{
+    char header[32];
+    {
+        std::ifstream in(filename, std::ios_base::binary);
+        in.read(header, sizeof(header));
+    }
+    const std::uint64_t nsites = std::uint64_t(1) << 62, nsam = 8;
+    std::memcpy(header + 16, &nsites, sizeof(nsites));
+    std::memcpy(header + 24, &nsam, sizeof(nsam));
+    {
+        std::ofstream o(filename, std::ios_base::binary);
+        o.write(header, sizeof(header));
+    }
+    BOOST_REQUIRE_THROW(Sequence::from_mmapformat(filename),
+                        std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,150 @@
+//! \file testMsPipeline.cc @brief Tests for Sequence/variant_matrix/ms_pipeline.hpp
+
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <Sequence/AlleleCountMatrix.hpp>
+#include <Sequence/variant_matrix/msformat.hpp>
+#include <Sequence/variant_matrix/ms_pipeline.hpp>
+#include <Sequence/summstats/classics.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msformatdata.hpp"
+
+namespace
+{
+    std::vector<double>
+    serial_thetapi(const std::string& data)
+    {
+        std::istringstream in(data);
+        Sequence::MsFormatReader reader(in);
+        std::vector<double> rv;
+        Sequence::VariantMatrix m(std::vector<std::int8_t>{},
+                                  std::vector<double>{});
+        while (reader.next(m))
+            {
+                rv.push_back(
+                    Sequence::thetapi(Sequence::AlleleCountMatrix(m)));
+            }
+        return rv;
+    }
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(test_ms_pipeline)
+
+BOOST_AUTO_TEST_CASE(test_results_in_replicate_order)
+{
+    const auto data = get_msformat_stream();
+    const auto expected = serial_thetapi(data);
+    BOOST_REQUIRE(expected.size() > 1);
+    for (unsigned nthreads : { 1u, 4u })
+        {
+            for (std::size_t depth : { 1u, 3u, 0u })
+                {
+                    std::istringstream in(data);
+                    std::vector<double> pi;
+                    auto n = Sequence::analyze_msformat(
+                        in,
+                        [](const Sequence::VariantMatrix& m) {
+                            return Sequence::thetapi(
+                                Sequence::AlleleCountMatrix(m));
+                        },
+                        [&pi](std::size_t replicate, double x) {
+                            BOOST_REQUIRE_EQUAL(replicate, pi.size());
+                            pi.push_back(x);
+                        },
+                        nthreads, depth);
+                    BOOST_REQUIRE_EQUAL(n, expected.size());
+                    BOOST_REQUIRE(pi == expected);
+                }
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_executor_results_in_replicate_order)
+{
+    const auto data = get_msformat_stream();
+    const auto expected = serial_thetapi(data);
+    for (auto executor :
+         { Sequence::Executor(), Sequence::make_thread_executor(3) })
+        {
+            for (std::size_t batch_size : { 1u, 3u, 64u })
+                {
+                    std::istringstream in(data);
+                    std::vector<double> pi;
+                    auto n = Sequence::analyze_msformat(
+                        in,
+                        [](const Sequence::VariantMatrix& m) {
+                            return Sequence::thetapi(
+                                Sequence::AlleleCountMatrix(m));
+                        },
+                        [&pi](std::size_t replicate, double x) {
+                            BOOST_REQUIRE_EQUAL(replicate, pi.size());
+                            pi.push_back(x);
+                        },
+                        executor, batch_size);
+                    BOOST_REQUIRE_EQUAL(n, expected.size());
+                    BOOST_REQUIRE(pi == expected);
+                }
+        }
+    std::istringstream in(data);
+    BOOST_REQUIRE_THROW(Sequence::analyze_msformat(
+                            in,
+                            [](const Sequence::VariantMatrix& m) {
+                                return m.nsites();
+                            },
+                            [](std::size_t, std::size_t) {},
+                            Sequence::Executor(), 0),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_classic_summstats)
+{
+    const auto data = get_msformat_stream();
+    std::istringstream in(data);
+    auto stats = Sequence::msformat_classic_summstats(in, 0, 3);
+    std::istringstream in2(data);
+    Sequence::MsFormatReader reader(in2);
+    std::size_t i = 0;
+    for (; i < stats.size(); ++i)
+        {
+            auto m = reader.next();
+            auto s = Sequence::classic_summstats(
+                Sequence::AlleleCountMatrix(m), 0);
+            BOOST_REQUIRE_EQUAL(stats[i].thetapi, s.thetapi);
+            BOOST_REQUIRE_EQUAL(stats[i].nvariable_sites, s.nvariable_sites);
+        }
+    BOOST_REQUIRE_EQUAL(i, reader.nreplicates());
+    BOOST_REQUIRE_EQUAL(stats.size(), serial_thetapi(data).size());
+}
+
+BOOST_AUTO_TEST_CASE(test_exceptions_are_rethrown)
+{
+    const auto data = get_msformat_stream();
+    std::istringstream in(data);
+    std::size_t nconsumed = 0;
+    BOOST_REQUIRE_THROW(
+        Sequence::analyze_msformat(
+            in,
+            [](const Sequence::VariantMatrix& m) -> std::size_t {
+                if (m.nsites() % 2)
+                    {
+                        throw std::runtime_error("odd");
+                    }
+                return m.nsites();
+            },
+            [&nconsumed](std::size_t, std::size_t) { ++nconsumed; }, 4, 2),
+        std::runtime_error);
+    std::istringstream in2(data);
+    BOOST_REQUIRE_THROW(Sequence::analyze_msformat(
+                            in2,
+                            [](const Sequence::VariantMatrix& m) {
+                                return m.nsites();
+                            },
+                            [](std::size_t, std::size_t) {
+                                throw std::invalid_argument("consumer");
+                            },
+                            2),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
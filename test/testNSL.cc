@@ -0,0 +1,166 @@
+//! \file testNSL.cc @brief Tests for Sequence/summstats/nsl.hpp and Sequence/summstats/nslx.hpp
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/SparseCapsules.hpp>
+#include <Sequence/Executor.hpp>
+#include <Sequence/summstats/nsl.hpp>
+#include <Sequence/summstats/nslx.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+namespace
+{
+    bool
+    close_enough(const double a, const double b)
+    {
+        return (std::isnan(a) && std::isnan(b))
+               || (std::isinf(a) && a == b)
+               || std::fabs(a - b) <= 1e-10 * std::max(1.0, std::fabs(b));
+    }
+
+    void
+    compare_to_single_cores(const Sequence::VariantMatrix& m,
+                            const std::int8_t refstate)
+    // The version for a single core site compares
+    // all pairs of haplotypes directly.
+    {
+        auto all = Sequence::nsl(m, refstate);
+        BOOST_REQUIRE_EQUAL(all.size(), m.nsites());
+        for (std::size_t core = 0; core < m.nsites(); ++core)
+            {
+                auto x = Sequence::nsl(m, core, refstate);
+                BOOST_REQUIRE(close_enough(all[core].nsl, x.nsl));
+                BOOST_REQUIRE(close_enough(all[core].ihs, x.ihs));
+                BOOST_REQUIRE_EQUAL(all[core].core_count, x.core_count);
+            }
+    }
+
+    bool
+    identical(const std::vector<Sequence::nSLiHS>& a,
+              const std::vector<Sequence::nSLiHS>& b)
+    {
+        if (a.size() != b.size())
+            {
+                return false;
+            }
+        for (std::size_t i = 0; i < a.size(); ++i)
+            {
+                if (!(a[i].nsl == b[i].nsl
+                      || (std::isnan(a[i].nsl) && std::isnan(b[i].nsl)))
+                    || !(a[i].ihs == b[i].ihs
+                         || (std::isnan(a[i].ihs) && std::isnan(b[i].ihs)))
+                    || a[i].core_count != b[i].core_count)
+                    {
+                        return false;
+                    }
+            }
+        return true;
+    }
+
+    void
+    compare_nslx_threads(Sequence::VariantMatrix& m, const int x)
+    // The threaded version must give the same
+    // results, whatever the storage of the data.
+    {
+        auto executor = Sequence::make_thread_executor(4);
+        for (std::int8_t refstate = 0; refstate < 2; ++refstate)
+            {
+                auto serial = Sequence::nslx(m, refstate, x);
+                BOOST_REQUIRE(identical(
+                    Sequence::nslx(m, refstate, x, executor), serial));
+                m.set_haplotype_cache(true);
+                BOOST_REQUIRE(identical(
+                    Sequence::nslx(m, refstate, x, executor), serial));
+                m.set_haplotype_cache(false);
+            }
+        auto sparse = Sequence::make_sparse_VariantMatrix(m);
+        BOOST_REQUIRE(identical(Sequence::nslx(sparse, 0, x, executor),
+                                Sequence::nslx(m, 0, x)));
+    }
+
+    Sequence::VariantMatrix
+    founder_haplotypes(const std::size_t nsam, const std::size_t nsites,
+                       const std::size_t nfounders, const double mutation)
+    // Copies of a few random haplotypes, with occasional
+    // changes, so that many pairs are identical over long
+    // stretches or over all sites.
+    {
+        std::mt19937 generator(42);
+        std::uniform_int_distribution<std::size_t> founder(0,
+                                                           nfounders - 1);
+        std::bernoulli_distribution coin(0.5), mutate(mutation);
+        std::vector<std::vector<std::int8_t>> founders(
+            nfounders, std::vector<std::int8_t>(nsites));
+        for (auto& f : founders)
+            {
+                for (auto& x : f)
+                    {
+                        x = coin(generator);
+                    }
+            }
+        std::vector<std::int8_t> data(nsam * nsites);
+        for (std::size_t i = 0; i < nsam; ++i)
+            {
+                auto& f = founders[founder(generator)];
+                for (std::size_t s = 0; s < nsites; ++s)
+                    {
+                        std::int8_t x = f[s];
+                        if (mutate(generator))
+                            {
+                                x = (s % 7 == 0) ? 2 : 1 - x;
+                            }
+                        data[s * nsam + i] = x;
+                    }
+            }
+        std::vector<double> pos(nsites);
+        for (std::size_t s = 0; s < nsites; ++s)
+            {
+                pos[s] = static_cast<double>(s)
+                         + 0.25 * static_cast<double>(s % 3);
+            }
+        return Sequence::VariantMatrix(std::move(data), std::move(pos));
+    }
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(test_nsl, vmatrix_from_msprime)
+
+BOOST_AUTO_TEST_CASE(test_nsl_all_cores)
+{
+    compare_to_single_cores(m, 0);
+    compare_to_single_cores(m, 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_nsl_identical_haplotypes_and_multiple_states)
+{
+    compare_to_single_cores(founder_haplotypes(40, 150, 4, 0.01), 0);
+    compare_to_single_cores(founder_haplotypes(40, 150, 4, 0.01), 1);
+    compare_to_single_cores(founder_haplotypes(70, 80, 10, 0.1), 0);
+    compare_to_single_cores(founder_haplotypes(2, 30, 1, 0.2), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_nsl_missing_data)
+{
+    m.get(3, 1) = -1;
+    m.get(10, 4) = -1;
+    compare_to_single_cores(m, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_nslx_threads)
+{
+    compare_nslx_threads(m, 3);
+    auto f = founder_haplotypes(200, 600, 8, 0.05);
+    compare_nslx_threads(f, 2);
+    compare_nslx_threads(f, 4);
+    for (std::size_t s = 0; s < f.nsites(); s += 37)
+        {
+            f.get(s, (s * 13) % f.nsam()) = -1;
+        }
+    compare_nslx_threads(f, 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,136 @@
+//! \file testNSLStandardization.cc @brief Tests for Sequence/summstats/nsl_standardization.hpp
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <Sequence/VariantMatrix.hpp>
+#include <Sequence/descriptiveStats.hpp>
+#include <Sequence/summstats/nsl.hpp>
+#include <Sequence/summstats/nsl_standardization.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+namespace
+{
+    bool
+    same_value(const double a, const double b)
+    {
+        return (std::isnan(a) && std::isnan(b))
+               || std::fabs(a - b) <= 1e-10 * std::max(1.0, std::fabs(b));
+    }
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(test_nsl_standardization, vmatrix_from_msprime)
+
+BOOST_AUTO_TEST_CASE(test_standardize_within_bins)
+// Compare to the mean and variance of all
+// finite scores with the same core count.
+{
+    auto raw = Sequence::nsl(m, 0);
+    Sequence::nSLiHSStandardizer s(m.nsam());
+    BOOST_REQUIRE_EQUAL(s.nbins(), m.nsam() + 1);
+    s(raw);
+    auto z = s.standardize(raw);
+    BOOST_REQUIRE_EQUAL(z.size(), raw.size());
+    for (std::size_t i = 0; i < raw.size(); ++i)
+        {
+            std::vector<double> same_bin;
+            for (auto& r : raw)
+                {
+                    if (r.core_count == raw[i].core_count
+                        && std::isfinite(r.nsl))
+                        {
+                            same_bin.push_back(r.nsl);
+                        }
+                }
+            BOOST_REQUIRE_EQUAL(z[i].core_count, raw[i].core_count);
+            if (same_bin.size() < 2 || !std::isfinite(raw[i].nsl))
+                {
+                    BOOST_REQUIRE(std::isnan(z[i].nsl));
+                    continue;
+                }
+            auto mv = Sequence::meanAndVar(same_bin.begin(), same_bin.end());
+            if (mv.second > 0.0)
+                {
+                    BOOST_REQUIRE(same_value(
+                        z[i].nsl, (raw[i].nsl - mv.first) / std::sqrt(mv.second)));
+                }
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_pooling_replicates)
+// Adding two replicates to one object, or adding
+// the objects for each replicate, are the same.
+{
+    auto a = Sequence::nsl(m, 0), b = Sequence::nsl(m, 1);
+    Sequence::nSLiHSStandardizer pooled(m.nsam(), 10), sa(m.nsam(), 10),
+        sb(m.nsam(), 10);
+    pooled(a);
+    pooled(b);
+    sa(a);
+    sb(b);
+    auto sum = sa + sb;
+    for (std::size_t i = 0; i < pooled.nbins(); ++i)
+        {
+            BOOST_REQUIRE_EQUAL(sum.nsl_sums()[i].n(),
+                                pooled.nsl_sums()[i].n());
+            BOOST_REQUIRE(same_value(sum.nsl_sums()[i].sum(),
+                                     pooled.nsl_sums()[i].sum()));
+            BOOST_REQUIRE(same_value(sum.ihs_sums()[i].sumSquares(),
+                                     pooled.ihs_sums()[i].sumSquares()));
+        }
+    Sequence::nSLiHSStandardizer other(m.nsam() + 1, 10);
+    BOOST_REQUIRE_THROW(sa += other, std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_frequency_bins)
+{
+    Sequence::nSLiHSStandardizer s(10, 5);
+    BOOST_REQUIRE_EQUAL(s.bin(0), 0);
+    BOOST_REQUIRE_EQUAL(s.bin(1), 0);
+    BOOST_REQUIRE_EQUAL(s.bin(2), 1);
+    BOOST_REQUIRE_EQUAL(s.bin(9), 4);
+    BOOST_REQUIRE_EQUAL(s.bin(10), 4);
+    BOOST_REQUIRE_THROW(s.bin(11), std::invalid_argument);
+    BOOST_REQUIRE_THROW(s.bin(-1), std::invalid_argument);
+    BOOST_REQUIRE_THROW(Sequence::nSLiHSStandardizer(0),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_extreme_score_fractions)
+{
+    auto raw = Sequence::nsl(m, 0);
+    Sequence::nSLiHSStandardizer s(m.nsam(), 20);
+    s(raw);
+    auto z = s.standardize(raw);
+    const double window_size = 0.1, step_size = 0.05, threshold = 1.5;
+    auto w = Sequence::extreme_score_fractions(m, z, window_size, step_size,
+                                               threshold);
+    BOOST_REQUIRE(w.nwindows() > 0);
+    for (std::size_t i = 0; i < w.nwindows(); ++i)
+        {
+            unsigned nscores = 0, nextreme = 0;
+            for (std::size_t site = 0; site < m.nsites(); ++site)
+                {
+                    if (m.position(site) >= w.start[i]
+                        && m.position(site) <= w.stop[i]
+                        && std::isfinite(z[site].nsl))
+                        {
+                            ++nscores;
+                            nextreme += (std::fabs(z[site].nsl) > threshold);
+                        }
+                }
+            BOOST_REQUIRE_EQUAL(w.nsl_nscores[i], nscores);
+            BOOST_REQUIRE(same_value(
+                w.nsl_fraction[i],
+                nscores ? static_cast<double>(nextreme) / nscores
+                        : std::numeric_limits<double>::quiet_NaN()));
+        }
+    BOOST_REQUIRE_THROW(Sequence::extreme_score_fractions(
+                            m, std::vector<Sequence::nSLiHS>(), 0.1, 0.1),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+//! \file testSlidingWindows.cc @brief Tests for Sequence/summstats/sliding_windows.hpp
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <Sequence/summstats/classics.hpp>
+#include <Sequence/summstats/sliding_windows.hpp>
+#include <Sequence/variant_matrix/windows.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+namespace
+{
+    const std::vector<Sequence::WindowStatistic> all_statistics{
+        Sequence::WindowStatistic::thetapi,
+        Sequence::WindowStatistic::thetaw,
+        Sequence::WindowStatistic::tajd,
+        Sequence::WindowStatistic::hprime,
+        Sequence::WindowStatistic::faywuh,
+        Sequence::WindowStatistic::nvariable_sites
+    };
+
+    void
+    check_value(const double a, const double b)
+    {
+        if (std::isnan(b))
+            {
+                BOOST_REQUIRE(std::isnan(a));
+            }
+        else if (std::fabs(b) < 1e-10)
+            {
+                BOOST_REQUIRE_SMALL(a, 1e-10);
+            }
+        else
+            {
+                BOOST_REQUIRE_CLOSE(a, b, 1e-8);
+            }
+    }
+} // namespace
+
+struct sliding_window_fixture : public vmatrix_from_msprime
+{
+    void
+    compare(const double window_size, const double step_size)
+    {
+        auto t = Sequence::sliding_window_summstats(
+            m, c, window_size, step_size, all_statistics, 0);
+        BOOST_REQUIRE_EQUAL(t.columns.size(), all_statistics.size());
+        BOOST_REQUIRE(t.nwindows() > 0);
+        BOOST_REQUIRE(t.start.back() <= m.position(m.nsites() - 1));
+        BOOST_REQUIRE(t.start.back() + step_size > m.position(m.nsites() - 1));
+        for (std::size_t i = 0; i < t.nwindows(); ++i)
+            {
+                auto w = Sequence::make_window(c, m, t.start[i], t.stop[i]);
+                BOOST_REQUIRE_EQUAL(t.nsites[i], w.nrow);
+                using S = Sequence::WindowStatistic;
+                check_value(t.column(S::thetapi)[i], Sequence::thetapi(w));
+                check_value(t.column(S::thetaw)[i], Sequence::thetaw(w));
+                check_value(t.column(S::tajd)[i], Sequence::tajd(w));
+                check_value(t.column(S::hprime)[i], Sequence::hprime(w, 0));
+                check_value(t.column(S::faywuh)[i], Sequence::faywuh(w, 0));
+                BOOST_REQUIRE_EQUAL(t.column(S::nvariable_sites)[i],
+                                    Sequence::nvariable_sites(w));
+            }
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(test_sliding_windows, sliding_window_fixture)
+
+BOOST_AUTO_TEST_CASE(test_overlapping_windows)
+{
+    compare(0.1, 0.025);
+}
+
+BOOST_AUTO_TEST_CASE(test_nonoverlapping_windows)
+{
+    compare(0.05, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(test_small_windows)
+{
+    // Many of these windows are empty
+    compare(1e-3, 5e-4);
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_data)
+{
+    m.get(0, 0) = -1;
+    m.get(10, 3) = -1;
+    Sequence::AlleleCountMatrix ac(m);
+    auto t = Sequence::sliding_window_summstats(
+        m, ac, 0.1, 0.05, { Sequence::WindowStatistic::thetapi });
+    for (std::size_t i = 0; i < t.nwindows(); ++i)
+        {
+            auto w = Sequence::make_window(ac, m, t.start[i], t.stop[i]);
+            check_value(t.columns[0][i], Sequence::thetapi(w));
+        }
+}
+
+BOOST_AUTO_TEST_CASE(test_exceptions)
+{
+    BOOST_REQUIRE_THROW(
+        Sequence::sliding_window_summstats(m, c, 0., 1., all_statistics),
+        std::invalid_argument);
+    BOOST_REQUIRE_THROW(
+        Sequence::sliding_window_summstats(m, c, 1., -1., all_statistics),
+        std::invalid_argument);
+    BOOST_REQUIRE_THROW(
+        Sequence::sliding_window_summstats(m, c, 1., 1., all_statistics, 3),
+        std::invalid_argument);
+    auto t = Sequence::sliding_window_summstats(
+        m, 1., 1., { Sequence::WindowStatistic::thetaw });
+    BOOST_REQUIRE_EQUAL(t.nwindows(), 1);
+    BOOST_REQUIRE_CLOSE(t.columns[0][0], Sequence::thetaw(c), 1e-8);
+    BOOST_REQUIRE_THROW(t.column(Sequence::WindowStatistic::tajd),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,198 @@
+//! \file testSparseCapsule.cc @brief Tests for Sequence/SparseCapsules.hpp
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <Sequence/SparseCapsules.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/AlleleCountMatrix.hpp>
+#include <Sequence/summstats/classics.hpp>
+#include <Sequence/summstats/nslx.hpp>
+#include <Sequence/summstats/lhaf.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+namespace
+{
+    bool
+    same_value(const double a, const double b)
+    {
+        return a == b || (std::isnan(a) && std::isnan(b));
+    }
+
+    bool
+    same_nsl(const std::vector<Sequence::nSLiHS>& a,
+             const std::vector<Sequence::nSLiHS>& b)
+    {
+        if (a.size() != b.size())
+            {
+                return false;
+            }
+        for (std::size_t i = 0; i < a.size(); ++i)
+            {
+                if (!same_value(a[i].nsl, b[i].nsl)
+                    || !same_value(a[i].ihs, b[i].ihs))
+                    {
+                        return false;
+                    }
+            }
+        return true;
+    }
+} // namespace
+
+struct sparse_and_dense_matrices : public vmatrix_from_msprime
+{
+    Sequence::VariantMatrix sparse;
+    sparse_and_dense_matrices()
+        : vmatrix_from_msprime(), sparse(Sequence::make_sparse_VariantMatrix(m))
+    {
+    }
+
+    const Sequence::SparseGenotypeCapsule*
+    capsule() const
+    {
+        return dynamic_cast<const Sequence::SparseGenotypeCapsule*>(
+            &sparse.genotype_capsule());
+    }
+
+    void
+    compare()
+    {
+        auto x = Sequence::make_sparse_VariantMatrix(m);
+        Sequence::AlleleCountMatrix ac(x), dc(m);
+        BOOST_REQUIRE(ac.counts == dc.counts);
+        BOOST_REQUIRE_EQUAL(Sequence::thetaw(ac), Sequence::thetaw(dc));
+        BOOST_REQUIRE_EQUAL(Sequence::thetapi(ac), Sequence::thetapi(dc));
+        for (std::int8_t refstate = 0; refstate < 2; ++refstate)
+            {
+                BOOST_REQUIRE(Sequence::lhaf(x, refstate, 2.0)
+                              == Sequence::lhaf(m, refstate, 2.0));
+                BOOST_REQUIRE(same_nsl(Sequence::nslx(x, refstate, 3),
+                                       Sequence::nslx(m, refstate, 3)));
+            }
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(test_sparse_capsule, sparse_and_dense_matrices)
+
+BOOST_AUTO_TEST_CASE(test_storage)
+{
+    BOOST_REQUIRE(capsule() != nullptr);
+    BOOST_REQUIRE(capsule()->sparse());
+    BOOST_REQUIRE_EQUAL(
+        capsule()->nnz(),
+        static_cast<std::size_t>(std::count_if(
+            m.cdata(), m.cdata() + m.nsites() * m.nsam(),
+            [](const std::int8_t x) { return x != 0; })));
+    for (std::size_t i = 0; i < m.nsites(); ++i)
+        {
+            for (std::size_t j = 0; j < m.nsam(); ++j)
+                {
+                    BOOST_REQUIRE_EQUAL(capsule()->state(i, j), m.cget(i, j));
+                }
+        }
+    const auto& csparse = sparse;
+    BOOST_REQUIRE(csparse == m);
+    BOOST_REQUIRE(capsule()->sparse());
+}
+
+BOOST_AUTO_TEST_CASE(test_stats_match)
+{
+    compare();
+    BOOST_REQUIRE(capsule()->sparse());
+}
+
+BOOST_AUTO_TEST_CASE(test_stats_match_with_missing_and_multiallelic_data)
+{
+    m.get(0, 0) = -1;
+    m.get(3, 7) = -1;
+    m.get(5, 2) = 2;
+    // Rebuild m so that max_allele is 2
+    m = Sequence::VariantMatrix(
+        std::vector<std::int8_t>(m.cdata(),
+                                 m.cdata() + m.nsites() * m.nsam()),
+        std::vector<double>(m.cpbegin(), m.cpend()));
+    BOOST_REQUIRE_EQUAL(m.max_allele(), 2);
+    compare();
+    // max_allele is too small
+    Sequence::VariantMatrix x(
+        std::unique_ptr<Sequence::GenotypeCapsule>(
+            new Sequence::SparseGenotypeCapsule(m)),
+        std::unique_ptr<Sequence::PositionCapsule>(
+            new Sequence::VectorPositionCapsule(
+                std::vector<double>(m.cpbegin(), m.cpend()))),
+        1);
+    BOOST_REQUIRE_THROW(Sequence::AlleleCountMatrix{ x }, std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_rare_variants)
+{
+    // One derived allele per site
+    std::vector<std::int8_t> data(100 * 50, 0);
+    std::vector<double> pos;
+    for (std::size_t i = 0; i < 100; ++i)
+        {
+            data[i * 50 + (i * 7) % 50] = 1;
+            pos.push_back(static_cast<double>(i));
+        }
+    auto x = Sequence::make_sparse_VariantMatrix(data, pos);
+    Sequence::VariantMatrix d(data, pos);
+    auto c = dynamic_cast<const Sequence::SparseGenotypeCapsule*>(
+        &x.genotype_capsule());
+    BOOST_REQUIRE_EQUAL(c->nnz(), 100);
+    BOOST_REQUIRE_EQUAL(c->nnz(0), 1);
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(x).counts
+                  == Sequence::AlleleCountMatrix(d).counts);
+    BOOST_REQUIRE(Sequence::lhaf(x, 0, 1.0) == Sequence::lhaf(d, 0, 1.0));
+    BOOST_REQUIRE(same_nsl(Sequence::nslx(x, 0, 1), Sequence::nslx(d, 0, 1)));
+}
+
+BOOST_AUTO_TEST_CASE(test_mutation_converts_to_dense)
+{
+    sparse.get(0, 0) = 1 - sparse.get(0, 0);
+    BOOST_REQUIRE(!capsule()->sparse());
+    BOOST_REQUIRE(sparse != m);
+    sparse.get(0, 0) = m.get(0, 0);
+    BOOST_REQUIRE(sparse == m);
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(sparse).counts == c.counts);
+}
+
+BOOST_AUTO_TEST_CASE(test_deepcopy)
+{
+    auto copy = sparse.deepcopy();
+    auto cc = dynamic_cast<const Sequence::SparseGenotypeCapsule*>(
+        &copy.genotype_capsule());
+    BOOST_REQUIRE(cc != nullptr);
+    BOOST_REQUIRE(cc->sparse());
+    BOOST_REQUIRE_EQUAL(cc->nnz(), capsule()->nnz());
+    BOOST_REQUIRE(copy == m);
+}
+
+// Any of the threads may be the first to need the dense buffer.
+BOOST_AUTO_TEST_CASE(test_concurrent_const_access)
+{
+    const Sequence::VariantMatrix& cs = sparse;
+    std::vector<const std::int8_t*> pointers(4, nullptr);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < pointers.size(); ++t)
+        {
+            threads.emplace_back([&cs, &pointers, t]() {
+                pointers[t] = cs.cdata();
+            });
+        }
+    for (auto& t : threads)
+        {
+            t.join();
+        }
+    for (auto p : pointers)
+        {
+            BOOST_REQUIRE_EQUAL(p, pointers[0]);
+        }
+    BOOST_REQUIRE(capsule()->sparse());
+    BOOST_REQUIRE(std::equal(m.cdata(), m.cdata() + m.nsites() * m.nsam(),
+                             pointers[0]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,165 @@
+//! \file testTiledCapsule.cc @brief Tests for Sequence/TiledCapsules.hpp
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <Sequence/TiledCapsules.hpp>
+#include <Sequence/VariantMatrixViews.hpp>
+#include <Sequence/variant_matrix/windows.hpp>
+#include <Sequence/AlleleCountMatrix.hpp>
+#include <Sequence/summstats/classics.hpp>
+#include <boost/test/unit_test.hpp>
+#include "msprime_data_fixture.hpp"
+
+struct tiled_and_dense_matrices : public vmatrix_from_msprime
+{
+    // Block sizes are chosen so that the
+    // edge tiles are smaller than the others.
+    Sequence::VariantMatrix tiled;
+    tiled_and_dense_matrices()
+        : vmatrix_from_msprime(),
+          tiled(Sequence::make_tiled_VariantMatrix(m, 7, 5, 3))
+    {
+    }
+
+    const Sequence::TiledGenotypeCapsule*
+    capsule() const
+    {
+        return dynamic_cast<const Sequence::TiledGenotypeCapsule*>(
+            &tiled.genotype_capsule());
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(test_tiled_capsule, tiled_and_dense_matrices)
+
+BOOST_AUTO_TEST_CASE(test_geometry)
+{
+    BOOST_REQUIRE(capsule() != nullptr);
+    BOOST_REQUIRE(capsule()->tiled());
+    BOOST_REQUIRE_EQUAL(tiled.nsites(), m.nsites());
+    BOOST_REQUIRE_EQUAL(tiled.nsam(), m.nsam());
+    BOOST_REQUIRE_EQUAL(capsule()->site_blocks(), (m.nsites() + 6) / 7);
+    BOOST_REQUIRE_EQUAL(capsule()->sample_blocks(), (m.nsam() + 4) / 5);
+    BOOST_REQUIRE(capsule()->resident_blocks() <= 3);
+    BOOST_REQUIRE_THROW(capsule()->block(capsule()->nblocks()),
+                        std::out_of_range);
+    BOOST_REQUIRE_THROW(Sequence::TiledGenotypeCapsule(
+                            std::vector<std::int8_t>{ 0, 1 }, 1, 0, 1),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_blocks)
+{
+    std::size_t n = 0;
+    for (auto i = capsule()->blocks_begin(); i != capsule()->blocks_end();
+         ++i, ++n)
+        {
+            auto b = *i;
+            for (std::size_t s = 0; s < b.nsites; ++s)
+                {
+                    for (std::size_t j = 0; j < b.nsam; ++j)
+                        {
+                            BOOST_REQUIRE_EQUAL(
+                                b(s, j),
+                                m.get(b.first_site + s, b.first_sample + j));
+                        }
+                }
+            BOOST_REQUIRE(capsule()->resident_blocks() <= 3);
+        }
+    BOOST_REQUIRE_EQUAL(n, capsule()->nblocks());
+}
+
+BOOST_AUTO_TEST_CASE(test_views)
+{
+    const auto& ctiled = tiled;
+    for (std::size_t i = 0; i < m.nsites(); ++i)
+        {
+            auto a = Sequence::get_ConstRowView(m, i);
+            auto b = Sequence::get_ConstRowView(ctiled, i);
+            BOOST_REQUIRE(std::equal(a.begin(), a.end(), b.begin()));
+        }
+    BOOST_REQUIRE(capsule()->tiled());
+    BOOST_REQUIRE(m == ctiled);
+}
+
+BOOST_AUTO_TEST_CASE(test_allele_counts_and_stats)
+{
+    Sequence::AlleleCountMatrix ac(tiled);
+    BOOST_REQUIRE(capsule()->tiled());
+    BOOST_REQUIRE(ac.counts == c.counts);
+    BOOST_REQUIRE_EQUAL(ac.nrow, c.nrow);
+    BOOST_REQUIRE_EQUAL(Sequence::thetapi(ac), Sequence::thetapi(c));
+}
+
+BOOST_AUTO_TEST_CASE(test_unbounded)
+{
+    auto x = Sequence::make_tiled_VariantMatrix(m, 16, 16);
+    auto cx = dynamic_cast<const Sequence::TiledGenotypeCapsule*>(
+        &x.genotype_capsule());
+    BOOST_REQUIRE_EQUAL(cx->resident_blocks(), cx->nblocks());
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(x).counts == c.counts);
+}
+
+BOOST_AUTO_TEST_CASE(test_mutation_converts_to_dense)
+{
+    tiled.get(0, 0) = 1 - tiled.get(0, 0);
+    BOOST_REQUIRE(!capsule()->tiled());
+    BOOST_REQUIRE(tiled != m);
+    tiled.get(0, 0) = m.get(0, 0);
+    BOOST_REQUIRE(tiled == m);
+}
+
+BOOST_AUTO_TEST_CASE(test_deepcopy)
+{
+    auto copy = tiled.deepcopy();
+    auto cc = dynamic_cast<const Sequence::TiledGenotypeCapsule*>(
+        &copy.genotype_capsule());
+    BOOST_REQUIRE(cc != nullptr);
+    BOOST_REQUIRE(cc->resident_blocks() <= 3);
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(copy).counts == c.counts);
+    BOOST_REQUIRE(copy == m);
+}
+
+BOOST_AUTO_TEST_CASE(test_windows_use_tiles)
+{
+    const auto& ctiled = tiled;
+    const double beg = m.position(m.nsites() / 3),
+                 end = m.position(m.nsites() / 2);
+    const auto a = Sequence::make_slice(m, beg, end, 2, 13);
+    const auto b = Sequence::make_slice(ctiled, beg, end, 2, 13);
+    BOOST_REQUIRE_EQUAL(a.nsites(), b.nsites());
+    BOOST_REQUIRE_EQUAL(a.nsam(), b.nsam());
+    BOOST_REQUIRE_EQUAL(a.max_allele(), b.max_allele());
+    BOOST_REQUIRE(std::equal(a.pbegin(), a.pend(), b.pbegin()));
+    for (std::size_t s = 0; s < a.nsites(); ++s)
+        {
+            for (std::size_t j = 0; j < a.nsam(); ++j)
+                {
+                    BOOST_REQUIRE_EQUAL(a.get(s, j), b.get(s, j));
+                }
+        }
+    auto e = Sequence::make_window(ctiled, m.position(m.nsites() - 1) + 1.,
+                                   m.position(m.nsites() - 1) + 2.);
+    BOOST_REQUIRE_EQUAL(e.nsites(), 0);
+    BOOST_REQUIRE(capsule()->tiled());
+    BOOST_REQUIRE(capsule()->resident_blocks() <= 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_clone_leaves_source_resident_set)
+{
+    const auto n = capsule()->resident_blocks();
+    auto copy = tiled.deepcopy();
+    BOOST_REQUIRE_EQUAL(capsule()->resident_blocks(), n);
+    BOOST_REQUIRE(copy == m);
+}
+
+BOOST_AUTO_TEST_CASE(test_removing_bound_reloads_tiles)
+{
+    auto cx = const_cast<Sequence::TiledGenotypeCapsule*>(capsule());
+    BOOST_REQUIRE(cx->resident_blocks() < cx->nblocks());
+    cx->set_max_resident_blocks(0);
+    BOOST_REQUIRE_EQUAL(cx->resident_blocks(), cx->nblocks());
+    BOOST_REQUIRE(Sequence::AlleleCountMatrix(tiled).counts == c.counts);
+}
+
+BOOST_AUTO_TEST_SUITE_END()